@@ -0,0 +1,199 @@
+#include "app/flock_renderer.hpp"
+
+#include "app/sfml_convert.hpp"
+
+#include <SFML/Graphics/Image.hpp>
+#include <SFML/Graphics/RenderStates.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+/**
+ * @brief	Interpolated position of boid i. Every update sets pos += vel, so the previous tick's
+ *          position is pos - vel and no copy of the old state is needed.
+ */
+static sf::Vector2f interpolate(const FlockState &state, size_t i, float alpha)
+{
+    const float back = 1.f - alpha;
+    return {state.posX[i] - back * state.velX[i], state.posY[i] - back * state.velY[i]};
+}
+
+void FlockRenderer::draw(sf::RenderTarget &target, const FlockState &state, float alpha)
+{
+    if (mMode == RenderMode::PerBoid)
+    {
+        drawPerBoid(target, state, alpha);
+    }
+    else
+    {
+        drawBatched(target, state, alpha);
+    }
+}
+
+const sf::Texture &FlockRenderer::circleTexture()
+{
+    if (!mTextureReady)
+    {
+        createCircleTexture();
+    }
+    return mCircleTexture;
+}
+
+void FlockRenderer::createCircleTexture()
+{
+    sf::Image image({TEXTURE_SIZE, TEXTURE_SIZE}, sf::Color::Transparent);
+    const float half = TEXTURE_SIZE / 2.f;
+    for (unsigned int y = 0; y < TEXTURE_SIZE; y++)
+    {
+        for (unsigned int x = 0; x < TEXTURE_SIZE; x++)
+        {
+            const sf::Vector2f d{x + 0.5f - half, y + 0.5f - half};
+            const float alpha = std::clamp(half - d.length(), 0.f, 1.f);
+            image.setPixel({x, y}, sf::Color(255, 255, 255, static_cast<uint8_t>(alpha * 255)));
+        }
+    }
+
+    mTextureReady = mCircleTexture.loadFromImage(image);
+    mCircleTexture.setSmooth(true);
+}
+
+/**
+ * @brief	Appends two triangles covering [p0, p1], with texture coordinates spanning [0, t].
+ */
+static void appendQuad(std::vector<sf::Vertex> &out, sf::Vector2f p0, sf::Vector2f p1, sf::Color c,
+                       float t)
+{
+    out.push_back({{p0.x, p0.y}, c, {0.f, 0.f}});
+    out.push_back({{p1.x, p0.y}, c, {t, 0.f}});
+    out.push_back({{p0.x, p1.y}, c, {0.f, t}});
+    out.push_back({{p0.x, p1.y}, c, {0.f, t}});
+    out.push_back({{p1.x, p0.y}, c, {t, 0.f}});
+    out.push_back({{p1.x, p1.y}, c, {t, t}});
+}
+
+void FlockRenderer::drawBatched(sf::RenderTarget &target, const FlockState &state, float alpha)
+{
+    const sf::View &view = target.getView();
+    const sf::Vector2f size{std::abs(view.getSize().x), std::abs(view.getSize().y)};
+    const sf::Vector2f lo = view.getCenter() - size / 2.f;
+    const sf::Vector2f hi = lo + size;
+    const float pixelsPerUnit =
+        static_cast<float>(target.getViewport(view).size.x) / std::max(size.x, 1e-6f);
+
+    float maxRadius = 0.f;
+    for (const float r : state.radius)
+    {
+        maxRadius = std::max(maxRadius, r);
+    }
+
+    // Cells of SPLAT_CELL_PX times the LOD scale are the coarsest detail drawn. They are never
+    // smaller than a boid, so widening the query by a cell catches boids binned just outside the
+    // view that reach into it, either with their radius or by being drawn up to a tick behind
+    // their binned position.
+    const float splatCellPx = SPLAT_CELL_PX * mLodScale;
+    const float pointRadiusPx = POINT_RADIUS_PX * mLodScale;
+    mScratch.reset();
+    mGrid.build(state, std::max(splatCellPx / pixelsPerUnit, 2.f * maxRadius), mScratch);
+    const float cell = mGrid.cellSize();
+    const bool splat = cell * pixelsPerUnit <= splatCellPx * 1.001f;
+    const float pad = cell + maxRadius;
+
+    mVertices.clear();
+    mPoints.clear();
+    mSplats.clear();
+    mStats = {};
+    constexpr float T = TEXTURE_SIZE;
+    mGrid.forEachCellIn(
+        {lo.x - pad, lo.y - pad}, {hi.x + pad, hi.y + pad},
+        [&](const uint32_t *indices, size_t count, Vec2 cellMin)
+        {
+            if (splat && count >= SPLAT_MIN_BOIDS)
+            {
+                // Average colour, as opaque as the discs would cover the cell.
+                uint32_t r = 0, g = 0, b = 0;
+                float area = 0.f;
+                for (size_t k = 0; k < count; k++)
+                {
+                    const Color c = state.color[indices[k]];
+                    r += c.r;
+                    g += c.g;
+                    b += c.b;
+                    area += state.radius[indices[k]] * state.radius[indices[k]];
+                }
+                const float cover =
+                    std::clamp(3.14159265f * area / (cell * cell), SPLAT_MIN_ALPHA, 1.f);
+                const auto n = static_cast<uint32_t>(count);
+                const sf::Color c(r / n, g / n, b / n, static_cast<uint8_t>(cover * 255.f));
+                const sf::Vector2f p0{cellMin.x, cellMin.y};
+                appendQuad(mSplats, p0, p0 + sf::Vector2f{cell, cell}, c, 0.f);
+                mStats.splats++;
+                return;
+            }
+
+            for (size_t k = 0; k < count; k++)
+            {
+                const uint32_t i = indices[k];
+                const float r = state.radius[i];
+                const sf::Vector2f pos = interpolate(state, i, alpha);
+                if (pos.x + r < lo.x || pos.x - r > hi.x || pos.y + r < lo.y || pos.y - r > hi.y)
+                {
+                    mStats.culled++;
+                    continue;
+                }
+
+                const sf::Color c = toSf(state.color[i]);
+                if (r * pixelsPerUnit < pointRadiusPx)
+                {
+                    mPoints.push_back({pos, c, {}});
+                }
+                else
+                {
+                    appendQuad(mVertices, pos - sf::Vector2f{r, r}, pos + sf::Vector2f{r, r}, c, T);
+                }
+            }
+        });
+    mStats.quads = mVertices.size() / 6;
+    mStats.points = mPoints.size();
+
+    if (!mSplats.empty())
+    {
+        target.draw(mSplats.data(), mSplats.size(), sf::PrimitiveType::Triangles);
+    }
+
+    if (!mVertices.empty())
+    {
+        sf::RenderStates states;
+        states.texture = &circleTexture();
+
+        // Keep the vertices in a GPU buffer when the driver has them, grown only when the
+        // visible boids outgrow it.
+        const bool fits =
+            mBuffer.getVertexCount() >= mVertices.size() || mBuffer.create(mVertices.capacity());
+        if (sf::VertexBuffer::isAvailable() && fits &&
+            mBuffer.update(mVertices.data(), mVertices.size(), 0))
+        {
+            target.draw(mBuffer, 0, mVertices.size(), states);
+        }
+        else
+        {
+            target.draw(mVertices.data(), mVertices.size(), sf::PrimitiveType::Triangles, states);
+        }
+    }
+
+    if (!mPoints.empty())
+    {
+        target.draw(mPoints.data(), mPoints.size(), sf::PrimitiveType::Points);
+    }
+}
+
+void FlockRenderer::drawPerBoid(sf::RenderTarget &target, const FlockState &state, float alpha)
+{
+    for (size_t i = 0; i < state.size(); i++)
+    {
+        const float r = state.radius[i];
+        mCirc.setRadius(r);
+        mCirc.setPosition(interpolate(state, i, alpha) - sf::Vector2f{r, r});
+        mCirc.setFillColor(toSf(state.color[i]));
+        target.draw(mCirc);
+    }
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include "core/flock_state.hpp"
+#include "core/scratch_arena.hpp"
+#include "core/spatial_grid.hpp"
+
+#include <SFML/Graphics/CircleShape.hpp>
+#include <SFML/Graphics/RenderTarget.hpp>
+#include <SFML/Graphics/Texture.hpp>
+#include <SFML/Graphics/Vertex.hpp>
+#include <SFML/Graphics/VertexBuffer.hpp>
+#include <algorithm>
+#include <vector>
+
+/**
+ * How FlockRenderer submits boids.
+ */
+enum class RenderMode
+{
+    Batched, // Culled to the view, with points and density splats for boids too small to see.
+    PerBoid, // One sf::CircleShape draw call per boid, no culling. Debug reference.
+};
+
+/**
+ * What the last batched draw submitted.
+ */
+struct RenderStats
+{
+    size_t quads = 0;  // Boids drawn as textured discs.
+    size_t points = 0; // Boids below POINT_RADIUS_PX drawn as one pixel.
+    size_t splats = 0; // Cells below SPLAT_CELL_PX drawn as one translucent square.
+    size_t culled = 0; // Boids in visited cells that were outside the view.
+};
+
+/**
+ * Draws a flock to an SFML render target.
+ *
+ * The batched mode bins the flock into a grid sized to the current zoom and only visits cells
+ * overlapping the target's view, so the vertex work follows what is on screen rather than the
+ * flock size. Boids smaller than a pixel become points, and cells smaller than a few pixels
+ * become a single square tinted with the average colour and as opaque as the boids cover it.
+ */
+class FlockRenderer
+{
+public:
+    /**
+     * @brief	Draws the boids of a flock that fall into the target's current view.
+     * @param	target	    SFML render target.
+     * @param	state	    Flock to draw.
+     * @param	alpha	    Position between the previous tick (0) and the latest one (1).
+     */
+    void draw(sf::RenderTarget &target, const FlockState &state, float alpha = 1.f);
+
+    /**
+     * @brief	White disc texture used by the batched mode, created on first use.
+     */
+    const sf::Texture &circleTexture();
+
+    /**
+     * @brief	Scales the screen sizes below which boids become points and cells splats, trading
+     *          detail for vertices in the batched mode.
+     * @param	scale	    1 for full detail, larger for coarser.
+     */
+    void setLodScale(float scale) { mLodScale = std::max(scale, 1.f); }
+    float lodScale() const { return mLodScale; }
+
+    void setMode(RenderMode mode) { mMode = mode; }
+    RenderMode mode() const { return mMode; }
+    const RenderStats &stats() const { return mStats; }
+
+private:
+    static constexpr unsigned int TEXTURE_SIZE = 64;
+    static constexpr float POINT_RADIUS_PX = 0.75f; // Screen radius below which a boid is a point.
+    static constexpr float SPLAT_CELL_PX = 4.f;     // Screen cell edge at which cells are splats.
+    static constexpr size_t SPLAT_MIN_BOIDS = 2;    // Fewer boids in a cell are drawn one by one.
+    static constexpr float SPLAT_MIN_ALPHA = 0.3f;  // Opacity of the sparsest splat.
+
+    RenderMode mMode = RenderMode::Batched;
+    float mLodScale = 1.f;
+    sf::Texture mCircleTexture;
+    bool mTextureReady = false;
+    std::vector<sf::Vertex> mVertices; // Textured quads.
+    std::vector<sf::Vertex> mPoints;
+    std::vector<sf::Vertex> mSplats; // Untextured quads.
+    sf::VertexBuffer mBuffer{sf::PrimitiveType::Triangles, sf::VertexBuffer::Usage::Stream};
+    sf::CircleShape mCirc;
+    SpatialGrid mGrid;
+    ScratchArena mScratch;
+    RenderStats mStats;
+
+    /**
+     * @brief	Builds a white disc with an anti-aliased edge. Tinted per vertex, so one texture
+     *          serves every boid.
+     */
+    void createCircleTexture();
+
+    void drawBatched(sf::RenderTarget &target, const FlockState &state, float alpha);
+    void drawPerBoid(sf::RenderTarget &target, const FlockState &state, float alpha);
+};
@@ -0,0 +1,657 @@
+#include "app/gpu_flock.hpp"
+
+#include "core/color.hpp"
+
+#include <SFML/Graphics/RenderStates.hpp>
+#include <SFML/Graphics/Vertex.hpp>
+#include <SFML/Window/Context.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <utility>
+
+// The emit pass writes sf::Vertex as five 32-bit words: position, packed color, texCoords.
+static_assert(sizeof(sf::Vertex) == 20, "unexpected sf::Vertex layout");
+static_assert(sizeof(Color) == 4, "colors are uploaded as one packed word");
+
+#if defined(_WIN32)
+#define FLOCK_GLAPI __stdcall
+#else
+#define FLOCK_GLAPI
+#endif
+
+// The few GL 4.3 names the backend uses. Declared here rather than pulling in a loader; the
+// entry points come from sf::Context::getFunction().
+using GLenum = unsigned int;
+using GLuint = unsigned int;
+using GLint = int;
+using GLsizei = int;
+using GLbitfield = unsigned int;
+using GLchar = char;
+using GLsizeiptr = std::ptrdiff_t;
+using GLintptr = std::ptrdiff_t;
+
+static constexpr GLenum GL_COMPUTE_SHADER = 0x91B9;
+static constexpr GLenum GL_COMPILE_STATUS = 0x8B81;
+static constexpr GLenum GL_LINK_STATUS = 0x8B82;
+static constexpr GLenum GL_SHADER_STORAGE_BUFFER = 0x90D2;
+static constexpr GLenum GL_DYNAMIC_COPY = 0x88EA;
+static constexpr GLbitfield GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT = 0x00000001;
+static constexpr GLbitfield GL_SHADER_STORAGE_BARRIER_BIT = 0x00002000;
+
+/**
+ * GL entry points, resolved once by init().
+ */
+struct GlFunctions
+{
+    GLuint(FLOCK_GLAPI *createShader)(GLenum);
+    void(FLOCK_GLAPI *shaderSource)(GLuint, GLsizei, const GLchar *const *, const GLint *);
+    void(FLOCK_GLAPI *compileShader)(GLuint);
+    void(FLOCK_GLAPI *getShaderiv)(GLuint, GLenum, GLint *);
+    void(FLOCK_GLAPI *getShaderInfoLog)(GLuint, GLsizei, GLsizei *, GLchar *);
+    void(FLOCK_GLAPI *deleteShader)(GLuint);
+    GLuint(FLOCK_GLAPI *createProgram)();
+    void(FLOCK_GLAPI *attachShader)(GLuint, GLuint);
+    void(FLOCK_GLAPI *linkProgram)(GLuint);
+    void(FLOCK_GLAPI *getProgramiv)(GLuint, GLenum, GLint *);
+    void(FLOCK_GLAPI *getProgramInfoLog)(GLuint, GLsizei, GLsizei *, GLchar *);
+    void(FLOCK_GLAPI *deleteProgram)(GLuint);
+    void(FLOCK_GLAPI *useProgram)(GLuint);
+    GLint(FLOCK_GLAPI *getUniformLocation)(GLuint, const GLchar *);
+    void(FLOCK_GLAPI *uniform1ui)(GLint, GLuint);
+    void(FLOCK_GLAPI *uniform1f)(GLint, float);
+    void(FLOCK_GLAPI *uniform2f)(GLint, float, float);
+    void(FLOCK_GLAPI *uniform2i)(GLint, GLint, GLint);
+    void(FLOCK_GLAPI *genBuffers)(GLsizei, GLuint *);
+    void(FLOCK_GLAPI *deleteBuffers)(GLsizei, const GLuint *);
+    void(FLOCK_GLAPI *bindBuffer)(GLenum, GLuint);
+    void(FLOCK_GLAPI *bufferData)(GLenum, GLsizeiptr, const void *, GLenum);
+    void(FLOCK_GLAPI *getBufferSubData)(GLenum, GLintptr, GLsizeiptr, void *);
+    void(FLOCK_GLAPI *bindBufferBase)(GLenum, GLuint, GLuint);
+    void(FLOCK_GLAPI *dispatchCompute)(GLuint, GLuint, GLuint);
+    void(FLOCK_GLAPI *memoryBarrier)(GLbitfield);
+};
+
+static GlFunctions gl;
+
+template <typename Fn> static bool load(Fn &fn, const char *name)
+{
+    fn = reinterpret_cast<Fn>(sf::Context::getFunction(name));
+    return fn != nullptr;
+}
+
+static bool loadGl()
+{
+    return load(gl.createShader, "glCreateShader") && load(gl.shaderSource, "glShaderSource") &&
+           load(gl.compileShader, "glCompileShader") && load(gl.getShaderiv, "glGetShaderiv") &&
+           load(gl.getShaderInfoLog, "glGetShaderInfoLog") &&
+           load(gl.deleteShader, "glDeleteShader") && load(gl.createProgram, "glCreateProgram") &&
+           load(gl.attachShader, "glAttachShader") && load(gl.linkProgram, "glLinkProgram") &&
+           load(gl.getProgramiv, "glGetProgramiv") &&
+           load(gl.getProgramInfoLog, "glGetProgramInfoLog") &&
+           load(gl.deleteProgram, "glDeleteProgram") && load(gl.useProgram, "glUseProgram") &&
+           load(gl.getUniformLocation, "glGetUniformLocation") &&
+           load(gl.uniform1ui, "glUniform1ui") && load(gl.uniform1f, "glUniform1f") &&
+           load(gl.uniform2f, "glUniform2f") && load(gl.uniform2i, "glUniform2i") &&
+           load(gl.genBuffers, "glGenBuffers") && load(gl.deleteBuffers, "glDeleteBuffers") &&
+           load(gl.bindBuffer, "glBindBuffer") && load(gl.bufferData, "glBufferData") &&
+           load(gl.getBufferSubData, "glGetBufferSubData") &&
+           load(gl.bindBufferBase, "glBindBufferBase") &&
+           load(gl.dispatchCompute, "glDispatchCompute") &&
+           load(gl.memoryBarrier, "glMemoryBarrier");
+}
+
+// Declarations shared by every program. Binding points follow GpuFlock::Buffer; the vertex
+// buffer comes after the last of them.
+static const char *const COMMON_SOURCE = R"(
+layout(std430, binding = 0) buffer PosXIn { float posXIn[]; };
+layout(std430, binding = 1) buffer PosYIn { float posYIn[]; };
+layout(std430, binding = 2) buffer VelXIn { float velXIn[]; };
+layout(std430, binding = 3) buffer VelYIn { float velYIn[]; };
+layout(std430, binding = 4) buffer PosXOut { float posXOut[]; };
+layout(std430, binding = 5) buffer PosYOut { float posYOut[]; };
+layout(std430, binding = 6) buffer VelXOut { float velXOut[]; };
+layout(std430, binding = 7) buffer VelYOut { float velYOut[]; };
+layout(std430, binding = 8) buffer Radius { float radius[]; };
+layout(std430, binding = 9) buffer Colors { uint colors[]; };
+layout(std430, binding = 10) buffer CellStart { uint cellStart[]; };
+layout(std430, binding = 11) buffer CellEnd { uint cellEnd[]; };
+layout(std430, binding = 12) buffer Sorted { uint sorted[]; };
+layout(std430, binding = 13) buffer BlockSums { uint blockSums[]; };
+layout(std430, binding = 14) buffer Vertices { uint vertices[]; };
+
+uniform uint uCount;
+uniform uint uCells;
+uniform float uCellSize;
+uniform ivec2 uGrid;
+uniform vec2 uDest;
+uniform uint uTick;
+uniform uint uSeed;
+uniform float uAlpha;
+uniform float uTexSize;
+
+// Out-of-world positions are clamped in float first so the int conversion stays defined.
+ivec2 cellOf(vec2 p)
+{
+    return ivec2(clamp(floor(p / uCellSize), vec2(0.0), vec2(uGrid - 1)));
+}
+
+uint cellIndex(ivec2 c)
+{
+    return uint(c.y * uGrid.x + c.x);
+}
+)";
+
+static const char *const CLEAR_CELLS_SOURCE = R"(
+void main()
+{
+    uint c = gl_GlobalInvocationID.x;
+    if (c < uCells)
+    {
+        cellEnd[c] = 0u;
+    }
+}
+)";
+
+static const char *const COUNT_CELLS_SOURCE = R"(
+void main()
+{
+    uint i = gl_GlobalInvocationID.x;
+    if (i < uCount)
+    {
+        atomicAdd(cellEnd[cellIndex(cellOf(vec2(posXIn[i], posYIn[i])))], 1u);
+    }
+}
+)";
+
+// Hillis-Steele scan in shared memory. SCAN_SIZE is the workgroup size of the program.
+static const char *const SCAN_SOURCE = R"(
+shared uint sums[SCAN_SIZE];
+
+uint inclusiveScan(uint value)
+{
+    uint l = gl_LocalInvocationID.x;
+    sums[l] = value;
+    barrier();
+    for (uint offset = 1u; offset < SCAN_SIZE; offset <<= 1)
+    {
+        uint add = l >= offset ? sums[l - offset] : 0u;
+        barrier();
+        sums[l] += add;
+        barrier();
+    }
+    return sums[l];
+}
+)";
+
+static const char *const SCAN_BLOCKS_SOURCE = R"(
+void main()
+{
+    uint c = gl_GlobalInvocationID.x;
+    uint count = c < uCells ? cellEnd[c] : 0u;
+    uint total = inclusiveScan(count);
+    if (c < uCells)
+    {
+        cellStart[c] = total - count;
+    }
+    if (gl_LocalInvocationID.x == SCAN_SIZE - 1u)
+    {
+        blockSums[gl_WorkGroupID.x] = total;
+    }
+}
+)";
+
+static const char *const SCAN_SUMS_SOURCE = R"(
+void main()
+{
+    uint b = gl_LocalInvocationID.x;
+    uint blocks = (uCells + GROUP_SIZE - 1u) / GROUP_SIZE;
+    uint sum = b < blocks ? blockSums[b] : 0u;
+    uint total = inclusiveScan(sum);
+    if (b < blocks)
+    {
+        blockSums[b] = total - sum;
+    }
+}
+)";
+
+static const char *const ADD_OFFSETS_SOURCE = R"(
+void main()
+{
+    uint c = gl_GlobalInvocationID.x;
+    if (c < uCells)
+    {
+        uint start = cellStart[c] + blockSums[c / GROUP_SIZE];
+        cellStart[c] = start;
+        cellEnd[c] = start;
+    }
+}
+)";
+
+static const char *const SCATTER_SOURCE = R"(
+void main()
+{
+    uint i = gl_GlobalInvocationID.x;
+    if (i < uCount)
+    {
+        uint cell = cellIndex(cellOf(vec2(posXIn[i], posYIn[i])));
+        sorted[atomicAdd(cellEnd[cell], 1u)] = i;
+    }
+}
+)";
+
+// Same rules and order of operations as Flock::updateRange(). Noise is the counter hash of
+// core/counter_rng.hpp on (seed, tick, boid), keyed on the slot since the GPU never reorders.
+static const char *const INTEGRATE_SOURCE = R"(
+uint hash(uint x)
+{
+    x ^= x >> 16;
+    x *= 0x7feb352du;
+    x ^= x >> 15;
+    x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x;
+}
+
+float noise(uint key)
+{
+    return float(hash(key) >> 8) * (2.0 / 16777216.0) - 1.0;
+}
+
+void main()
+{
+    uint i = gl_GlobalInvocationID.x;
+    if (i >= uCount)
+    {
+        return;
+    }
+
+    vec2 pos = vec2(posXIn[i], posYIn[i]);
+    vec2 vel = vec2(velXIn[i], velYIn[i]);
+    float r = radius[i];
+
+    vec2 separation = vec2(0.0);
+    vec2 avgVel = vec2(0.0);
+    vec2 avgPos = vec2(0.0);
+    uint count = 0u;
+
+    ivec2 c = cellOf(pos);
+    for (int y = max(c.y - 1, 0); y <= min(c.y + 1, uGrid.y - 1); y++)
+    {
+        for (int x = max(c.x - 1, 0); x <= min(c.x + 1, uGrid.x - 1); x++)
+        {
+            uint cell = cellIndex(ivec2(x, y));
+            for (uint k = cellStart[cell]; k < cellEnd[cell]; k++)
+            {
+                uint j = sorted[k];
+                if (j == i)
+                {
+                    continue;
+                }
+                vec2 other = vec2(posXIn[j], posYIn[j]);
+                vec2 toOther = other - pos;
+                float len = length(toOther);
+                float dist = len - (r + radius[j]);
+                if (dist < VISUAL_RANGE)
+                {
+                    separation -= toOther / (len * exp2(dist));
+                    avgVel += vec2(velXIn[j], velYIn[j]);
+                    avgPos += other;
+                    count++;
+                }
+            }
+        }
+    }
+
+    if (count > 0u)
+    {
+        avgVel /= float(count);
+        avgPos /= float(count);
+    }
+
+    vec2 toDest = normalize(uDest - pos) * MAX_SPEED;
+
+    vel += separation * AVOID_FACTOR;
+    vel += MATCHING_FACTOR * (avgVel - vel);
+    vel += CENTERING_FACTOR * (avgPos - pos);
+    vel = (1.0 - BIAS_VAL) * vel + BIAS_VAL * toDest;
+
+    uint key = hash(uSeed ^ hash(uTick)) + 2u * i;
+    vel += vec2(noise(key), noise(key + 1u)) * NOISE_STRENGTH;
+
+    float speed = length(vel);
+    if (speed > MAX_SPEED)
+    {
+        vel *= MAX_SPEED / (speed + 1e-2);
+    }
+    else if (speed < MIN_SPEED)
+    {
+        vel *= MIN_SPEED / (speed + 1e-2);
+    }
+
+    velXOut[i] = vel.x;
+    velYOut[i] = vel.y;
+    posXOut[i] = pos.x + vel.x;
+    posYOut[i] = pos.y + vel.y;
+}
+)";
+
+// Two triangles per boid in the same corner order as FlockRenderer::drawBatched().
+static const char *const EMIT_SOURCE = R"(
+const vec2 CORNERS[6] = vec2[6](vec2(0.0, 0.0), vec2(1.0, 0.0), vec2(0.0, 1.0),
+                                vec2(0.0, 1.0), vec2(1.0, 0.0), vec2(1.0, 1.0));
+
+void main()
+{
+    uint i = gl_GlobalInvocationID.x;
+    if (i >= uCount)
+    {
+        return;
+    }
+
+    float back = 1.0 - uAlpha;
+    vec2 pos = vec2(posXIn[i] - back * velXIn[i], posYIn[i] - back * velYIn[i]);
+    vec2 lo = pos - radius[i];
+    vec2 hi = pos + radius[i];
+    uint color = colors[i];
+
+    for (uint v = 0u; v < 6u; v++)
+    {
+        vec2 corner = CORNERS[v];
+        vec2 p = mix(lo, hi, corner);
+        uint base = (i * 6u + v) * 5u;
+        vertices[base + 0u] = floatBitsToUint(p.x);
+        vertices[base + 1u] = floatBitsToUint(p.y);
+        vertices[base + 2u] = color;
+        vertices[base + 3u] = floatBitsToUint(corner.x * uTexSize);
+        vertices[base + 4u] = floatBitsToUint(corner.y * uTexSize);
+    }
+}
+)";
+
+GpuFlock::GpuFlock(Vec2 worldSize, uint32_t seed) : mWorldSize(worldSize), mSeed(seed) {}
+
+GpuFlock::~GpuFlock()
+{
+    if (!mReady)
+    {
+        return;
+    }
+    gl.deleteBuffers(BUFFER_COUNT, mBuffers);
+    for (unsigned int program : mPrograms)
+    {
+        gl.deleteProgram(program);
+    }
+}
+
+bool GpuFlock::init(const sf::ContextSettings &settings)
+{
+    if (settings.majorVersion * 10 + settings.minorVersion < 43)
+    {
+        mError = "OpenGL 4.3 is required for compute shaders, context is " +
+                 std::to_string(settings.majorVersion) + "." +
+                 std::to_string(settings.minorVersion);
+        return false;
+    }
+    if (!loadGl())
+    {
+        mError = "missing OpenGL 4.3 entry points";
+        return false;
+    }
+
+    const std::pair<Program, const char *> programs[] = {
+        {CLEAR_CELLS, CLEAR_CELLS_SOURCE}, {COUNT_CELLS, COUNT_CELLS_SOURCE},
+        {SCAN_BLOCKS, SCAN_BLOCKS_SOURCE}, {SCAN_SUMS, SCAN_SUMS_SOURCE},
+        {ADD_OFFSETS, ADD_OFFSETS_SOURCE}, {SCATTER, SCATTER_SOURCE},
+        {INTEGRATE, INTEGRATE_SOURCE},     {EMIT, EMIT_SOURCE},
+    };
+    for (const auto &[program, source] : programs)
+    {
+        if (!compile(program, source))
+        {
+            return false;
+        }
+    }
+
+    gl.genBuffers(BUFFER_COUNT, mBuffers);
+    mReady = true;
+    return true;
+}
+
+bool GpuFlock::compile(Program program, const char *source)
+{
+    const unsigned int groupSize = program == SCAN_SUMS ? MAX_BLOCKS : GROUP_SIZE;
+
+    // Rule constants are baked in so the compiler folds them like the CPU preset path does. %#g
+    // keeps the decimal point, so every value is a float literal in GLSL.
+    char defines[1024];
+    std::snprintf(defines, sizeof(defines),
+                  "#version 430\n"
+                  "layout(local_size_x = %u) in;\n"
+                  "#define GROUP_SIZE %uu\n"
+                  "#define SCAN_SIZE %uu\n"
+                  "#define AVOID_FACTOR %#.9g\n"
+                  "#define VISUAL_RANGE %#.9g\n"
+                  "#define CENTERING_FACTOR %#.9g\n"
+                  "#define MATCHING_FACTOR %#.9g\n"
+                  "#define MAX_SPEED %#.9g\n"
+                  "#define MIN_SPEED %#.9g\n"
+                  "#define BIAS_VAL %#.9g\n"
+                  "#define NOISE_STRENGTH %#.9g\n",
+                  groupSize, GROUP_SIZE, groupSize, mParams.avoidFactor, mParams.visualRange,
+                  mParams.centeringFactor, mParams.matchingFactor, mParams.maxSpeed,
+                  mParams.minSpeed, mParams.biasVal, mParams.noiseStrength);
+
+    const bool scan = program == SCAN_BLOCKS || program == SCAN_SUMS;
+    const GLchar *sources[] = {defines, COMMON_SOURCE, scan ? SCAN_SOURCE : "", source};
+
+    const GLuint shader = gl.createShader(GL_COMPUTE_SHADER);
+    gl.shaderSource(shader, 4, sources, nullptr);
+    gl.compileShader(shader);
+
+    GLint ok = 0;
+    gl.getShaderiv(shader, GL_COMPILE_STATUS, &ok);
+    if (!ok)
+    {
+        char log[2048] = {};
+        gl.getShaderInfoLog(shader, sizeof(log), nullptr, log);
+        mError = std::string("compute shader failed to compile: ") + log;
+        gl.deleteShader(shader);
+        return false;
+    }
+
+    mPrograms[program] = gl.createProgram();
+    gl.attachShader(mPrograms[program], shader);
+    gl.linkProgram(mPrograms[program]);
+    gl.deleteShader(shader);
+
+    gl.getProgramiv(mPrograms[program], GL_LINK_STATUS, &ok);
+    if (!ok)
+    {
+        char log[2048] = {};
+        gl.getProgramInfoLog(mPrograms[program], sizeof(log), nullptr, log);
+        mError = std::string("compute program failed to link: ") + log;
+        return false;
+    }
+    return true;
+}
+
+void GpuFlock::upload(const FlockState &state)
+{
+    if (!mReady)
+    {
+        return;
+    }
+
+    mCount = state.size();
+    mMaxRadius = mCount > 0 ? *std::max_element(state.radius.begin(), state.radius.end()) : 0.f;
+
+    auto fill = [](GLuint buffer, size_t bytes, const void *data)
+    {
+        gl.bindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+        gl.bufferData(GL_SHADER_STORAGE_BUFFER, static_cast<GLsizeiptr>(bytes), data,
+                      GL_DYNAMIC_COPY);
+    };
+    const size_t floats = mCount * sizeof(float);
+    fill(mBuffers[POS_X_IN], floats, state.posX.data());
+    fill(mBuffers[POS_Y_IN], floats, state.posY.data());
+    fill(mBuffers[VEL_X_IN], floats, state.velX.data());
+    fill(mBuffers[VEL_Y_IN], floats, state.velY.data());
+    fill(mBuffers[POS_X_OUT], floats, nullptr);
+    fill(mBuffers[POS_Y_OUT], floats, nullptr);
+    fill(mBuffers[VEL_X_OUT], floats, nullptr);
+    fill(mBuffers[VEL_Y_OUT], floats, nullptr);
+    fill(mBuffers[RADIUS], floats, state.radius.data());
+    fill(mBuffers[COLOR], mCount * sizeof(Color), state.color.data());
+    fill(mBuffers[SORTED], mCount * sizeof(uint32_t), nullptr);
+    fill(mBuffers[BLOCK_SUMS], MAX_BLOCKS * sizeof(uint32_t), nullptr);
+    gl.bindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    layoutGrid();
+
+    if (mVertices.getVertexCount() < mCount * 6 && !mVertices.create(mCount * 6))
+    {
+        mError = "could not allocate the vertex buffer";
+        mCount = 0;
+    }
+}
+
+void GpuFlock::download(FlockState &state) const
+{
+    if (!mReady || state.size() != mCount)
+    {
+        return;
+    }
+
+    // update() swaps the buffers after each tick, so the latest boids are in the in buffers.
+    auto read = [](GLuint buffer, size_t bytes, void *data)
+    {
+        gl.bindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+        gl.getBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, static_cast<GLsizeiptr>(bytes), data);
+    };
+    const size_t floats = mCount * sizeof(float);
+    read(mBuffers[POS_X_IN], floats, state.posX.data());
+    read(mBuffers[POS_Y_IN], floats, state.posY.data());
+    read(mBuffers[VEL_X_IN], floats, state.velX.data());
+    read(mBuffers[VEL_Y_IN], floats, state.velY.data());
+    gl.bindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void GpuFlock::layoutGrid()
+{
+    // Same cell size as the CPU grid, grown until the table fits the two-level scan.
+    mCellSize = mParams.visualRange + 2.f * mMaxRadius;
+    do
+    {
+        mCols = std::max(1, static_cast<int>(std::ceil(mWorldSize.x / mCellSize)));
+        mRows = std::max(1, static_cast<int>(std::ceil(mWorldSize.y / mCellSize)));
+        if (static_cast<size_t>(mCols) * mRows <= MAX_CELLS)
+        {
+            break;
+        }
+        mCellSize *= 2.f;
+    } while (true);
+
+    const GLsizeiptr bytes = static_cast<GLsizeiptr>(mCols) * mRows * sizeof(uint32_t);
+    for (Buffer table : {CELL_START, CELL_END})
+    {
+        gl.bindBuffer(GL_SHADER_STORAGE_BUFFER, mBuffers[table]);
+        gl.bufferData(GL_SHADER_STORAGE_BUFFER, bytes, nullptr, GL_DYNAMIC_COPY);
+    }
+    gl.bindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void GpuFlock::setParams(const FlockParams &params)
+{
+    const bool rangeChanged = params.visualRange != mParams.visualRange;
+    mParams = params;
+    if (!mReady)
+    {
+        return;
+    }
+
+    gl.deleteProgram(mPrograms[INTEGRATE]);
+    mPrograms[INTEGRATE] = 0;
+    if (!compile(INTEGRATE, INTEGRATE_SOURCE))
+    {
+        // Only the constants changed, so this takes a broken driver. Stop rather than draw junk.
+        mCount = 0;
+        return;
+    }
+    if (rangeChanged)
+    {
+        layoutGrid();
+    }
+}
+
+void GpuFlock::update()
+{
+    if (!mReady || mCount == 0)
+    {
+        return;
+    }
+
+    const size_t cells = static_cast<size_t>(mCols) * mRows;
+    dispatch(CLEAR_CELLS, cells);
+    dispatch(COUNT_CELLS, mCount);
+    dispatch(SCAN_BLOCKS, cells);
+    dispatch(SCAN_SUMS, MAX_BLOCKS, MAX_BLOCKS);
+    dispatch(ADD_OFFSETS, cells);
+    dispatch(SCATTER, mCount);
+    dispatch(INTEGRATE, mCount);
+    gl.useProgram(0);
+
+    std::swap(mBuffers[POS_X_IN], mBuffers[POS_X_OUT]);
+    std::swap(mBuffers[POS_Y_IN], mBuffers[POS_Y_OUT]);
+    std::swap(mBuffers[VEL_X_IN], mBuffers[VEL_X_OUT]);
+    std::swap(mBuffers[VEL_Y_IN], mBuffers[VEL_Y_OUT]);
+    mTick++;
+}
+
+void GpuFlock::draw(sf::RenderTarget &target, const sf::Texture &texture, float alpha)
+{
+    if (!mReady || mCount == 0)
+    {
+        return;
+    }
+
+    mAlpha = alpha;
+    mTexSize = static_cast<float>(texture.getSize().x);
+    dispatch(EMIT, mCount);
+    gl.memoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+    gl.useProgram(0);
+
+    // SFML caches GL state, so tell it everything may have changed before it draws.
+    target.resetGLStates();
+    sf::RenderStates states;
+    states.texture = &texture;
+    target.draw(mVertices, 0, mCount * 6, states);
+}
+
+void GpuFlock::dispatch(Program program, size_t items, unsigned int groupSize)
+{
+    const GLuint id = mPrograms[program];
+    gl.useProgram(id);
+
+    for (GLuint b = 0; b < BUFFER_COUNT; b++)
+    {
+        gl.bindBufferBase(GL_SHADER_STORAGE_BUFFER, b, mBuffers[b]);
+    }
+    gl.bindBufferBase(GL_SHADER_STORAGE_BUFFER, BUFFER_COUNT, mVertices.getNativeHandle());
+
+    // Uniforms a program does not use have location -1, which GL ignores.
+    gl.uniform1ui(gl.getUniformLocation(id, "uCount"), static_cast<GLuint>(mCount));
+    gl.uniform1ui(gl.getUniformLocation(id, "uCells"), static_cast<GLuint>(mCols * mRows));
+    gl.uniform1f(gl.getUniformLocation(id, "uCellSize"), mCellSize);
+    gl.uniform2i(gl.getUniformLocation(id, "uGrid"), mCols, mRows);
+    gl.uniform2f(gl.getUniformLocation(id, "uDest"), mDest.x, mDest.y);
+    gl.uniform1ui(gl.getUniformLocation(id, "uTick"), mTick);
+    gl.uniform1ui(gl.getUniformLocation(id, "uSeed"), mSeed);
+    gl.uniform1f(gl.getUniformLocation(id, "uAlpha"), mAlpha);
+    gl.uniform1f(gl.getUniformLocation(id, "uTexSize"), mTexSize);
+
+    const size_t groups = (items + groupSize - 1) / groupSize;
+    gl.dispatchCompute(static_cast<GLuint>(std::max<size_t>(groups, 1)), 1, 1);
+    gl.memoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+}
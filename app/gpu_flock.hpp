@@ -0,0 +1,175 @@
+#pragma once
+
+#include "core/flock_params.hpp"
+#include "core/flock_state.hpp"
+#include "core/vec2.hpp"
+
+#include <SFML/Graphics/RenderTarget.hpp>
+#include <SFML/Graphics/Texture.hpp>
+#include <SFML/Graphics/VertexBuffer.hpp>
+#include <SFML/Window/ContextSettings.hpp>
+#include <cstdint>
+#include <string>
+
+/**
+ * Runs the flocking rules of Flock::update() in OpenGL 4.3 compute shaders. The flock lives in
+ * shader storage buffers, is binned each tick by a counting sort on the GPU, and is written
+ * straight into the vertex buffer that is drawn, so nothing is read back to the CPU.
+ *
+ * All calls need the GL context of the render window to be active on the calling thread.
+ */
+class GpuFlock
+{
+public:
+    /**
+     * @brief	Construct a new Gpu Flock object. Nothing touches GL until init().
+     * @param	worldSize	Area covered by the grid. Boids outside it share the border cells.
+     * @param	seed	    Seed of the per-boid noise.
+     */
+    GpuFlock(Vec2 worldSize, uint32_t seed);
+    ~GpuFlock();
+
+    GpuFlock(const GpuFlock &) = delete;
+    GpuFlock &operator=(const GpuFlock &) = delete;
+
+    /**
+     * @brief	Loads the GL entry points and compiles the shaders.
+     * @param	settings	Settings of the active context, e.g. sf::Window::getSettings().
+     * @return	false if the context is older than 4.3 or a shader fails. See error().
+     */
+    bool init(const sf::ContextSettings &settings);
+    const std::string &error() const { return mError; }
+
+    /**
+     * @brief	Replaces the GPU flock with a copy of state.
+     * @param	state	    Boids to upload.
+     */
+    void upload(const FlockState &state);
+
+    /**
+     * @brief	Reads the positions and velocities back, to check the GPU against the CPU. Waits for
+     *          every pass queued so far.
+     * @param	state	    Receives them. Must hold size() boids, e.g. a copy of the upload.
+     */
+    void download(FlockState &state) const;
+
+    /**
+     * @brief	Restarts the noise stream, e.g. to continue that of a Flock. Slot i draws the noise
+     *          a Flock draws for id i, so the two match when the upload is in id order.
+     * @param	seed	    Seed of the noise stream.
+     * @param	tick	    Tick to continue the stream from.
+     */
+    void setNoise(uint32_t seed, uint32_t tick)
+    {
+        mSeed = seed;
+        mTick = tick;
+    }
+
+    /**
+     * @brief	Set the destination for all boids to move towards.
+     * @param	newDest	    New destination.
+     */
+    void setDest(Vec2 newDest) { mDest = newDest; }
+
+    /**
+     * @brief	Replaces the rule constants. They are baked into the shaders, so this recompiles the
+     *          integrate pass, and resizes the grid if the visual range changed. The far field
+     *          has no GPU pass and is ignored.
+     * @param	params	    New rule constants.
+     */
+    void setParams(const FlockParams &params);
+
+    /**
+     * @brief	Runs one tick: rebins the flock on the GPU, then updates every boid (Jacobi).
+     */
+    void update();
+
+    /**
+     * @brief	Writes one textured quad per boid into the vertex buffer and draws it.
+     * @param	target	    Render target whose context the flock lives in.
+     * @param	texture	    Disc texture mapped onto each quad.
+     * @param	alpha	    Position between the previous tick (0) and the latest one (1).
+     */
+    void draw(sf::RenderTarget &target, const sf::Texture &texture, float alpha);
+
+    size_t size() const { return mCount; }
+
+private:
+    static constexpr unsigned int GROUP_SIZE = 256;  // local_size_x of the per-item passes.
+    static constexpr unsigned int MAX_BLOCKS = 1024; // Workgroups the block-sum scan covers.
+    static constexpr size_t MAX_CELLS = GROUP_SIZE * MAX_BLOCKS;
+
+    /**
+     * One shader storage buffer per column, plus the grid tables.
+     */
+    enum Buffer
+    {
+        POS_X_IN,
+        POS_Y_IN,
+        VEL_X_IN,
+        VEL_Y_IN,
+        POS_X_OUT,
+        POS_Y_OUT,
+        VEL_X_OUT,
+        VEL_Y_OUT,
+        RADIUS,
+        COLOR,
+        CELL_START,
+        CELL_END,
+        SORTED,
+        BLOCK_SUMS,
+        BUFFER_COUNT,
+    };
+
+    /**
+     * Compute programs, in dispatch order.
+     */
+    enum Program
+    {
+        CLEAR_CELLS, // cellEnd = 0
+        COUNT_CELLS, // cellEnd[cell] += 1 per boid
+        SCAN_BLOCKS, // Exclusive scan within each workgroup, block totals to blockSums.
+        SCAN_SUMS,   // Exclusive scan of blockSums in one workgroup.
+        ADD_OFFSETS, // cellStart += blockSums, cellEnd = cellStart
+        SCATTER,     // sorted[atomicAdd(cellEnd[cell], 1)] = boid
+        INTEGRATE,   // Flocking rules, in buffers to out buffers.
+        EMIT,        // Six sf::Vertex per boid into the vertex buffer.
+        PROGRAM_COUNT,
+    };
+
+    Vec2 mWorldSize;
+    uint32_t mSeed;
+    std::string mError;
+    bool mReady = false;
+
+    size_t mCount = 0;
+    uint32_t mTick = 0;
+    Vec2 mDest;
+    FlockParams mParams;
+    float mMaxRadius = 0.f;
+    float mCellSize = 1.f;
+    int mCols = 0;
+    int mRows = 0;
+    float mAlpha = 1.f;
+    float mTexSize = 1.f;
+
+    unsigned int mBuffers[BUFFER_COUNT] = {};
+    unsigned int mPrograms[PROGRAM_COUNT] = {};
+    sf::VertexBuffer mVertices{sf::PrimitiveType::Triangles, sf::VertexBuffer::Usage::Stream};
+
+    bool compile(Program program, const char *source);
+
+    /**
+     * @brief	Sizes the grid for the current visual range and largest radius, and reallocates its
+     *          tables.
+     */
+    void layoutGrid();
+
+    /**
+     * @brief	Binds every buffer, sets the shared uniforms and dispatches one invocation per item.
+     * @param	program	    Program to run.
+     * @param	items	    Number of invocations wanted.
+     * @param	groupSize	local_size_x of the program.
+     */
+    void dispatch(Program program, size_t items, unsigned int groupSize = GROUP_SIZE);
+};
@@ -0,0 +1,133 @@
+#include "app/profiler_overlay.hpp"
+
+#include <SFML/Graphics/Color.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <iterator>
+
+/**
+ * @brief	Bar colour of each phase, indexed by Phase.
+ */
+static const sf::Color PHASE_COLORS[] = {
+    sf::Color(120, 120, 120), // Events
+    sf::Color(60, 110, 200),  // Tick
+    sf::Color(80, 160, 255),  // Update
+    sf::Color(255, 200, 60),  // Search
+    sf::Color(90, 220, 120),  // Integrate
+    sf::Color(230, 110, 230), // Draw
+    sf::Color(240, 90, 80),   // Display
+};
+static_assert(std::size(PHASE_COLORS) == static_cast<size_t>(Phase::Count));
+
+void ProfilerOverlay::draw(sf::RenderTarget &target)
+{
+    const Profiler &profiler = Profiler::get();
+    constexpr float WIDTH = BINS * BIN_WIDTH;
+    constexpr float BAR_HEIGHT = ROW_HEIGHT - 4.f;
+    constexpr size_t PHASES = static_cast<size_t>(Phase::Count);
+
+    const float rows = PHASES + (mLevels > 0 ? 1.f : 0.f);
+
+    mVertices.clear();
+    addRect(MARGIN - 2.f, MARGIN - 2.f, MARGIN + WIDTH + 2.f, MARGIN + rows * ROW_HEIGHT,
+            sf::Color(0, 0, 0, 180));
+
+    // Decade ticks, shared by every row.
+    for (int d = 0; d <= static_cast<int>(DECADES); d++)
+    {
+        const float x = MARGIN + d * WIDTH / DECADES;
+        addRect(x, MARGIN, x + 1.f, MARGIN + PHASES * ROW_HEIGHT - 4.f, sf::Color(60, 60, 60));
+    }
+
+    uint32_t bins[BINS];
+    for (size_t p = 0; p < PHASES; p++)
+    {
+        const Phase phase = static_cast<Phase>(p);
+        const PhaseSummary s = profiler.summary(phase);
+        if (s.samples == 0)
+        {
+            continue;
+        }
+
+        profiler.histogram(phase, bins, BINS, MIN_US, DECADES);
+        const uint32_t peak = *std::max_element(bins, bins + BINS);
+        const float y1 = MARGIN + p * ROW_HEIGHT + BAR_HEIGHT;
+        for (size_t b = 0; b < BINS; b++)
+        {
+            if (bins[b] == 0)
+            {
+                continue;
+            }
+            const float x0 = MARGIN + b * BIN_WIDTH;
+            const float h = std::max(1.f, BAR_HEIGHT * bins[b] / peak);
+            addRect(x0, y1 - h, x0 + BIN_WIDTH - 1.f, y1, PHASE_COLORS[p]);
+        }
+
+        const float t = std::log10(std::max(s.p95, MIN_US) / MIN_US) / DECADES;
+        const float x = MARGIN + std::min(t, 1.f) * WIDTH;
+        addRect(x - 1.f, y1 - BAR_HEIGHT, x + 1.f, y1, sf::Color::White);
+    }
+
+    if (mLevels > 0)
+    {
+        // Quality pips on the left half, the load against a budget mark at 3/4 on the right.
+        const float y0 = MARGIN + PHASES * ROW_HEIGHT;
+        const float pip = WIDTH / 2.f / mLevels;
+        for (size_t l = 0; l < mLevels; l++)
+        {
+            const sf::Color c = l <= mLevel ? sf::Color(255, 160, 40) : sf::Color(60, 60, 60);
+            addRect(MARGIN + l * pip, y0, MARGIN + (l + 1) * pip - 2.f, y0 + BAR_HEIGHT, c);
+        }
+        const float x0 = MARGIN + WIDTH / 2.f + 4.f;
+        const float span = MARGIN + WIDTH - x0;
+        const float t = std::clamp(mLoad * 0.75f, 0.f, 1.f);
+        const sf::Color c = mLoad > 1.f ? sf::Color(240, 90, 80) : sf::Color(90, 220, 120);
+        addRect(x0, y0 + BAR_HEIGHT / 4.f, x0 + t * span, y0 + BAR_HEIGHT * 0.75f, c);
+        addRect(x0 + 0.75f * span - 1.f, y0, x0 + 0.75f * span + 1.f, y0 + BAR_HEIGHT,
+                sf::Color::White);
+    }
+
+    target.draw(mVertices.data(), mVertices.size(), sf::PrimitiveType::Triangles);
+}
+
+std::string ProfilerOverlay::summaryText() const
+{
+    const Profiler &profiler = Profiler::get();
+    std::string text;
+    char buffer[64];
+    for (size_t p = 0; p < static_cast<size_t>(Phase::Count); p++)
+    {
+        const Phase phase = static_cast<Phase>(p);
+        const PhaseSummary s = profiler.summary(phase);
+        if (s.samples == 0)
+        {
+            continue;
+        }
+        std::snprintf(buffer, sizeof(buffer), "%s%s %.2f/%.2f", text.empty() ? "" : " | ",
+                      Profiler::name(phase), s.p50 * 1e-3f, s.p95 * 1e-3f);
+        text += buffer;
+    }
+    if (!text.empty())
+    {
+        text = "p50/p95 ms: " + text;
+    }
+    if (mLevels > 0)
+    {
+        std::snprintf(buffer, sizeof(buffer), "%squality %zu/%zu at %.0f%% of budget",
+                      text.empty() ? "" : " | ", mLevel, mLevels - 1, mLoad * 100.f);
+        text += buffer;
+    }
+    return text;
+}
+
+void ProfilerOverlay::addRect(float x0, float y0, float x1, float y1, sf::Color color)
+{
+    mVertices.push_back({{x0, y0}, color, {}});
+    mVertices.push_back({{x1, y0}, color, {}});
+    mVertices.push_back({{x0, y1}, color, {}});
+    mVertices.push_back({{x0, y1}, color, {}});
+    mVertices.push_back({{x1, y0}, color, {}});
+    mVertices.push_back({{x1, y1}, color, {}});
+}
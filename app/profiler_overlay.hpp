@@ -0,0 +1,58 @@
+#pragma once
+
+#include "core/profiler.hpp"
+
+#include <SFML/Graphics/RenderTarget.hpp>
+#include <SFML/Graphics/Vertex.hpp>
+#include <string>
+#include <vector>
+
+/**
+ * Draws the live phase timings of Profiler in the corner of a render target: one row per phase,
+ * each a log-scale histogram of its recent durations with a marker at the 95th percentile. The
+ * repo ships no font, so the numbers go to summaryText() for the window title instead.
+ */
+class ProfilerOverlay
+{
+public:
+    /**
+     * @brief	Draws the histograms in the top left corner, in the target's current view.
+     * @param	target	    SFML render target.
+     */
+    void draw(sf::RenderTarget &target);
+
+    /**
+     * @brief	One line of p50 / p95 per phase that has samples, in milliseconds, and the quality
+     *          level if one was set.
+     */
+    std::string summaryText() const;
+
+    /**
+     * @brief	Sets the quality level shown under the histograms: one pip per level, lit up to the
+     *          current one, and a bar of the frame cost against its budget.
+     * @param	level	    Current level, 0 being full quality.
+     * @param	levels	    Number of levels. 0 hides the row.
+     * @param	load	    Frame cost as a fraction of the budget.
+     */
+    void setQuality(size_t level, size_t levels, float load)
+    {
+        mLevel = level;
+        mLevels = levels;
+        mLoad = load;
+    }
+
+private:
+    static constexpr size_t BINS = 40;        // Histogram bins per phase.
+    static constexpr float MIN_US = 1.f;      // Lower edge of the first bin.
+    static constexpr float DECADES = 5.f;     // 1 us to 100 ms.
+    static constexpr float BIN_WIDTH = 6.f;   // Pixels per bin.
+    static constexpr float ROW_HEIGHT = 28.f; // Pixels per phase, including the gap.
+    static constexpr float MARGIN = 8.f;      // Pixels to the window edge.
+
+    std::vector<sf::Vertex> mVertices;
+    size_t mLevel = 0;
+    size_t mLevels = 0;
+    float mLoad = 0.f;
+
+    void addRect(float x0, float y0, float x1, float y1, sf::Color color);
+};
@@ -0,0 +1,15 @@
+#pragma once
+
+#include "core/color.hpp"
+#include "core/vec2.hpp"
+
+#include <SFML/Graphics/Color.hpp>
+#include <SFML/System/Vector2.hpp>
+
+/**
+ * Conversions between the simulation's math types and their SFML counterparts.
+ */
+
+inline sf::Vector2f toSf(Vec2 v) { return {v.x, v.y}; }
+inline sf::Color toSf(Color c) { return sf::Color(c.r, c.g, c.b, c.a); }
+inline Vec2 toVec2(sf::Vector2f v) { return {v.x, v.y}; }
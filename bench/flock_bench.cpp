@@ -0,0 +1,885 @@
+/**
+ * Headless benchmark of the flock simulation. Runs a number of ticks on a seeded random flock and
+ * prints timings and neighbour-pair counts as JSON. With --verify it instead checks every CPU
+ * update kernel against the scalar brute-force reference and exits non-zero on a mismatch.
+ */
+
+#include "core/flock.hpp"
+#include "core/flock_params.hpp"
+#include "core/profiler.hpp"
+#include "core/snapshot.hpp"
+#include "core/thread_pool.hpp"
+#include "core/trajectory_recorder.hpp"
+#include "core/world.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// Every heap allocation of the process goes through these, so the benchmark can report how many
+// happen per tick. Steady state should be zero.
+static std::atomic<uint64_t> gAllocations{0};
+
+static void *countedAlloc(size_t size, size_t align)
+{
+    gAllocations.fetch_add(1, std::memory_order_relaxed);
+    // aligned_alloc wants a size that is a multiple of the alignment.
+    size = std::max(size, size_t{1});
+    void *p = align <= alignof(std::max_align_t)
+                  ? std::malloc(size)
+                  : std::aligned_alloc(align, (size + align - 1) / align * align);
+    if (!p)
+    {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void *operator new(size_t size) { return countedAlloc(size, 0); }
+void *operator new[](size_t size) { return countedAlloc(size, 0); }
+void *operator new(size_t size, std::align_val_t align)
+{
+    return countedAlloc(size, static_cast<size_t>(align));
+}
+void *operator new[](size_t size, std::align_val_t align)
+{
+    return countedAlloc(size, static_cast<size_t>(align));
+}
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete[](void *p) noexcept { std::free(p); }
+void operator delete(void *p, size_t) noexcept { std::free(p); }
+void operator delete[](void *p, size_t) noexcept { std::free(p); }
+void operator delete(void *p, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void *p, std::align_val_t) noexcept { std::free(p); }
+void operator delete(void *p, size_t, std::align_val_t) noexcept { std::free(p); }
+void operator delete[](void *p, size_t, std::align_val_t) noexcept { std::free(p); }
+
+/**
+ * One benchmark configuration.
+ */
+struct BenchConfig
+{
+    unsigned int boids = 10000;
+    unsigned int ticks = 200;
+    unsigned int warmup = 20;
+    uint32_t seed = 1;
+    unsigned int width = 1524;
+    unsigned int height = 1024;
+    NeighbourSearch search = NeighbourSearch::Grid;
+    UpdateScheme scheme = UpdateScheme::DoubleBuffered;
+    Isa isa = bestIsa();
+    MathMode math = MathMode::Exact;
+    BoidLayout layout = BoidLayout::Float;
+    SpawnShape spawn = SpawnShape::Uniform;
+    unsigned int stagger = 1;
+    unsigned int cap = 0; // Neighbours per boid, 0 is uncapped.
+    NeighbourCapMode capMode = NeighbourCapMode::First;
+    unsigned int threads = 1;
+    unsigned int reorder = 64;
+    float skin = 12.f;
+    std::optional<FlockParams> params; // Defaults, or those of the snapshot, if unset.
+    unsigned int flocks = 1;           // The boids are split evenly between this many flocks.
+    bool interact = false;             // Every flock sees every other instead of only itself.
+    std::string load;                  // Snapshot to start from instead of random flocks.
+    std::string save;                  // Snapshot written after the timed ticks.
+    std::string record;                // Trajectory recording of the timed ticks.
+    const char *density = "custom";    // Regime of a --suite run, see DENSITIES.
+};
+
+/**
+ * What main() runs.
+ */
+enum class BenchMode
+{
+    Single, // The configuration as given.
+    Matrix, // Every kernel, see kernelRuns().
+    Suite,  // Every kernel at each of DENSITIES.
+    Verify, // Every kernel against the reference, see verifyKernels().
+};
+
+/**
+ * Boid density of a --suite run, as a scale on the sides of the configured world.
+ */
+struct Density
+{
+    const char *name;
+    float scale;
+};
+
+// At the default 10000 boids in 1524x1024: about 3, 13 and 230 neighbours per boid.
+static constexpr Density DENSITIES[] = {{"sparse", 3.f}, {"uniform", 1.f}, {"collapsed", 0.2f}};
+
+/**
+ * Measurements of one benchmark run.
+ */
+struct BenchResult
+{
+    double nsPerTick = 0.0;
+    double nsPerBoid = 0.0;
+    double candidatePairsPerTick = 0.0;
+    double neighbourPairsPerTick = 0.0;
+    double allocationsPerTick = 0.0;
+    double listRebuildsPerTick = 0.0;
+    double farTermsPerTick = 0.0;
+    double cappedBoidsPerTick = 0.0;
+    uint64_t recordedFrames = 0;
+    uint64_t droppedFrames = 0;
+    double bytesPerFrame = 0.0;
+    double spawnNsPerBoid = 0.0; // Filling the flocks, 0 when loaded from a snapshot.
+    const char *kernel = "";
+    size_t bytesPerBoid = 0; // Read by the neighbour kernel per candidate.
+    unsigned int threads = 1;
+    unsigned int flocks = 1;
+    size_t boids = 0;
+    bool preset = true;
+};
+
+static const char *searchName(NeighbourSearch search)
+{
+    switch (search)
+    {
+    case NeighbourSearch::Grid:
+        return "grid";
+    case NeighbourSearch::Verlet:
+        return "verlet";
+    default:
+        return "brute";
+    }
+}
+
+static const char *schemeName(UpdateScheme scheme)
+{
+    return scheme == UpdateScheme::DoubleBuffered ? "jacobi" : "inplace";
+}
+
+static const char *spawnName(SpawnShape shape)
+{
+    switch (shape)
+    {
+    case SpawnShape::Clusters:
+        return "clusters";
+    case SpawnShape::Ring:
+        return "ring";
+    default:
+        return "uniform";
+    }
+}
+
+/**
+ * @brief	Fills the flocks the same way FlockingApp::createRandomFlocks() does. Destinations are
+ *          spread along the horizontal centre line, so a single flock heads for the centre.
+ * @param	world	    Flocks to fill.
+ * @param	config	    Boid count, seed, world size and placement.
+ * @param	pool	    Threads to spawn with. May be null.
+ */
+static void createRandomFlocks(World &world, const BenchConfig &config, ThreadPool *pool)
+{
+    const size_t flocks = world.flockCount();
+    SpawnDistribution distribution;
+    distribution.shape = config.spawn;
+    distribution.max = {static_cast<float>(config.width), static_cast<float>(config.height)};
+    for (size_t f = 0; f < flocks; f++)
+    {
+        distribution.seed = noiseKey(config.seed, static_cast<uint32_t>(f));
+        world.flock(f).spawn(config.boids / flocks + (f < config.boids % flocks), distribution,
+                             pool);
+        const float x = config.width * (f + 1.f) / (flocks + 1.f);
+        world.flock(f).setDest({x, config.height / 2.f});
+    }
+}
+
+/**
+ * @brief	Fills an empty world with the random flocks of config, or with its snapshot.
+ * @param	world	    World to fill.
+ * @param	config	    Boid count, seed, world size and placement, or the snapshot to load.
+ * @param	pool	    Threads to spawn with. May be null.
+ */
+static void populateWorld(World &world, const BenchConfig &config, ThreadPool *pool)
+{
+    std::string error;
+    if (!config.load.empty())
+    {
+        if (!loadSnapshot(config.load, world, error))
+        {
+            // main() loaded it once already, so this is a file changed in between.
+            std::fprintf(stderr, "%s\n", error.c_str());
+            std::exit(1);
+        }
+        return;
+    }
+
+    world.setSeed(config.seed);
+    const size_t maxFlocks = std::min<size_t>(World::MAX_FLOCKS, std::max(config.boids, 1u));
+    const size_t flocks = std::clamp<size_t>(config.flocks, 1, maxFlocks);
+    for (size_t f = 0; f < flocks; f++)
+    {
+        world.addFlock();
+    }
+    createRandomFlocks(world, config, pool);
+}
+
+/**
+ * @brief	Sets the search, kernel and rule constants of config on every flock of world.
+ */
+static void applySettings(World &world, const BenchConfig &config)
+{
+    for (size_t f = 0; f < world.flockCount(); f++)
+    {
+        Flock &flock = world.flock(f);
+        flock.setNeighbourSearch(config.search);
+        flock.setUpdateScheme(config.scheme);
+        flock.setIsa(config.isa);
+        flock.setMathMode(config.math);
+        flock.setLayout(config.layout);
+        flock.setReorderInterval(config.reorder);
+        flock.setVerletSkin(config.skin);
+        flock.setStagger(config.stagger);
+        flock.setNeighbourCap(config.cap, config.capMode);
+        if (config.params)
+        {
+            flock.setParams(*config.params);
+        }
+        for (size_t other = 0; other < world.flockCount() && config.interact; other++)
+        {
+            world.setInteraction(f, other, true);
+        }
+    }
+}
+
+/**
+ * @brief	Runs one configuration.
+ * @param	config	    Configuration to run.
+ */
+static BenchResult runBench(const BenchConfig &config)
+{
+    std::unique_ptr<ThreadPool> pool;
+    if (config.threads != 1)
+    {
+        pool = std::make_unique<ThreadPool>(config.threads);
+    }
+
+    BenchResult result;
+    World world;
+    std::string error;
+    const auto spawnStart = std::chrono::steady_clock::now();
+    populateWorld(world, config, pool.get());
+    const auto spawnStop = std::chrono::steady_clock::now();
+    if (config.load.empty())
+    {
+        result.spawnNsPerBoid =
+            std::chrono::duration<double, std::nano>(spawnStop - spawnStart).count() /
+            std::max<size_t>(world.size(), 1);
+    }
+
+    applySettings(world, config);
+
+    for (unsigned int t = 0; t < config.warmup; t++)
+    {
+        world.update(pool.get());
+    }
+
+    uint64_t candidates = 0;
+    uint64_t neighbours = 0;
+    uint64_t rebuilds = 0;
+    uint64_t farTerms = 0;
+    uint64_t capped = 0;
+
+    TrajectoryRecorder recorder;
+    if (!config.record.empty())
+    {
+        const TrajectoryFormat format{{0.f, 0.f},
+                                      {static_cast<float>(config.width),
+                                       static_cast<float>(config.height)},
+                                      world.flock(0).params().maxSpeed,
+                                      TrajectoryFormat{}.keyframeInterval};
+        if (!recorder.open(config.record, format, TrajectoryRecorder::MAX_SLOTS, error))
+        {
+            std::fprintf(stderr, "%s\n", error.c_str());
+            std::exit(1);
+        }
+    }
+
+    const uint64_t allocationsBefore = gAllocations.load();
+    const auto start = std::chrono::steady_clock::now();
+    for (unsigned int t = 0; t < config.ticks; t++)
+    {
+        world.update(pool.get());
+        const FlockStats stats = world.stats();
+        candidates += stats.candidatePairs;
+        neighbours += stats.neighbourPairs;
+        rebuilds += stats.listRebuilds;
+        farTerms += stats.farTerms;
+        capped += stats.cappedBoids;
+        if (recorder.isOpen())
+        {
+            recorder.record(world, t);
+        }
+    }
+    const auto stop = std::chrono::steady_clock::now();
+    const uint64_t allocations = gAllocations.load() - allocationsBefore;
+
+    // Closing waits for the writer, outside the timed ticks.
+    if (recorder.isOpen() && !recorder.close())
+    {
+        std::fprintf(stderr, "writing %s failed\n", config.record.c_str());
+    }
+    result.recordedFrames = recorder.recorded();
+    result.droppedFrames = recorder.dropped();
+    result.bytesPerFrame = recorder.recorded() ? static_cast<double>(recorder.bytesWritten()) /
+                                                     recorder.recorded()
+                                               : 0.0;
+
+    const double ticks = std::max(config.ticks, 1u);
+    result.nsPerTick = std::chrono::duration<double, std::nano>(stop - start).count() / ticks;
+    result.nsPerBoid = result.nsPerTick / std::max<size_t>(world.size(), 1);
+    result.candidatePairsPerTick = candidates / ticks;
+    result.neighbourPairsPerTick = neighbours / ticks;
+    result.allocationsPerTick = allocations / ticks;
+    result.listRebuildsPerTick = rebuilds / ticks;
+    result.farTermsPerTick = farTerms / ticks;
+    result.cappedBoidsPerTick = capped / ticks;
+    result.kernel = world.flock(0).kernelName();
+    result.bytesPerBoid = world.flock(0).kernelBytesPerBoid();
+    result.flocks = static_cast<unsigned int>(world.flockCount());
+    result.boids = world.size();
+    result.preset = world.flock(0).params() == DEFAULT_PARAMS;
+
+    if (!config.save.empty() && !saveSnapshot(world, config.save, error))
+    {
+        std::fprintf(stderr, "%s\n", error.c_str());
+    }
+    result.threads = pool ? pool->size() : 1;
+    return result;
+}
+
+static void printResult(const BenchConfig &config, const BenchResult &result)
+{
+    std::printf("{\"search\": \"%s\", \"scheme\": \"%s\", \"kernel\": \"%s\", \"math\": \"%s\", "
+                "\"layout\": \"%s\", \"bytes_per_boid\": %zu, \"stagger\": %u, "
+                "\"neighbour_cap\": %u, \"cap_mode\": \"%s\", "
+                "\"threads\": %u, \"reorder\": %u, \"preset\": %s, \"flocks\": %u, "
+                "\"interact\": %s, \"snapshot\": %s, \"boids\": %zu, \"ticks\": %u, "
+                "\"seed\": %u, \"spawn\": \"%s\", \"density\": \"%s\", "
+                "\"spawn_ns_per_boid\": %.2f, "
+                "\"ns_per_tick\": %.1f, \"ns_per_boid\": %.3f, "
+                "\"candidate_pairs_per_tick\": %.1f, \"neighbour_pairs_per_tick\": %.1f, "
+                "\"allocs_per_tick\": %.2f, \"list_rebuilds_per_tick\": %.3f, "
+                "\"far_terms_per_tick\": %.1f, \"capped_boids_per_tick\": %.1f, "
+                "\"recorded_frames\": %llu, "
+                "\"dropped_frames\": %llu, \"bytes_per_frame\": %.1f}",
+                searchName(config.search), schemeName(config.scheme), result.kernel,
+                config.math == MathMode::Fast ? "fast" : "exact",
+                config.layout == BoidLayout::Compact ? "compact" : "float", result.bytesPerBoid,
+                config.stagger, config.cap,
+                config.capMode == NeighbourCapMode::Stratified ? "stratified" : "first",
+                result.threads, config.reorder,
+                result.preset ? "true" : "false", result.flocks, config.interact ? "true" : "false",
+                config.load.empty() ? "false" : "true", result.boids, config.ticks, config.seed,
+                spawnName(config.spawn), config.density, result.spawnNsPerBoid,
+                result.nsPerTick, result.nsPerBoid,
+                result.candidatePairsPerTick, result.neighbourPairsPerTick,
+                result.allocationsPerTick, result.listRebuildsPerTick, result.farTermsPerTick,
+                result.cappedBoidsPerTick,
+                static_cast<unsigned long long>(result.recordedFrames),
+                static_cast<unsigned long long>(result.droppedFrames), result.bytesPerFrame);
+}
+
+/**
+ * @brief	Every search, layout, kernel, math mode and thread count combination of config. The
+ *          threads are 1 plus either config.threads or one per core.
+ */
+static std::vector<BenchConfig> kernelRuns(const BenchConfig &config)
+{
+    std::vector<unsigned int> threadCounts{1};
+    const unsigned int wide =
+        config.threads > 1 ? config.threads : std::max(1u, std::thread::hardware_concurrency());
+    if (wide > 1)
+    {
+        threadCounts.push_back(wide);
+    }
+
+    std::vector<Isa> isas{Isa::Scalar};
+    if (bestIsa() != Isa::Scalar)
+    {
+        isas.push_back(bestIsa());
+    }
+
+    std::vector<BenchConfig> runs;
+    for (NeighbourSearch search :
+         {NeighbourSearch::BruteForce, NeighbourSearch::Grid, NeighbourSearch::Verlet})
+    {
+        for (BoidLayout layout : {BoidLayout::Float, BoidLayout::Compact})
+        {
+            // Only the grid search reads the compact layout.
+            if (layout == BoidLayout::Compact && search != NeighbourSearch::Grid)
+            {
+                continue;
+            }
+            for (Isa isa : isas)
+            {
+                for (MathMode math : {MathMode::Exact, MathMode::Fast})
+                {
+                    for (unsigned int threads : threadCounts)
+                    {
+                        BenchConfig run = config;
+                        run.search = search;
+                        run.layout = layout;
+                        run.isa = isa;
+                        run.math = math;
+                        run.threads = threads;
+                        runs.push_back(run);
+                    }
+                }
+            }
+        }
+    }
+    return runs;
+}
+
+/**
+ * @brief	Replaces the flocks of to with copies of those of from: boids, destinations, rules,
+ *          noise streams and interactions. Search and kernel settings stay at their defaults.
+ */
+static void copyWorld(const World &from, World &to)
+{
+    to.clear();
+    to.setSeed(from.seed());
+    for (size_t f = 0; f < from.flockCount(); f++)
+    {
+        const Flock &source = from.flock(f);
+        Flock &flock = *to.addFlock();
+        flock.setState(source.state());
+        flock.setDest(source.dest());
+        flock.setParams(source.params());
+        flock.setSeed(source.seed(), source.tick());
+    }
+    for (size_t f = 0; f < from.flockCount(); f++)
+    {
+        for (size_t other = 0; other < from.flockCount(); other++)
+        {
+            to.setInteraction(f, other, from.interacts(f, other));
+        }
+    }
+}
+
+/**
+ * How far the velocities after one tick of a kernel may be from the reference, as fractions of
+ * maxSpeed.
+ */
+struct Tolerance
+{
+    float max;  // Of any boid.
+    float mean; // Over all boids.
+};
+
+/**
+ * @brief	Tolerance of a kernel. Exact kernels only sum in a different order. Fast math trades a
+ *          few bits of each square root and division, which add up over a dense neighbourhood.
+ *          The compact layout rounds positions to 16-bit cell offsets, which can move a boid at
+ *          the edge of the range in or out of it. A neighbour that is lost altogether shows in
+ *          the mean long before it reaches these maxima.
+ */
+static Tolerance verifyTolerance(const BenchConfig &config)
+{
+    if (config.layout == BoidLayout::Compact)
+    {
+        return {0.1f, 1e-3f};
+    }
+    return config.math == MathMode::Fast ? Tolerance{0.05f, 2e-4f} : Tolerance{1e-3f, 1e-5f};
+}
+
+/**
+ * @brief	Runs the warmup ticks of config once, then one tick of every kernelRuns() combination
+ *          and of the scalar brute-force reference from the same state, and compares the new
+ *          velocities boid by boid. Prints a JSON array with the errors of each combination.
+ *          Stagger and neighbour caps are turned off and the scheme is Jacobi, since those
+ *          change the result on purpose.
+ * @return	true if every combination is within its verifyTolerance().
+ */
+static bool verifyKernels(const BenchConfig &config)
+{
+    BenchConfig base = config;
+    base.scheme = UpdateScheme::DoubleBuffered;
+    base.stagger = 1;
+    base.cap = 0;
+
+    // Warm up so the boids move and have neighbours to agree on.
+    World start;
+    populateWorld(start, base, nullptr);
+    applySettings(start, base);
+    for (unsigned int t = 0; t < base.warmup; t++)
+    {
+        start.update();
+    }
+
+    BenchConfig reference = base;
+    reference.search = NeighbourSearch::BruteForce;
+    reference.layout = BoidLayout::Float;
+    reference.isa = Isa::Scalar;
+    reference.math = MathMode::Exact;
+    World expected;
+    copyWorld(start, expected);
+    applySettings(expected, reference);
+    expected.update();
+
+    bool passed = true;
+    const std::vector<BenchConfig> runs = kernelRuns(base);
+    std::printf("[\n");
+    for (size_t i = 0; i < runs.size(); i++)
+    {
+        const BenchConfig &run = runs[i];
+        std::unique_ptr<ThreadPool> pool;
+        if (run.threads != 1)
+        {
+            pool = std::make_unique<ThreadPool>(run.threads);
+        }
+        World world;
+        copyWorld(start, world);
+        applySettings(world, run);
+        world.update(pool.get());
+
+        double maxError = 0.0;
+        double sumError = 0.0;
+        for (size_t f = 0; f < world.flockCount(); f++)
+        {
+            const FlockState &want = expected.flock(f).state();
+            const FlockState &got = world.flock(f).state();
+            const double scale = 1.0 / std::max(expected.flock(f).params().maxSpeed, 1e-6f);
+            for (uint32_t id = 0; id < want.size(); id++)
+            {
+                const uint32_t a = expected.flock(f).slotOf(id);
+                const uint32_t b = world.flock(f).slotOf(id);
+                const double error = scale * std::hypot(got.velX[b] - want.velX[a],
+                                                        got.velY[b] - want.velY[a]);
+                maxError = std::max(maxError, error);
+                sumError += error;
+            }
+        }
+        const double meanError = sumError / std::max<size_t>(world.size(), 1);
+        const Tolerance tolerance = verifyTolerance(run);
+        const bool pass = maxError <= tolerance.max && meanError <= tolerance.mean;
+        passed = passed && pass;
+
+        std::printf("  {\"search\": \"%s\", \"kernel\": \"%s\", \"math\": \"%s\", "
+                    "\"layout\": \"%s\", \"threads\": %u, \"flocks\": %zu, \"boids\": %zu, "
+                    "\"seed\": %u, \"max_error\": %.3g, \"mean_error\": %.3g, "
+                    "\"max_tolerance\": %.3g, \"mean_tolerance\": %.3g, \"pass\": %s}%s\n",
+                    searchName(run.search), world.flock(0).kernelName(),
+                    run.math == MathMode::Fast ? "fast" : "exact",
+                    run.layout == BoidLayout::Compact ? "compact" : "float",
+                    pool ? pool->size() : 1u, world.flockCount(), world.size(), run.seed,
+                    maxError, meanError, tolerance.max, tolerance.mean, pass ? "true" : "false",
+                    i + 1 < runs.size() ? "," : "");
+    }
+    std::printf("]\n");
+    return passed;
+}
+
+static void printUsage()
+{
+    std::fprintf(stderr,
+                 "usage: flock_bench [--boids N] [--ticks N] [--warmup N] [--seed N]\n"
+                 "                   [--width N] [--height N] [--search grid|verlet|brute]\n"
+                 "                   [--scheme jacobi|inplace] [--isa auto|scalar|avx2|neon]\n"
+                 "                   [--math exact|fast] [--layout float|compact]\n"
+                 "                   [--spawn uniform|clusters|ring] [--stagger N] [--cap N]\n"
+                 "                   [--cap-mode first|stratified]\n"
+                 "                   [--threads N] [--reorder N]\n"
+                 "                   [--skin PX] [--params FILE] [--flocks N] [--interact]\n"
+                 "                   [--load FILE] [--save FILE] [--trace FILE] [--record FILE]\n"
+                 "                   [--matrix | --suite | --verify]\n"
+                 "\n"
+                 "--threads 0 uses one thread per core. --reorder sorts the boids by grid cell\n"
+                 "every N ticks, 0 never. --skin is how far past the visual range Verlet lists\n"
+                 "reach. --layout compact has the grid search read neighbours from 16-bit\n"
+                 "cell offsets, half velocities and a radius palette; bytes_per_boid is what\n"
+                 "the kernel reads per candidate. --params reads the rule constants from a\n"
+                 "key = value file, see loadParams(); far_centering_factor and\n"
+                 "far_matching_factor turn on the Barnes-Hut far field, with far_theta = 0 as\n"
+                 "its exact reference.\n"
+                 "--spawn places the random boids evenly, in normal clusters or on a ring;\n"
+                 "spawn_ns_per_boid is the time filling the flocks took. --stagger updates\n"
+                 "one boid in N per tick, the others coast. --cap stops gathering\n"
+                 "neighbours about N in, 0 never; --cap-mode stratified instead evaluates\n"
+                 "an even sample of the candidates sized to find about N neighbours.\n"
+                 "capped_boids_per_tick counts the boids the cap cut short.\n"
+                 "--flocks splits the boids between N flocks with their own destinations,\n"
+                 "--interact lets them see each other. --load starts from a\n"
+                 "snapshot instead, keeping its flocks, rule constants unless --params is\n"
+                 "given, and noise; --save writes one after the run (after each run with\n"
+                 "--matrix). --trace writes every profiled phase of the runs as Chrome\n"
+                 "trace-event JSON. --record streams the timed ticks to a trajectory file,\n"
+                 "dropping frames the writer falls behind on. --matrix runs every search,\n"
+                 "layout, kernel, math mode and thread count combination and prints a JSON\n"
+                 "array. --suite runs the matrix in a sparse, uniform and collapsed world, 3,\n"
+                 "1 and 0.2 times the size. --verify warms up, then compares one tick of every\n"
+                 "combination with the scalar brute-force reference boid by boid and exits\n"
+                 "with 1 if any is out of tolerance. The GPU backend needs a GL context and\n"
+                 "is checked by the app instead, with flock --verify-gpu. ctest runs both,\n"
+                 "and skips the GPU check where no GL 4.3 context can be created.\n");
+}
+
+/**
+ * @brief	Parses the command line into config.
+ * @return	false on an unknown or malformed argument.
+ */
+static bool parseArgs(int argc, char **argv, BenchConfig &config, BenchMode &mode,
+                      std::string &trace)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string_view arg = argv[i];
+        if (arg == "--matrix" || arg == "--suite" || arg == "--verify")
+        {
+            mode = arg == "--matrix"  ? BenchMode::Matrix
+                   : arg == "--suite" ? BenchMode::Suite
+                                      : BenchMode::Verify;
+            continue;
+        }
+        if (arg == "--interact")
+        {
+            config.interact = true;
+            continue;
+        }
+
+        if (i + 1 >= argc)
+        {
+            return false;
+        }
+        const std::string_view value = argv[++i];
+        auto number = [&]
+        { return static_cast<unsigned int>(std::strtoul(value.data(), nullptr, 10)); };
+
+        if (arg == "--boids")
+        {
+            config.boids = number();
+        }
+        else if (arg == "--ticks")
+        {
+            config.ticks = number();
+        }
+        else if (arg == "--warmup")
+        {
+            config.warmup = number();
+        }
+        else if (arg == "--seed")
+        {
+            config.seed = number();
+        }
+        else if (arg == "--width")
+        {
+            config.width = std::max(number(), 1u);
+        }
+        else if (arg == "--height")
+        {
+            config.height = std::max(number(), 1u);
+        }
+        else if (arg == "--threads")
+        {
+            config.threads = number();
+        }
+        else if (arg == "--skin")
+        {
+            config.skin = std::strtof(value.data(), nullptr);
+        }
+        else if (arg == "--flocks")
+        {
+            config.flocks = number();
+        }
+        else if (arg == "--stagger")
+        {
+            config.stagger = std::max(number(), 1u);
+        }
+        else if (arg == "--cap")
+        {
+            config.cap = number();
+        }
+        else if (arg == "--reorder")
+        {
+            config.reorder = number();
+        }
+        else if (arg == "--trace")
+        {
+            trace = value;
+        }
+        else if (arg == "--params")
+        {
+            std::string error;
+            FlockParams params;
+            if (!loadParams(std::string(value), params, error))
+            {
+                std::fprintf(stderr, "%s\n", error.c_str());
+                return false;
+            }
+            config.params = params;
+        }
+        else if (arg == "--load")
+        {
+            config.load = value;
+        }
+        else if (arg == "--save")
+        {
+            config.save = value;
+        }
+        else if (arg == "--record")
+        {
+            config.record = value;
+        }
+        else if (arg == "--search" && value == "grid")
+        {
+            config.search = NeighbourSearch::Grid;
+        }
+        else if (arg == "--search" && value == "verlet")
+        {
+            config.search = NeighbourSearch::Verlet;
+        }
+        else if (arg == "--search" && value == "brute")
+        {
+            config.search = NeighbourSearch::BruteForce;
+        }
+        else if (arg == "--scheme" && (value == "jacobi" || value == "inplace"))
+        {
+            config.scheme =
+                value == "jacobi" ? UpdateScheme::DoubleBuffered : UpdateScheme::InPlace;
+        }
+        else if (arg == "--isa" && value == "auto")
+        {
+            config.isa = bestIsa();
+        }
+        else if (arg == "--isa" && value == "scalar")
+        {
+            config.isa = Isa::Scalar;
+        }
+        else if (arg == "--isa" && value == "avx2")
+        {
+            config.isa = Isa::Avx2;
+        }
+        else if (arg == "--isa" && value == "neon")
+        {
+            config.isa = Isa::Neon;
+        }
+        else if (arg == "--math" && (value == "exact" || value == "fast"))
+        {
+            config.math = value == "fast" ? MathMode::Fast : MathMode::Exact;
+        }
+        else if (arg == "--layout" && (value == "float" || value == "compact"))
+        {
+            config.layout = value == "compact" ? BoidLayout::Compact : BoidLayout::Float;
+        }
+        else if (arg == "--cap-mode" && (value == "first" || value == "stratified"))
+        {
+            config.capMode =
+                value == "stratified" ? NeighbourCapMode::Stratified : NeighbourCapMode::First;
+        }
+        else if (arg == "--spawn" && value == "uniform")
+        {
+            config.spawn = SpawnShape::Uniform;
+        }
+        else if (arg == "--spawn" && value == "clusters")
+        {
+            config.spawn = SpawnShape::Clusters;
+        }
+        else if (arg == "--spawn" && value == "ring")
+        {
+            config.spawn = SpawnShape::Ring;
+        }
+        else
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    BenchConfig config;
+    BenchMode mode = BenchMode::Single;
+    std::string trace;
+    if (!parseArgs(argc, argv, config, mode, trace))
+    {
+        printUsage();
+        return 1;
+    }
+
+    // Fail before any run rather than in the middle of a matrix.
+    if (!config.load.empty())
+    {
+        World world;
+        std::string error;
+        if (!loadSnapshot(config.load, world, error))
+        {
+            std::fprintf(stderr, "%s\n", error.c_str());
+            return 1;
+        }
+    }
+
+    if (!trace.empty())
+    {
+#ifndef FLOCK_ENABLE_PROFILING
+        std::fprintf(stderr, "built without FLOCK_ENABLE_PROFILING, the trace will be empty\n");
+#endif
+        Profiler::get().startTrace();
+    }
+    auto finishTrace = [&]
+    {
+        if (!trace.empty() && !Profiler::get().stopTrace(trace))
+        {
+            std::fprintf(stderr, "could not write %s\n", trace.c_str());
+            return 1;
+        }
+        return 0;
+    };
+
+    if (mode == BenchMode::Single)
+    {
+        printResult(config, runBench(config));
+        std::printf("\n");
+        return finishTrace();
+    }
+
+    if (mode == BenchMode::Verify)
+    {
+        const bool passed = verifyKernels(config);
+        return finishTrace() || !passed;
+    }
+
+    std::vector<BenchConfig> runs;
+    if (mode == BenchMode::Matrix)
+    {
+        runs = kernelRuns(config);
+    }
+    else
+    {
+        for (const Density &density : DENSITIES)
+        {
+            BenchConfig scaled = config;
+            scaled.width = std::max(1u, static_cast<unsigned int>(config.width * density.scale));
+            scaled.height = std::max(1u, static_cast<unsigned int>(config.height * density.scale));
+            scaled.density = density.name;
+            const std::vector<BenchConfig> kernels = kernelRuns(scaled);
+            runs.insert(runs.end(), kernels.begin(), kernels.end());
+        }
+    }
+
+    std::printf("[\n");
+    for (size_t i = 0; i < runs.size(); i++)
+    {
+        std::printf("  ");
+        printResult(runs[i], runBench(runs[i]));
+        std::printf(i + 1 < runs.size() ? ",\n" : "\n");
+    }
+    std::printf("]\n");
+    return finishTrace();
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <vector>
+
+inline constexpr size_t CACHE_LINE = 64;
+
+/**
+ * Allocator returning storage aligned to Align bytes, so that arrays split into cache-line sized
+ * chunks do not share lines between threads.
+ */
+template <typename T, size_t Align = CACHE_LINE> struct AlignedAllocator
+{
+    using value_type = T;
+
+    template <typename U> struct rebind
+    {
+        using other = AlignedAllocator<U, Align>;
+    };
+
+    AlignedAllocator() = default;
+    template <typename U> AlignedAllocator(const AlignedAllocator<U, Align> &) {}
+
+    T *allocate(size_t n)
+    {
+        return static_cast<T *>(::operator new(n * sizeof(T), std::align_val_t{Align}));
+    }
+
+    void deallocate(T *p, size_t) { ::operator delete(p, std::align_val_t{Align}); }
+
+    template <typename U> bool operator==(const AlignedAllocator<U, Align> &) const { return true; }
+};
+
+using FloatArray = std::vector<float, AlignedAllocator<float>>;
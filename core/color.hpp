@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstdint>
+
+/**
+ * 8-bit RGBA color of a boid. Same layout as sf::Color.
+ */
+struct Color
+{
+    uint8_t r = 0;
+    uint8_t g = 0;
+    uint8_t b = 0;
+    uint8_t a = 255;
+
+    constexpr Color() = default;
+    constexpr Color(uint8_t r, uint8_t g, uint8_t b, uint8_t a = 255) : r(r), g(g), b(b), a(a) {}
+};
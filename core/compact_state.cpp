@@ -0,0 +1,128 @@
+#include "core/compact_state.hpp"
+#include "core/half.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+/**
+ * @brief	Rounds an offset in units of the scale to 16 bits.
+ */
+static uint32_t quantizeOffset(float units)
+{
+    const float t = units + 0.5f;
+    return t > 0.f ? static_cast<uint32_t>(std::min(t, 65535.f)) : 0;
+}
+
+void CompactState::pack(const FlockState &state, const SpatialGrid &grid)
+{
+    const size_t n = state.size();
+    if (!mPaletteValid || mRadiusBase.size() != n)
+    {
+        buildPalette(state.radius);
+    }
+
+    mScale = grid.cellSize() / 65535.f;
+    const float units = 65535.f / grid.cellSize();
+    mPos.resize(n);
+    mVel.resize(n);
+    mRadius.resize(n + PADDING);
+
+    // Walking the cells hands over the corner each boid was binned under, the same one the
+    // kernels are given, without redoing the binning per boid.
+    constexpr float INF = std::numeric_limits<float>::infinity();
+    grid.forEachCellIn({-INF, -INF}, {INF, INF},
+                       [&](const uint32_t *indices, size_t count, Vec2 cellMin)
+                       {
+                           for (size_t k = 0; k < count; k++)
+                           {
+                               const uint32_t i = indices[k];
+                               const Vec2 pos{state.posX[i], state.posY[i]};
+                               const bool finite = std::isfinite(pos.x) && std::isfinite(pos.y);
+                               const Vec2 offset = finite ? (pos - cellMin) * units : Vec2{};
+                               mPos[i] = quantizeOffset(offset.x) | quantizeOffset(offset.y) << 16;
+                               mRadius[i] = finite ? mRadiusBase[i] : SKIP;
+                           }
+                       });
+    for (size_t i = 0; i < n; i++)
+    {
+        mVel[i] = floatToHalf(state.velX[i]) | uint32_t{floatToHalf(state.velY[i])} << 16;
+    }
+}
+
+void CompactState::permute(const uint32_t *order)
+{
+    if (!mPaletteValid)
+    {
+        return;
+    }
+    mScratch.resize(mRadiusBase.size());
+    for (size_t k = 0; k < mRadiusBase.size(); k++)
+    {
+        mScratch[k] = mRadiusBase[order[k]];
+    }
+    mRadiusBase.swap(mScratch);
+}
+
+void CompactState::buildPalette(const FloatArray &radius)
+{
+    // Kept sorted while collecting. Past SKIP values the flock is binned anyway, so only the
+    // extremes matter from then on.
+    mDistinct.clear();
+    float lo = std::numeric_limits<float>::infinity();
+    float hi = -lo;
+    for (const float r : radius)
+    {
+        if (!std::isfinite(r))
+        {
+            continue;
+        }
+        lo = std::min(lo, r);
+        hi = std::max(hi, r);
+        if (mDistinct.size() <= SKIP)
+        {
+            const auto at = std::lower_bound(mDistinct.begin(), mDistinct.end(), r);
+            if (at == mDistinct.end() || *at != r)
+            {
+                mDistinct.insert(at, r);
+            }
+        }
+    }
+
+    mPalette.fill(0.f);
+    mPalette[SKIP] = std::numeric_limits<float>::quiet_NaN();
+    mRadiusBase.resize(radius.size());
+    mSmallPalette = mDistinct.size() < 8;
+    if (mSmallPalette)
+    {
+        mPalette[7] = mPalette[SKIP];
+    }
+    if (mDistinct.size() <= SKIP)
+    {
+        std::copy(mDistinct.begin(), mDistinct.end(), mPalette.begin());
+        for (size_t i = 0; i < radius.size(); i++)
+        {
+            const auto at = std::lower_bound(mDistinct.begin(), mDistinct.end(), radius[i]);
+            mRadiusBase[i] = std::isfinite(radius[i])
+                                 ? static_cast<uint8_t>(at - mDistinct.begin())
+                                 : SKIP;
+        }
+    }
+    else
+    {
+        // Too many radii to list, so bin them evenly. At least two distinct values exist here.
+        const float step = (hi - lo) / (SKIP - 1);
+        for (size_t k = 0; k < SKIP; k++)
+        {
+            mPalette[k] = lo + static_cast<float>(k) * step;
+        }
+        for (size_t i = 0; i < radius.size(); i++)
+        {
+            const float k = std::round((radius[i] - lo) / step);
+            mRadiusBase[i] = std::isfinite(radius[i])
+                                 ? static_cast<uint8_t>(std::clamp(k, 0.f, SKIP - 1.f))
+                                 : SKIP;
+        }
+    }
+    mPaletteValid = true;
+}
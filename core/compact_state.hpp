@@ -0,0 +1,79 @@
+#pragma once
+
+#include "core/flock_state.hpp"
+#include "core/neighbour_kernel.hpp"
+#include "core/spatial_grid.hpp"
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Copy of what the neighbour kernel reads of each boid in 9 bytes instead of the 20 of the float
+ * arrays, for flocks large enough that streaming candidates through the cache bounds the tick.
+ *
+ * - Position: 16-bit fixed point offsets into the boid's grid cell, packed into one word, good to
+ *   cellSize / 131070, well under a thousandth of a pixel at the default range.
+ * - Velocity: two halves packed into one word, good to 2^-11 of the speed.
+ * - Radius: a byte indexing a palette of up to 255 distinct radii. A flock with more is binned
+ *   into 255 even steps between its smallest and largest radius.
+ *
+ * Packed from a FlockState and the grid just built over it, once per tick; the update still
+ * reads and writes the boid itself at full precision. Color is not needed by the kernel and is
+ * not copied.
+ */
+class CompactState
+{
+public:
+    // Bytes the kernel reads per candidate, against 5 floats for KernelInput.
+    static constexpr size_t BYTES_PER_BOID = 2 * sizeof(uint32_t) + sizeof(uint8_t);
+
+    // Radius index of boids at a non-finite position or of non-finite radius, never neighbours.
+    static constexpr uint8_t SKIP = 255;
+
+    /**
+     * @brief	Packs every boid. Storage is reused between calls.
+     * @param	state	    Boids to pack.
+     * @param	grid	    Grid built over state, whose cells the positions are relative to.
+     */
+    void pack(const FlockState &state, const SpatialGrid &grid);
+
+    /**
+     * @brief	Call when radii changed since the last pack(), to rebuild the palette.
+     */
+    void invalidate() { mPaletteValid = false; }
+
+    /**
+     * @brief	Call after the flock was permuted, to keep the palette indices with their boids
+     *          instead of rebuilding them.
+     * @param	order	    Permutation the flock was reordered by, see FlockState::permute().
+     */
+    void permute(const uint32_t *order);
+
+    /**
+     * @brief	View of the packed arrays for the kernels.
+     * @param	visualRange	Visual range of the flock.
+     */
+    CompactInput input(float visualRange) const
+    {
+        return {mPos.data(), mVel.data(), mRadius.data(), mPalette.data(), mSmallPalette, mScale,
+                visualRange};
+    }
+
+private:
+    // Bytes past the last radius index a kernel may read.
+    static constexpr size_t PADDING = 8;
+
+    std::vector<uint32_t> mPos;
+    std::vector<uint32_t> mVel;
+    std::vector<uint8_t> mRadius;     // mRadiusBase, or SKIP where the position is not finite.
+    std::vector<uint8_t> mRadiusBase; // Palette index of each slot's radius.
+    std::array<float, 256> mPalette{};
+    std::vector<uint8_t> mScratch; // Old mRadiusBase during permute().
+    std::vector<float> mDistinct;  // Scratch of buildPalette().
+    float mScale = 1.f;
+    bool mSmallPalette = false;
+    bool mPaletteValid = false;
+
+    void buildPalette(const FloatArray &radius);
+};
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+
+/**
+ * Counter-based random numbers: each value is a hash of where it is used instead of the next
+ * state of a generator, so it doesn't matter which thread or SIMD lane computes it or in what
+ * order. All arithmetic is 32-bit, the same as the GLSL copy in gpu_flock.cpp.
+ */
+
+/**
+ * @brief	Integer hash with full avalanche (lowbias32 by Chris Wellons).
+ * @param	x	        Counter.
+ */
+inline constexpr uint32_t counterHash(uint32_t x)
+{
+    x ^= x >> 16;
+    x *= 0x7feb352du;
+    x ^= x >> 15;
+    x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x;
+}
+
+/**
+ * @brief	Key of one tick of a stream. Boid id k of the tick draws from key + 2k and key + 2k + 1.
+ * @param	seed	    Stream seed.
+ * @param	tick	    Tick number, wrapping after 2^32 ticks.
+ */
+inline constexpr uint32_t noiseKey(uint32_t seed, uint32_t tick)
+{
+    return counterHash(seed ^ counterHash(tick));
+}
+
+/**
+ * @brief	Uniform value in [-1, 1) with 24 random bits.
+ * @param	key	        Counter, e.g. from noiseKey().
+ */
+inline constexpr float noiseValue(uint32_t key)
+{
+    return static_cast<float>(counterHash(key) >> 8) * (2.f / 16777216.f) - 1.f;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <bit>
+#include <cstdint>
+
+/**
+ * Approximations used by MathMode::Fast. Bounds are relative errors, measured over the whole
+ * input range each function is used on. The SIMD kernels apply the same polynomial and Newton
+ * step to their hardware estimates.
+ *
+ * - fastRsqrt: below 5e-6 for normal positive x (bit-trick seed, two Newton steps).
+ * - fastExp2: below 8e-5 for |x| <= 126 (3rd degree minimax polynomial on [-0.5, 0.5]).
+ * - Separation push of one pair: below 2e-4 of its length. The exp2 error adds to the rsqrt
+ *   error of the distance, scaled by ln 2 times the distance. The heading and speed clamp of a
+ *   boid inherit the fastRsqrt bound.
+ *
+ * A pair whose distance is within a rounding error of the visual range may be classified
+ * differently from the exact mode, since fast mode compares squared distances.
+ */
+
+// 2^f on [-0.5, 0.5], fitted for minimal relative error.
+inline constexpr float FAST_EXP2_C0 = 9.999281338e-01f;
+inline constexpr float FAST_EXP2_C1 = 6.932610861e-01f;
+inline constexpr float FAST_EXP2_C2 = 2.426103020e-01f;
+inline constexpr float FAST_EXP2_C3 = 5.517044336e-02f;
+
+/**
+ * @brief	Approximate 1 / sqrt(x). Infinite for 0, like the exact expression.
+ * @param	x	        Positive input.
+ */
+inline float fastRsqrt(float x)
+{
+    const float half = 0.5f * x;
+    float y = std::bit_cast<float>(0x5f375a86u - (std::bit_cast<uint32_t>(x) >> 1));
+    y *= 1.5f - half * y * y;
+    y *= 1.5f - half * y * y;
+    return x == 0.f ? 1.f / x : y;
+}
+
+/**
+ * @brief	Approximate 2^x. Inputs are clamped to [-126, 126] so the result stays normal.
+ * @param	x	        Exponent.
+ */
+inline float fastExp2(float x)
+{
+    x = x < -126.f ? -126.f : (x > 126.f ? 126.f : x);
+    const int whole = static_cast<int>(x + (x < 0.f ? -0.5f : 0.5f));
+    const float f = x - static_cast<float>(whole);
+    const float p = ((FAST_EXP2_C3 * f + FAST_EXP2_C2) * f + FAST_EXP2_C1) * f + FAST_EXP2_C0;
+    return p * std::bit_cast<float>(static_cast<uint32_t>(whole + 127) << 23);
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+
+/**
+ * Accumulator that turns elapsed wall time into a whole number of fixed-length simulation ticks.
+ * The remainder is kept as an interpolation factor for rendering between the last two ticks.
+ */
+class FixedTimestep
+{
+public:
+    /**
+     * @brief	Construct a new Fixed Timestep object.
+     * @param	tickRate	        Simulation ticks per second.
+     * @param	maxTicksPerFrame	Most ticks advance() asks for at once.
+     */
+    explicit FixedTimestep(double tickRate = 60.0, unsigned int maxTicksPerFrame = 8)
+        : mMaxTicks(maxTicksPerFrame)
+    {
+        setTickRate(tickRate);
+    }
+
+    /**
+     * @brief	Adds elapsed wall time and returns the number of ticks now due. A slow frame is
+     *          made up with several ticks; beyond maxTicksPerFrame the backlog is dropped and
+     *          counted, so a simulation that can't keep up slows down instead of snowballing.
+     * @param	seconds	    Wall time since the previous call.
+     */
+    unsigned int advance(double seconds)
+    {
+        mAccumulator += std::max(seconds, 0.0);
+        auto ticks = static_cast<uint64_t>(mAccumulator / mTickSeconds);
+        if (ticks > mMaxTicks)
+        {
+            mDroppedTicks += ticks - mMaxTicks;
+            ticks = mMaxTicks;
+            mAccumulator = 0.0;
+        }
+        else
+        {
+            mAccumulator -= static_cast<double>(ticks) * mTickSeconds;
+        }
+        return static_cast<unsigned int>(ticks);
+    }
+
+    /**
+     * @brief	Fraction of a tick elapsed since the last tick, in [0, 1].
+     */
+    float alpha() const { return static_cast<float>(std::min(mAccumulator / mTickSeconds, 1.0)); }
+
+    /**
+     * @brief	Forgets any accumulated time.
+     */
+    void reset() { mAccumulator = 0.0; }
+
+    void setTickRate(double tickRate) { mTickSeconds = 1.0 / std::max(tickRate, 1e-3); }
+    double tickSeconds() const { return mTickSeconds; }
+    uint64_t droppedTicks() const { return mDroppedTicks; }
+
+private:
+    double mTickSeconds = 1.0 / 60.0;
+    double mAccumulator = 0.0;
+    unsigned int mMaxTicks;
+    uint64_t mDroppedTicks = 0;
+};
@@ -0,0 +1,686 @@
+#include "core/flock.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <utility>
+
+// Shortest slice of candidates a capped search hands to the kernel, so it keeps its vector width.
+static constexpr size_t CAP_SLICE = 8;
+
+// Candidates a stratified search collects before handing them to the kernel.
+static constexpr size_t SAMPLE_BATCH = 64;
+
+/**
+ * Run of candidates handed out by a search: indices[0, count), or base + [0, count) when indices
+ * is null.
+ */
+struct CandidateRun
+{
+    const uint32_t *indices;
+    uint32_t base;
+    size_t count;
+    Vec2 cellMin; // Of the cell the run is in, for the compact kernels.
+
+    uint32_t operator[](size_t k) const
+    {
+        return indices ? indices[k] : base + static_cast<uint32_t>(k);
+    }
+};
+
+/**
+ * @brief	Gathers the neighbourhood of boid i from the runs a search hands out, within the cap.
+ *
+ *          Capped to the first neighbours found, runs go to the kernel in slices short enough
+ *          that the neighbourhood stops growing about cap boids in. The kernels find at most one
+ *          neighbour per candidate, so each slice is what is left of the cap, or CAP_SLICE.
+ *
+ *          Stratified, a boid whose candidates would hold more than cap neighbours at the hit
+ *          rate evaluates every stride-th of them across all runs, with the stride rounded up so
+ *          about cap neighbours are found. Slots follow the cells and, after a reorder, positions
+ *          within them, so the sample spreads over the whole neighbourhood instead of filling up
+ *          from the first cell. Averages of the sample estimate those of the neighbourhood as
+ *          they are; the separation is a sum and is scaled up by the candidates per sample.
+ * @param	mode	    How to cap.
+ * @param	cap	        Neighbours per boid. 0 is uncapped.
+ * @param	hitRate	    Expected neighbours per candidate, in (0, 1].
+ * @param	i	        Boid being gathered, which also staggers the sample between boids.
+ * @param	nb	        Neighbourhood to accumulate into.
+ * @param	stats	    Counts the boid in cappedBoids if the cap cut its candidates.
+ * @param	forEachRun	Calls its argument with every CandidateRun of the boid.
+ * @param	slice	    Kernel call for (run, at, len): candidates [at, at + len) of run.
+ * @param	picked	    Kernel call for (run, indices, count): a sample of run's candidates.
+ */
+template <typename ForEachRun, typename Slice, typename Picked>
+static void gatherNeighbours(NeighbourCapMode mode, unsigned int cap, float hitRate, uint32_t i,
+                             Neighbourhood &nb, FlockStats &stats, const ForEachRun &forEachRun,
+                             const Slice &slice, const Picked &picked)
+{
+    if (cap == 0)
+    {
+        forEachRun([&](const CandidateRun &run) { slice(run, size_t{0}, run.count); });
+        return;
+    }
+
+    if (mode == NeighbourCapMode::Stratified)
+    {
+        size_t total = 0;
+        forEachRun([&](const CandidateRun &run) { total += run.count; });
+        const auto budget = std::max(static_cast<size_t>(cap / hitRate), size_t{cap});
+        if (total <= budget)
+        {
+            forEachRun([&](const CandidateRun &run) { slice(run, size_t{0}, run.count); });
+            return;
+        }
+
+        const size_t stride = (total + budget - 1) / budget;
+        size_t skip = i % stride; // Candidates to pass over before the next pick.
+        size_t taken = 0;
+        forEachRun(
+            [&](const CandidateRun &run)
+            {
+                uint32_t batch[SAMPLE_BATCH];
+                size_t count = 0;
+                size_t k = skip;
+                for (; k < run.count; k += stride)
+                {
+                    batch[count++] = run[k];
+                    if (count == SAMPLE_BATCH)
+                    {
+                        picked(run, batch, count);
+                        taken += count;
+                        count = 0;
+                    }
+                }
+                if (count > 0)
+                {
+                    picked(run, batch, count);
+                    taken += count;
+                }
+                skip = k - run.count;
+            });
+
+        // At least one pick, since the stride is at most the total.
+        const float weight = static_cast<float>(total) / static_cast<float>(taken);
+        nb.sepX *= weight;
+        nb.sepY *= weight;
+        stats.cappedBoids++;
+        return;
+    }
+
+    const auto limit = static_cast<int>(cap);
+    forEachRun(
+        [&](const CandidateRun &run)
+        {
+            for (size_t at = 0; at < run.count && nb.count < limit;)
+            {
+                const size_t len =
+                    std::min(run.count - at, std::max<size_t>(limit - nb.count, CAP_SLICE));
+                slice(run, at, len);
+                at += len;
+            }
+        });
+    stats.cappedBoids += nb.count >= limit;
+}
+
+void Flock::update(ThreadPool *pool)
+{
+    FLOCK_PROFILE_SCOPE(Phase::Update);
+
+    const size_t n = mState.size();
+    mScratch.reset();
+    mNoiseKey = noiseKey(mSeed, static_cast<uint32_t>(mTick++));
+    mStaggerPhase = static_cast<uint32_t>(mTick % mStagger);
+
+    // Two boids interact while their centres are closer than the visual range plus both radii.
+    // In place, boids earlier in the loop have already moved by up to the speed limit since they
+    // were binned, so that is added as well. The cell size is recomputed every build, so the
+    // grid follows setParams() without further bookkeeping.
+    const float margin = mScheme == UpdateScheme::InPlace ? mParams.maxSpeed : 0.f;
+    bool rebuilt = false;
+    mTicksSinceReorder++;
+
+    if (mSearch == NeighbourSearch::Grid)
+    {
+        FLOCK_PROFILE_SCOPE(Phase::Search);
+        mGrid.build(mState, mParams.visualRange + 2.f * mMaxRadius + margin, mScratch);
+        reorderIfDue();
+        if (usesCompact())
+        {
+            mCompact.pack(mState, mGrid);
+        }
+    }
+    else if (mSearch == NeighbourSearch::Verlet &&
+             mVerlet.needsRebuild(mState, 0.5f * mVerletSkin))
+    {
+        // Two boids that each moved at most skin / 2 closed in by at most the skin, so every
+        // pair that interacts now was listed. Slots may only change on a rebuild.
+        FLOCK_PROFILE_SCOPE(Phase::Search);
+        const float range = mParams.visualRange + margin + mVerletSkin;
+        mGrid.build(mState, range + 2.f * mMaxRadius, mScratch);
+        reorderIfDue();
+        mVerlet.build(mState, mGrid, range, pool, chunkSize(n, pool ? pool->size() : 1));
+        rebuilt = true;
+    }
+    buildFarField();
+
+    // In place, the kernel reads the arrays the loop is writing, so it can't be split.
+    const bool buffered = mScheme == UpdateScheme::DoubleBuffered;
+    const KernelInput kin{mState.posX.data(), mState.posY.data(),   mState.velX.data(),
+                          mState.velY.data(), mState.radius.data(), mParams.visualRange};
+    const CompactInput cin = mCompact.input(mParams.visualRange);
+    const bool compact = usesCompact();
+    mPacked = compact;
+    const NeighbourKernel &kernel = *mKernel;
+
+    // Slots within a cell are ascending, so a run is consecutive exactly when its ends are
+    // count - 1 apart. After a reorder most cells are, and the range kernel reads them with plain
+    // loads instead of gathers. Slices of a run keep that property.
+    auto slice = [&](uint32_t i, const CandidateRun &run, size_t at, size_t len,
+                     Neighbourhood &nb, FlockStats &stats)
+    {
+        const uint32_t first = run[at];
+        const auto last = static_cast<uint32_t>(first + len);
+        if (!run.indices || run.indices[at + len - 1] == last - 1)
+        {
+            kernel.range(kin, i, first, last, nb);
+        }
+        else
+        {
+            kernel.indexed(kin, i, run.indices + at, len, nb);
+        }
+        stats.candidatePairs += len;
+    };
+    auto compactSlice = [&](const CompactQuery &q, const CandidateRun &run, size_t at,
+                            size_t len, Neighbourhood &nb, FlockStats &stats)
+    {
+        const uint32_t first = run[at];
+        const auto last = static_cast<uint32_t>(first + len);
+        if (run.indices[at + len - 1] == last - 1)
+        {
+            kernel.compactRange(cin, q, first, last, nb);
+        }
+        else
+        {
+            kernel.compactIndexed(cin, q, run.indices + at, len, nb);
+        }
+        stats.candidatePairs += len;
+    };
+
+    integrate(buffered ? pool : nullptr, buffered,
+              [&](uint32_t i, Vec2 pos, Neighbourhood &nb, FlockStats &stats)
+              {
+                  auto gather = [&](const auto &forEachRun)
+                  {
+                      gatherNeighbours(
+                          mCapMode, mNeighbourCap, mHitRate, i, nb, stats, forEachRun,
+                          [&](const CandidateRun &run, size_t at, size_t len)
+                          { slice(i, run, at, len, nb, stats); },
+                          [&](const CandidateRun &, const uint32_t *indices, size_t count)
+                          {
+                              kernel.indexed(kin, i, indices, count, nb);
+                              stats.candidatePairs += count;
+                          });
+                  };
+
+                  if (compact)
+                  {
+                      // The same runs as the grid search, with the cell corner the offsets are
+                      // relative to.
+                      CompactQuery q{i, pos, mState.radius[i], {}};
+                      gatherNeighbours(
+                          mCapMode, mNeighbourCap, mHitRate, i, nb, stats,
+                          [&](const auto &fn)
+                          {
+                              mGrid.forEachCandidateCell(
+                                  pos,
+                                  [&](const uint32_t *indices, size_t count, Vec2 cellMin)
+                                  {
+                                      q.cellMin = cellMin;
+                                      fn(CandidateRun{indices, 0, count, cellMin});
+                                  });
+                          },
+                          [&](const CandidateRun &run, size_t at, size_t len)
+                          { compactSlice(q, run, at, len, nb, stats); },
+                          [&](const CandidateRun &, const uint32_t *indices, size_t count)
+                          {
+                              kernel.compactIndexed(cin, q, indices, count, nb);
+                              stats.candidatePairs += count;
+                          });
+                  }
+                  else if (mSearch == NeighbourSearch::Grid)
+                  {
+                      gather(
+                          [&](const auto &fn)
+                          {
+                              mGrid.forEachCandidateCell(
+                                  pos, [&](const uint32_t *indices, size_t count)
+                                  { fn(CandidateRun{indices, 0, count, {}}); });
+                          });
+                  }
+                  else if (mSearch == NeighbourSearch::Verlet)
+                  {
+                      // Lists skip the boids out of range, so they are rarely consecutive.
+                      const CandidateRun list{mVerlet.neighbours(i), 0, mVerlet.count(i), {}};
+                      auto indexed = [&](const uint32_t *indices, size_t count)
+                      {
+                          kernel.indexed(kin, i, indices, count, nb);
+                          stats.candidatePairs += count;
+                      };
+                      gatherNeighbours(
+                          mCapMode, mNeighbourCap, mHitRate, i, nb, stats,
+                          [&](const auto &fn) { fn(list); },
+                          [&](const CandidateRun &, size_t at, size_t len)
+                          { indexed(list.indices + at, len); },
+                          [&](const CandidateRun &, const uint32_t *indices, size_t count)
+                          { indexed(indices, count); });
+                  }
+                  else
+                  {
+                      gather([&](const auto &fn) { fn(CandidateRun{nullptr, 0, n, {}}); });
+                  }
+              });
+    mStats.listRebuilds = rebuilt;
+    updateHitRate();
+}
+
+void Flock::update(ThreadPool *pool, const SharedNeighbours &shared)
+{
+    FLOCK_PROFILE_SCOPE(Phase::Update);
+
+    mScratch.reset();
+    mNoiseKey = noiseKey(mSeed, static_cast<uint32_t>(mTick++));
+    mStaggerPhase = static_cast<uint32_t>(mTick % mStagger);
+    mPacked = false;
+    buildFarField();
+
+    // Neighbours come from the shared copy taken before any member moved, so writing straight
+    // into mState is a Jacobi update and can be split between threads.
+    const KernelInput kin{shared.state->posX.data(), shared.state->posY.data(),
+                          shared.state->velX.data(), shared.state->velY.data(),
+                          shared.state->radius.data(), mParams.visualRange};
+    const NeighbourKernel &kernel = *mKernel;
+    const uint32_t first = shared.start[shared.self];
+    const uint64_t all = shared.members >= 64 ? ~uint64_t{0} : (uint64_t{1} << shared.members) - 1;
+    const bool seesAll = (shared.sees & all) == all;
+    const uint32_t *start = shared.start;
+    const uint32_t *lastStart = start + shared.members;
+    auto slice = [&](uint32_t i, const CandidateRun &run, size_t at, size_t len,
+                     Neighbourhood &nb, FlockStats &stats)
+    {
+        const uint32_t head = run[at];
+        if (run.indices[at + len - 1] - head == len - 1)
+        {
+            kernel.range(kin, first + i, head, head + static_cast<uint32_t>(len), nb);
+        }
+        else
+        {
+            kernel.indexed(kin, first + i, run.indices + at, len, nb);
+        }
+        stats.candidatePairs += len;
+    };
+
+    integrate(pool, false,
+              [&](uint32_t i, Vec2 pos, Neighbourhood &nb, FlockStats &stats)
+              {
+                  auto forEachRun = [&](const auto &fn)
+                  {
+                      shared.grid->forEachCandidateCell(
+                          pos,
+                          [&](const uint32_t *indices, size_t count)
+                          {
+                              if (seesAll)
+                              {
+                                  fn(CandidateRun{indices, 0, count, {}});
+                                  return;
+                              }
+
+                              // Slots within a cell ascend and the members are stored one after
+                              // another, so each member's boids in the cell form one run.
+                              const uint32_t *end = indices + count;
+                              for (const uint32_t *run = indices; run != end;)
+                              {
+                                  const size_t m =
+                                      std::upper_bound(start, lastStart, *run) - start - 1;
+                                  const uint32_t *runEnd =
+                                      std::lower_bound(run, end, start[m + 1]);
+                                  if (shared.sees >> m & 1)
+                                  {
+                                      fn(CandidateRun{run, 0, size_t(runEnd - run), {}});
+                                  }
+                                  run = runEnd;
+                              }
+                          });
+                  };
+                  gatherNeighbours(
+                      mCapMode, mNeighbourCap, mHitRate, first + i, nb, stats, forEachRun,
+                      [&](const CandidateRun &run, size_t at, size_t len)
+                      { slice(i, run, at, len, nb, stats); },
+                      [&](const CandidateRun &, const uint32_t *indices, size_t count)
+                      {
+                          kernel.indexed(kin, first + i, indices, count, nb);
+                          stats.candidatePairs += count;
+                      });
+              });
+
+    // The shared copy is in slot order, so keeping each flock sorted by cell keeps its runs in
+    // the shared grid consecutive too. Only on the interval: the disorder needs a grid of its own.
+    if (mReorderInterval != 0 && ++mTicksSinceReorder >= mReorderInterval)
+    {
+        FLOCK_PROFILE_SCOPE(Phase::Search);
+        mGrid.build(mState, mParams.visualRange + 2.f * mMaxRadius, mScratch);
+        reorderIfDue();
+    }
+    mStats.listRebuilds = 0;
+    updateHitRate();
+}
+
+template <typename Search>
+void Flock::integrate(ThreadPool *pool, bool buffered, const Search &search)
+{
+    FLOCK_PROFILE_SCOPE(Phase::Integrate);
+
+    const size_t n = mState.size();
+    const bool preset = mParams == DEFAULT_PARAMS;
+    const bool fast = mMath == MathMode::Fast;
+    auto run = [&](size_t begin, size_t end, FlockState &out)
+    {
+        if (fast)
+        {
+            return preset ? updateRange<true, true>(begin, end, mState, out, search)
+                          : updateRange<false, true>(begin, end, mState, out, search);
+        }
+        return preset ? updateRange<true, false>(begin, end, mState, out, search)
+                      : updateRange<false, false>(begin, end, mState, out, search);
+    };
+
+    FlockState &out = buffered ? mBack : mState;
+    if (buffered)
+    {
+        mBack.resizeKinematics(n);
+    }
+
+    if (pool)
+    {
+        std::atomic<uint64_t> candidates{0};
+        std::atomic<uint64_t> neighbours{0};
+        std::atomic<uint64_t> farTerms{0};
+        std::atomic<uint64_t> capped{0};
+        pool->parallelFor(n, chunkSize(n, pool->size()),
+                          [&](size_t begin, size_t end)
+                          {
+                              const FlockStats s = run(begin, end, out);
+                              candidates.fetch_add(s.candidatePairs, std::memory_order_relaxed);
+                              neighbours.fetch_add(s.neighbourPairs, std::memory_order_relaxed);
+                              farTerms.fetch_add(s.farTerms, std::memory_order_relaxed);
+                              capped.fetch_add(s.cappedBoids, std::memory_order_relaxed);
+                          });
+        mStats = {candidates.load(), neighbours.load(), 0, farTerms.load(), capped.load()};
+    }
+    else
+    {
+        mStats = run(0, n, out);
+    }
+
+    if (buffered)
+    {
+        mState.swapKinematics(mBack);
+    }
+}
+
+void Flock::setParams(const FlockParams &params)
+{
+    if (params.visualRange != mParams.visualRange || params.maxSpeed != mParams.maxSpeed)
+    {
+        mVerlet.invalidate();
+    }
+    mParams = params;
+}
+
+void Flock::addBoid(float x, float y, float radius, Color color)
+{
+    mSlotOf.push_back(static_cast<uint32_t>(mState.size()));
+    mState.add(x, y, radius, color);
+    mMaxRadius = std::max(mMaxRadius, radius);
+    mVerlet.invalidate();
+    mCompact.invalidate();
+}
+
+void Flock::spawn(size_t count, const SpawnDistribution &distribution, ThreadPool *pool)
+{
+    const size_t first = mState.size();
+    const size_t n = first + count;
+    mState.resize(n);
+    mSlotOf.resize(n);
+
+    // Boid k of the spawn is drawn from counter k, so the split doesn't show in the result.
+    const Spawner spawner(distribution);
+    auto fill = [&](size_t begin, size_t end)
+    {
+        spawner.fill(mState, first + begin, first + end, static_cast<uint32_t>(begin));
+        for (size_t k = first + begin; k < first + end; k++)
+        {
+            mState.id[k] = static_cast<uint32_t>(k);
+            mSlotOf[k] = static_cast<uint32_t>(k);
+        }
+    };
+    if (pool)
+    {
+        pool->parallelFor(count, chunkSize(count, pool->size()), fill);
+    }
+    else
+    {
+        fill(0, count);
+    }
+
+    for (size_t k = first; k < n; k++)
+    {
+        mMaxRadius = std::max(mMaxRadius, mState.radius[k]);
+    }
+    mVerlet.invalidate();
+    mCompact.invalidate();
+}
+
+void Flock::setState(FlockState state)
+{
+    mState = std::move(state);
+    mSlotOf.resize(mState.size());
+    for (uint32_t k = 0; k < mState.size(); k++)
+    {
+        mSlotOf[mState.id[k]] = k;
+    }
+    mMaxRadius = 0.f;
+    for (const float radius : mState.radius)
+    {
+        mMaxRadius = std::max(mMaxRadius, radius);
+    }
+    mTicksSinceReorder = 0;
+    mVerlet.invalidate();
+    mCompact.invalidate();
+}
+
+void Flock::migrate(const std::vector<uint8_t> &leaving, const FlockState &arriving)
+{
+    auto compact = [&](auto &array, const auto &extra)
+    {
+        size_t kept = 0;
+        for (size_t k = 0; k < array.size(); k++)
+        {
+            if (!leaving[k])
+            {
+                array[kept++] = array[k];
+            }
+        }
+        array.resize(kept);
+        array.insert(array.end(), extra.begin(), extra.end());
+    };
+    compact(mState.posX, arriving.posX);
+    compact(mState.posY, arriving.posY);
+    compact(mState.velX, arriving.velX);
+    compact(mState.velY, arriving.velY);
+    compact(mState.radius, arriving.radius);
+    compact(mState.color, arriving.color);
+
+    const uint32_t n = static_cast<uint32_t>(mState.size());
+    mState.id.resize(n);
+    mSlotOf.resize(n);
+    for (uint32_t k = 0; k < n; k++)
+    {
+        mState.id[k] = k;
+        mSlotOf[k] = k;
+    }
+    mMaxRadius = 0.f;
+    for (const float radius : mState.radius)
+    {
+        mMaxRadius = std::max(mMaxRadius, radius);
+    }
+    mVerlet.invalidate();
+    mCompact.invalidate();
+}
+
+void Flock::clear()
+{
+    mState.clear();
+    mSlotOf.clear();
+    mMaxRadius = 0.f;
+    mVerlet.invalidate();
+    mCompact.invalidate();
+}
+
+void Flock::updateHitRate()
+{
+    // A sample is even, so its rate stands for the whole neighbourhood while the cap is on too.
+    if (mStats.candidatePairs > 0)
+    {
+        const auto rate = static_cast<float>(mStats.neighbourPairs) / mStats.candidatePairs;
+        mHitRate = std::clamp(rate, MIN_HIT_RATE, 1.f);
+    }
+}
+
+void Flock::buildFarField()
+{
+    if (hasFarField(mParams))
+    {
+        // Built from the state before the tick, whatever the update scheme: the far field
+        // changes slowly and one tree per tick keeps it O(N log N).
+        FLOCK_PROFILE_SCOPE(Phase::Search);
+        mTree.build(mState);
+    }
+}
+
+void Flock::reorderIfDue()
+{
+    if (mReorderInterval == 0 ||
+        (mTicksSinceReorder < mReorderInterval && mGrid.disorder() <= REORDER_DISORDER))
+    {
+        return;
+    }
+
+    // mBack is rewritten by the next update, so it doubles as the permutation scratch.
+    mState.permute(mGrid.order(), mBack);
+    mCompact.permute(mGrid.order());
+    mGrid.markReordered();
+    for (uint32_t k = 0; k < mState.size(); k++)
+    {
+        mSlotOf[mState.id[k]] = k;
+    }
+    mTicksSinceReorder = 0;
+    mVerlet.invalidate();
+}
+
+size_t Flock::chunkSize(size_t n, unsigned int threads)
+{
+    constexpr size_t LINE = CACHE_LINE / sizeof(float);
+    constexpr size_t MIN_CHUNK = 4 * LINE;
+    const size_t chunk = std::max(n / (4 * threads), MIN_CHUNK);
+    return (chunk + LINE - 1) / LINE * LINE;
+}
+
+template <bool Preset, bool Fast, typename Search>
+FlockStats Flock::updateRange(size_t begin, size_t end, const FlockState &in, FlockState &out,
+                              const Search &search)
+{
+    // A local copy either way: the preset folds into immediates, the runtime values stay in
+    // registers instead of being reloaded after every store through out.
+    const FlockParams p = Preset ? DEFAULT_PARAMS : mParams;
+    const uint32_t stagger = mStagger;
+    const uint32_t phase = mStaggerPhase;
+    FlockStats stats;
+
+    for (uint32_t i = begin; i < end; i++)
+    {
+        const Vec2 pos{in.posX[i], in.posY[i]};
+        Vec2 vel{in.velX[i], in.velY[i]};
+
+        // Boids not due this tick keep their velocity
+        if (stagger > 1 && (in.id[i] + phase) % stagger != 0)
+        {
+            out.velX[i] = vel.x;
+            out.velY[i] = vel.y;
+            out.posX[i] = pos.x + vel.x;
+            out.posY[i] = pos.y + vel.y;
+            continue;
+        }
+
+        // Iterate over other boids
+        Neighbourhood nb;
+        search(i, pos, nb, stats);
+        stats.neighbourPairs += nb.count;
+
+        Vec2 separation{nb.sepX, nb.sepY};
+        Vec2 avg_vel{nb.velX, nb.velY};
+        Vec2 avg_pos{nb.posX, nb.posY};
+        const int neighbourhood_size = nb.count;
+
+        if (neighbourhood_size > 0)
+        {
+            avg_vel /= static_cast<float>(neighbourhood_size);
+            avg_pos /= static_cast<float>(neighbourhood_size);
+        }
+
+        Vec2 toTarget = mDest - pos;
+        Vec2 toDest = Fast ? toTarget * (fastRsqrt(toTarget.lengthSquared()) * p.maxSpeed)
+                           : toTarget.normalized() * p.maxSpeed;
+
+        vel += separation * p.avoidFactor;                  // Separation
+        vel += p.matchingFactor * (avg_vel - vel);          // Alignment
+        vel += p.centeringFactor * (avg_pos - pos);         // Cohesion
+
+        // Pull towards and align with distant boids, through the quadtree
+        if (hasFarField(p))
+        {
+            const FarField far = mTree.farField(pos, p.farTheta, p.visualRange);
+            stats.farTerms += far.terms;
+            vel += p.farCenteringFactor * far.pull;
+            if (far.weight > 0.f)
+            {
+                vel += p.farMatchingFactor * (far.velocity / far.weight - vel);
+            }
+        }
+        vel = (1.f - p.biasVal) * vel + p.biasVal * toDest; // Destination
+
+        // Add random movements, keyed on the boid rather than its slot or thread
+        const uint32_t key = mNoiseKey + 2 * in.id[i];
+        vel += Vec2{noiseValue(key), noiseValue(key + 1)} * p.noiseStrength;
+
+        // Enforce speed limit
+        const float speed2 = vel.lengthSquared();
+        const float speed = Fast ? speed2 * fastRsqrt(speed2) : std::sqrt(speed2);
+        if (speed > p.maxSpeed)
+        {
+            vel *= (p.maxSpeed / (speed + 1e-2f));
+        }
+        else if (speed < p.minSpeed)
+        {
+            vel *= (p.minSpeed / (speed + 1e-2f));
+        }
+
+        // Update position
+        out.velX[i] = vel.x;
+        out.velY[i] = vel.y;
+        out.posX[i] = pos.x + vel.x;
+        out.posY[i] = pos.y + vel.y;
+    }
+
+    return stats;
+}
@@ -0,0 +1,406 @@
+/**
+ * Sources:
+ * - https://vanhunteradams.com/Pico/Animal_Movement/Boids-algorithm.html
+ */
+
+#pragma once
+
+#include "core/aligned_allocator.hpp"
+#include "core/color.hpp"
+#include "core/compact_state.hpp"
+#include "core/counter_rng.hpp"
+#include "core/fast_math.hpp"
+#include "core/flock_params.hpp"
+#include "core/flock_state.hpp"
+#include "core/neighbour_kernel.hpp"
+#include "core/profiler.hpp"
+#include "core/quadtree.hpp"
+#include "core/scratch_arena.hpp"
+#include "core/spatial_grid.hpp"
+#include "core/spawn.hpp"
+#include "core/thread_pool.hpp"
+#include "core/vec2.hpp"
+#include "core/verlet_list.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Strategy used to find the neighbours of each boid.
+ */
+enum class NeighbourSearch
+{
+    BruteForce, // Test every pair of boids. Reference implementation.
+    Grid,       // Only test boids in adjacent cells of a uniform grid.
+    Verlet,     // Grid-built per-boid lists with a skin, reused until a boid moves skin / 2.
+};
+
+/**
+ * How an update publishes new velocities and positions.
+ */
+enum class UpdateScheme
+{
+    InPlace,        // Boids later in the loop see neighbours already updated this tick.
+    DoubleBuffered, // Read the previous tick, write the next one, then swap (Jacobi).
+};
+
+/**
+ * Representation the neighbour kernel reads boids from.
+ */
+enum class BoidLayout
+{
+    Float,   // The float arrays of FlockState. Reference.
+    Compact, // A CompactState packed every tick. Only used with the grid search.
+};
+
+/**
+ * Which neighbours a capped search keeps, see Flock::setNeighbourCap().
+ */
+enum class NeighbourCapMode
+{
+    First,      // The first neighbours found, in the order the search visits cells.
+    Stratified, // An even sample of all candidates, with the separation scaled up to match.
+};
+
+/**
+ * Work counters of the last update.
+ */
+struct FlockStats
+{
+    uint64_t candidatePairs = 0; // Pairs handed to the neighbour kernel.
+    uint64_t neighbourPairs = 0; // Pairs within the visual range.
+    uint64_t listRebuilds = 0;   // Verlet list rebuilds, 0 or 1 per update.
+    uint64_t farTerms = 0;       // Quadtree nodes and boids summed into the far field.
+    uint64_t cappedBoids = 0;    // Boids whose candidates the neighbour cap cut short.
+};
+
+/**
+ * Neighbourhood shared by flocks that see each other: their boids copied one flock after another
+ * into one state, binned into one grid. Built by World.
+ */
+struct SharedNeighbours
+{
+    const FlockState *state; // Positions, velocities and radii of every member, before the tick.
+    const SpatialGrid *grid; // Grid over state, with cells at least as large as any member needs.
+    const uint32_t *start;   // Slot in state of each member's first boid, plus the total.
+    size_t members;          // Number of flocks in state, at most 64.
+    uint32_t self;           // Member index of the flock being updated.
+    uint64_t sees;           // Bit m is set if the flock reacts to the boids of member m.
+};
+
+/**
+ * Flock contains a set of boids which move in unison towards a destination.
+ */
+class Flock
+{
+public:
+    // Grid disorder past which the flock is reordered before its interval is up.
+    static constexpr float REORDER_DISORDER = 0.5f;
+
+    // Lowest neighbours per candidate a stratified cap sizes its sample for.
+    static constexpr float MIN_HIT_RATE = 1.f / 16.f;
+
+    /**
+     * @brief	Updates velocities and positions of all boids in the flock.
+     * @param	pool	    Threads to split the boids between. Only used when double-buffered.
+     */
+    void update(ThreadPool *pool = nullptr);
+
+    /**
+     * @brief	Updates velocities and positions with neighbours taken from a shared index instead
+     *          of the flock's own search. Always a Jacobi update, whatever the update scheme,
+     *          since the shared state is a copy from before the tick. The flock is not reordered.
+     * @param	pool	    Threads to split the boids between. May be null.
+     * @param	shared	    Index over this flock and the flocks it may see.
+     */
+    void update(ThreadPool *pool, const SharedNeighbours &shared);
+
+    /**
+     * @brief	Add a boid to the flock.
+     * @param	x	        Initial X coordinate.
+     * @param	y	        Initial Y coordinate.
+     * @param	radius	    Radius.
+     * @param	color	    Color.
+     */
+    void addBoid(float x, float y, float radius, Color color);
+
+    /**
+     * @brief	Appends boids drawn from a distribution, at rest. The arrays grow once and are
+     *          filled in parallel; the boids are the same whatever the thread count.
+     * @param	count	    Number of boids to add.
+     * @param	distribution	Placement, radii and colors, see Spawner.
+     * @param	pool	    Threads to split the boids between. May be null.
+     */
+    void spawn(size_t count, const SpawnDistribution &distribution, ThreadPool *pool = nullptr);
+
+    /**
+     * @brief	Set the destination for all boids to move towards.
+     * @param	newDest	    New destination.
+     */
+    void setDest(Vec2 newDest) { mDest = newDest; }
+    Vec2 dest() const { return mDest; }
+
+    /**
+     * @brief	Replaces the rule constants. The grid follows the new visual range on the next
+     *          update and the Verlet lists are rebuilt if the range or speed limit changed.
+     *          DEFAULT_PARAMS runs a specialization with the constants folded in.
+     * @param	params	    New rule constants.
+     */
+    void setParams(const FlockParams &params);
+    const FlockParams &params() const { return mParams; }
+
+    /**
+     * @brief	Selects how neighbours are found during update().
+     * @param	search	    Neighbour search strategy.
+     */
+    void setNeighbourSearch(NeighbourSearch search)
+    {
+        mSearch = search;
+        mVerlet.invalidate();
+    }
+    NeighbourSearch neighbourSearch() const { return mSearch; }
+
+    /**
+     * @brief	Sets how far beyond the visual range the Verlet lists reach. A wider skin rebuilds
+     *          less often but hands the kernel more candidates.
+     * @param	skin	    Extra range in pixels.
+     */
+    void setVerletSkin(float skin)
+    {
+        mVerletSkin = skin;
+        mVerlet.invalidate();
+    }
+    float verletSkin() const { return mVerletSkin; }
+
+    /**
+     * @brief	Selects how update() publishes new velocities and positions.
+     * @param	scheme	    Update scheme.
+     */
+    void setUpdateScheme(UpdateScheme scheme)
+    {
+        mScheme = scheme;
+        mVerlet.invalidate();
+    }
+    UpdateScheme updateScheme() const { return mScheme; }
+
+    /**
+     * @brief	Selects the neighbour kernel. Unsupported instruction sets fall back to scalar.
+     * @param	isa	        Instruction set.
+     */
+    void setIsa(Isa isa)
+    {
+        mIsa = isa;
+        mKernel = &kernelFor(mIsa, mMath);
+    }
+    const char *kernelName() const { return mKernel->name; }
+
+    /**
+     * @brief	Selects exact or approximate arithmetic for the neighbour kernel and the per-boid
+     *          steering. See fast_math.hpp for the error bounds.
+     * @param	math	    Math mode.
+     */
+    void setMathMode(MathMode math)
+    {
+        mMath = math;
+        mKernel = &kernelFor(mIsa, mMath);
+    }
+    MathMode mathMode() const { return mMath; }
+
+    /**
+     * @brief	Selects the layout the neighbour kernel reads candidates from. The compact layout
+     *          trades precision for memory traffic, see CompactState, and only applies to the grid
+     *          search of update(pool); the other searches and the shared path read floats. In
+     *          place, neighbours are then read as of the start of the tick, like a Jacobi update.
+     * @param	layout	    Layout of the neighbour reads.
+     */
+    void setLayout(BoidLayout layout)
+    {
+        mLayout = layout;
+        mCompact.invalidate();
+    }
+    BoidLayout layout() const { return mLayout; }
+
+    /**
+     * @brief	Updates only every stagger-th boid per tick, in rotation by id; the others keep
+     *          their velocity and coast. Cuts the neighbour work by the factor at the cost of
+     *          boids reacting stagger ticks late.
+     * @param	stagger	    Ticks between two updates of the same boid. 1 updates every boid.
+     */
+    void setStagger(unsigned int stagger) { mStagger = std::max(stagger, 1u); }
+    unsigned int stagger() const { return mStagger; }
+
+    /**
+     * @brief	Bounds the neighbourhood gathered per boid, and with it the work, where the flock
+     *          collapses into a few cells and the search would otherwise approach every pair.
+     *          First stops about cap neighbours in, which is cheapest but sees only the cells
+     *          visited first. Stratified evaluates an even sample of the candidates across the
+     *          whole neighbourhood, sized to find about cap neighbours at the rate candidates
+     *          turned out to be neighbours in the last update. Its averages stay unbiased and
+     *          the separation sum is scaled up by the sampling rate. The work per boid is then
+     *          bounded by cap / MIN_HIT_RATE candidates. See FlockStats::cappedBoids for how
+     *          often the cap applies.
+     * @param	cap	        Neighbours per boid. 0 is uncapped.
+     * @param	mode	    Which neighbours to keep.
+     */
+    void setNeighbourCap(unsigned int cap, NeighbourCapMode mode = NeighbourCapMode::First)
+    {
+        mNeighbourCap = cap;
+        mCapMode = mode;
+    }
+    unsigned int neighbourCap() const { return mNeighbourCap; }
+    NeighbourCapMode neighbourCapMode() const { return mCapMode; }
+
+    /**
+     * @brief	Bytes the neighbour kernel read per candidate in the last update.
+     */
+    size_t kernelBytesPerBoid() const
+    {
+        return mPacked ? CompactState::BYTES_PER_BOID : 5 * sizeof(float);
+    }
+
+    /**
+     * @brief	Restarts the random steering from a seed. Update t draws the noise of boid id k from
+     *          (seed, t, k) alone, so runs with the same seed match whatever the thread count,
+     *          update scheme or reordering.
+     * @param	seed	    Seed of the noise stream.
+     * @param	tick	    Update to continue the stream from, e.g. tick() of a saved flock.
+     */
+    void setSeed(uint32_t seed, uint64_t tick = 0)
+    {
+        mSeed = seed;
+        mTick = tick;
+    }
+    uint32_t seed() const { return mSeed; }
+    uint64_t tick() const { return mTick; }
+
+    /**
+     * @brief	Sorts the boid arrays by grid cell every interval ticks, or sooner once the grid's
+     *          disorder passes REORDER_DISORDER, so neighbours sit next to each other in memory.
+     *          Slots change, ids do not. Only used with the grid and Verlet searches.
+     * @param	interval	Ticks between reorders. 0 never reorders.
+     */
+    void setReorderInterval(unsigned int interval) { mReorderInterval = interval; }
+    unsigned int reorderInterval() const { return mReorderInterval; }
+
+    /**
+     * @brief	Slot in state() of the boid with the given id.
+     * @param	id	        Id from FlockState::id, i.e. the order boids were added in.
+     */
+    uint32_t slotOf(uint32_t id) const { return mSlotOf[id]; }
+
+    const FlockState &state() const { return mState; }
+    const FlockStats &stats() const { return mStats; }
+    float maxRadius() const { return mMaxRadius; }
+
+    /**
+     * @brief	Replaces all boids, e.g. with a loaded snapshot.
+     * @param	state	    New boids. Every array has the same length and id is a permutation of
+     *                      [0, size()).
+     */
+    void setState(FlockState state);
+
+    /**
+     * @brief	Removes some boids and appends others, e.g. boids crossing into and out of a tile.
+     *          Those that stay keep their slot order, so a flock sorted by cell stays nearly
+     *          sorted. Ids are renumbered to the new slots.
+     * @param	leaving	    Nonzero for each slot to remove, size() entries.
+     * @param	arriving	Boids to append. Their ids are ignored.
+     */
+    void migrate(const std::vector<uint8_t> &leaving, const FlockState &arriving);
+
+    /**
+     * @brief	Removes all boids.
+     */
+    void clear();
+
+private:
+    /**
+     * @brief	Picks a chunk size giving each thread a few chunks to balance dense and sparse
+     *          regions. Chunks are whole cache lines of floats so threads never write to the same
+     *          line of an output array.
+     * @param	n	        Number of boids.
+     * @param	threads	    Number of threads.
+     */
+    static size_t chunkSize(size_t n, unsigned int threads);
+
+    /**
+     * @brief	Applies the flocking rules to every boid.
+     * @param	pool	    Threads to split the boids between. May be null.
+     * @param	buffered	Write to mBack and swap afterwards instead of writing to mState.
+     * @param	search	    Called as search(i, pos, nb, stats) to gather the neighbourhood of i.
+     */
+    template <typename Search>
+    void integrate(ThreadPool *pool, bool buffered, const Search &search);
+
+    /**
+     * @brief	Applies the flocking rules to boids [begin, end).
+     * @tparam	Preset	    Read the rule constants from DEFAULT_PARAMS at compile time instead
+     *                      of from mParams.
+     * @tparam	Fast	    Normalize and clamp the speed with fastRsqrt() instead of sqrt.
+     * @param	begin	    First boid to update.
+     * @param	end	        One past the last boid to update.
+     * @param	in	        State the neighbourhood is read from.
+     * @param	out	        State the new velocities and positions are written to. May be in.
+     * @param	search	    Gathers the neighbourhood of a boid, see integrate().
+     * @return	Work done on the range.
+     */
+    template <bool Preset, bool Fast, typename Search>
+    FlockStats updateRange(size_t begin, size_t end, const FlockState &in, FlockState &out,
+                           const Search &search);
+
+    /**
+     * @brief	Takes mHitRate from the counters of the update just done.
+     */
+    void updateHitRate();
+
+    /**
+     * @brief	Rebuilds mTree over the boids before the tick if the params enable the far field.
+     */
+    void buildFarField();
+
+    bool usesCompact() const
+    {
+        return mLayout == BoidLayout::Compact && mSearch == NeighbourSearch::Grid;
+    }
+
+    /**
+     * @brief	Permutes the flock into the cell order of the grid just built if the interval is
+     *          up or the grid is too disordered.
+     */
+    void reorderIfDue();
+
+    FlockState mState;
+    Vec2 mDest;
+    FlockParams mParams;
+    float mMaxRadius = 0.f;
+    FlockStats mStats;
+
+    NeighbourSearch mSearch = NeighbourSearch::Grid;
+    SpatialGrid mGrid;
+    unsigned int mReorderInterval = 64;
+    unsigned int mTicksSinceReorder = 0;
+    std::vector<uint32_t> mSlotOf;
+    VerletList mVerlet;
+    float mVerletSkin = 12.f;
+    QuadTree mTree; // Far field, built before the tick when enabled.
+
+    UpdateScheme mScheme = UpdateScheme::DoubleBuffered;
+    Isa mIsa = bestIsa();
+    MathMode mMath = MathMode::Exact;
+    const NeighbourKernel *mKernel = &kernelFor(mIsa, mMath);
+    BoidLayout mLayout = BoidLayout::Float;
+    unsigned int mStagger = 1;
+    uint32_t mStaggerPhase = 0; // Boids with (id + phase) % stagger == 0 update this tick.
+    unsigned int mNeighbourCap = 0;
+    NeighbourCapMode mCapMode = NeighbourCapMode::First;
+    float mHitRate = 0.25f; // Neighbours per candidate in the last update.
+    CompactState mCompact; // Packed after the grid is built, when the layout is compact.
+    bool mPacked = false;  // Whether the last update read mCompact.
+    FlockState mBack;      // Next kinematics while buffered. Whole boids when reordering.
+    ScratchArena mScratch; // Reset at the start of every update().
+
+    uint32_t mSeed = 0;
+    uint64_t mTick = 0;     // Updates since the seed was set.
+    uint32_t mNoiseKey = 0; // noiseKey() of the current update.
+};
@@ -0,0 +1,144 @@
+#include "core/flock_params.hpp"
+
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string_view>
+#include <system_error>
+
+/**
+ * File key of each member.
+ */
+static constexpr struct
+{
+    std::string_view key;
+    float FlockParams::*member;
+} KEYS[] = {
+    {"avoid_factor", &FlockParams::avoidFactor},
+    {"visual_range", &FlockParams::visualRange},
+    {"centering_factor", &FlockParams::centeringFactor},
+    {"matching_factor", &FlockParams::matchingFactor},
+    {"max_speed", &FlockParams::maxSpeed},
+    {"min_speed", &FlockParams::minSpeed},
+    {"bias_val", &FlockParams::biasVal},
+    {"noise_strength", &FlockParams::noiseStrength},
+    {"far_centering_factor", &FlockParams::farCenteringFactor},
+    {"far_matching_factor", &FlockParams::farMatchingFactor},
+    {"far_theta", &FlockParams::farTheta},
+};
+
+static std::string_view trim(std::string_view s)
+{
+    const size_t begin = s.find_first_not_of(" \t\r");
+    if (begin == std::string_view::npos)
+    {
+        return {};
+    }
+    return s.substr(begin, s.find_last_not_of(" \t\r") - begin + 1);
+}
+
+bool checkParams(const FlockParams &params, std::string &error)
+{
+    // Negated comparisons so NaN fails too.
+    if (!(params.visualRange > 0.f))
+    {
+        error = "visual_range must be positive";
+        return false;
+    }
+    if (!(params.minSpeed >= 0.f && params.minSpeed <= params.maxSpeed))
+    {
+        error = "need 0 <= min_speed <= max_speed";
+        return false;
+    }
+    if (!(params.farTheta >= 0.f))
+    {
+        error = "far_theta must be non-negative";
+        return false;
+    }
+    return true;
+}
+
+bool loadParams(const std::filesystem::path &path, FlockParams &params, std::string &error)
+{
+    std::ifstream file(path);
+    if (!file)
+    {
+        error = "cannot open " + path.string();
+        return false;
+    }
+
+    FlockParams loaded = params;
+    std::string line;
+    for (int number = 1; std::getline(file, line); number++)
+    {
+        const std::string_view content = trim(std::string_view(line).substr(0, line.find('#')));
+        if (content.empty())
+        {
+            continue;
+        }
+
+        const std::string where = path.string() + ":" + std::to_string(number) + ": ";
+        const size_t equals = content.find('=');
+        if (equals == std::string_view::npos)
+        {
+            error = where + "expected key = value";
+            return false;
+        }
+
+        const std::string_view key = trim(content.substr(0, equals));
+        const std::string value(trim(content.substr(equals + 1)));
+        char *end = nullptr;
+        const float parsed = std::strtof(value.c_str(), &end);
+        if (value.empty() || *end != '\0' || !std::isfinite(parsed))
+        {
+            error = where + "bad value '" + value + "'";
+            return false;
+        }
+
+        bool known = false;
+        for (const auto &entry : KEYS)
+        {
+            if (entry.key == key)
+            {
+                loaded.*entry.member = parsed;
+                known = true;
+                break;
+            }
+        }
+        if (!known)
+        {
+            error = where + "unknown key '" + std::string(key) + "'";
+            return false;
+        }
+    }
+
+    if (!checkParams(loaded, error))
+    {
+        error = path.string() + ": " + error;
+        return false;
+    }
+
+    params = loaded;
+    return true;
+}
+
+bool ParamsFile::poll(FlockParams &params)
+{
+    std::error_code ec;
+    const std::filesystem::file_time_type time = std::filesystem::last_write_time(mPath, ec);
+    if (ec || time == mLoadedTime)
+    {
+        return false;
+    }
+
+    // Remember the time even on failure, so a broken file is reported once per save.
+    mLoadedTime = time;
+    std::string error;
+    if (!loadParams(mPath, params, error))
+    {
+        std::cerr << error << "\n";
+        return false;
+    }
+    return true;
+}
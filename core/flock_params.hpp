@@ -0,0 +1,86 @@
+#pragma once
+
+#include <filesystem>
+#include <string>
+
+/**
+ * Tunable constants of the flocking rules. The defaults are the DEFAULT_PARAMS preset, which
+ * Flock runs through a specialization with every rule constant folded in.
+ *
+ * The far field is off while both far factors are 0. Otherwise every boid is also pulled
+ * towards and matches the velocity of all boids farther than the visual range, each weighted by
+ * the inverse square of its distance, through a Barnes-Hut quadtree (see QuadTree).
+ */
+struct FlockParams
+{
+    float avoidFactor = 0.5f;        // Weight of the push away from overlapping boids.
+    float visualRange = 20.f;        // Gap between two boids' edges below which they interact.
+    float centeringFactor = 0.0005f; // Weight of the pull towards the neighbours' centre.
+    float matchingFactor = 0.05f;    // Weight of matching the neighbours' velocity.
+    float maxSpeed = 6.f;            // Pixels per tick a boid is slowed down to.
+    float minSpeed = 1.f;            // Pixels per tick a boid is sped up to.
+    float biasVal = 0.005f;          // Weight of steering towards the destination.
+    float noiseStrength = 0.1f;      // Largest random change of velocity per tick and axis.
+    float farCenteringFactor = 0.f;  // Weight of the pull of boids beyond the visual range.
+    float farMatchingFactor = 0.f;   // Weight of matching the velocity of those boids.
+    float farTheta = 0.5f;           // Opening angle of the far field, 0 for exact.
+
+    constexpr bool operator==(const FlockParams &) const = default;
+};
+
+inline constexpr FlockParams DEFAULT_PARAMS{};
+
+/**
+ * @brief	Whether params enable the far field.
+ */
+inline constexpr bool hasFarField(const FlockParams &params)
+{
+    return params.farCenteringFactor != 0.f || params.farMatchingFactor != 0.f;
+}
+
+/**
+ * @brief	Checks the constraints every parameter set must meet: a positive visual range,
+ *          0 <= min speed <= max speed and a non-negative far theta.
+ * @param	params	    Parameters to check.
+ * @param	error	    Receives a description of the first violation on failure.
+ */
+bool checkParams(const FlockParams &params, std::string &error);
+
+/**
+ * @brief	Reads "key = value" lines into params. Keys are the member names in snake_case (e.g.
+ *          visual_range), '#' starts a comment and keys that are not given keep their value.
+ * @param	path	    File to read.
+ * @param	params	    Receives the values. Left untouched on failure.
+ * @param	error	    Receives a description of the first problem on failure.
+ * @return	false if the file can't be read, has an unknown key or malformed value, or the result
+ *          is invalid, see checkParams().
+ */
+bool loadParams(const std::filesystem::path &path, FlockParams &params, std::string &error);
+
+/**
+ * A parameter file watched for changes by modification time.
+ */
+class ParamsFile
+{
+public:
+    /**
+     * @brief	Construct a new Params File object. Nothing is read until poll().
+     * @param	path	    File to watch.
+     */
+    explicit ParamsFile(std::filesystem::path path) : mPath(std::move(path)) {}
+
+    /**
+     * @brief	Reloads the file if it changed since the last call. Cheap enough to call every
+     *          frame or so: unchanged files cost one stat().
+     * @param	params	    Receives the new values. Keys the file leaves out keep their value.
+     * @return	true if params was updated. A file that fails to load is reported on stderr and
+     *          tried again once it changes.
+     */
+    bool poll(FlockParams &params);
+
+    const std::filesystem::path &path() const { return mPath; }
+
+private:
+    std::filesystem::path mPath;
+    std::filesystem::file_time_type mLoadedTime{};
+};
@@ -0,0 +1,119 @@
+#pragma once
+
+#include "core/aligned_allocator.hpp"
+#include "core/color.hpp"
+
+#include <cstdint>
+#include <vector>
+
+/**
+ * Simulation state of a flock, stored as one contiguous array per attribute so that the
+ * neighbour loop streams through memory instead of chasing a pointer per boid.
+ */
+struct FlockState
+{
+    FloatArray posX;
+    FloatArray posY;
+    FloatArray velX;
+    FloatArray velY;
+    FloatArray radius;
+    std::vector<Color> color;
+    std::vector<uint32_t> id; // Stable identity of the boid in each slot, in insertion order.
+
+    size_t size() const { return posX.size(); }
+
+    /**
+     * @brief	Appends a boid at rest.
+     * @param	x	        Initial X coordinate.
+     * @param	y	        Initial Y coordinate.
+     * @param	r	        Radius.
+     * @param	c	        Color.
+     */
+    void add(float x, float y, float r, Color c)
+    {
+        posX.push_back(x);
+        posY.push_back(y);
+        velX.push_back(0.f);
+        velY.push_back(0.f);
+        radius.push_back(r);
+        color.push_back(c);
+        id.push_back(static_cast<uint32_t>(id.size()));
+    }
+
+    /**
+     * @brief	Sizes the position and velocity arrays, the only ones written by an update.
+     * @param	n	        Number of boids.
+     */
+    void resizeKinematics(size_t n)
+    {
+        posX.resize(n);
+        posY.resize(n);
+        velX.resize(n);
+        velY.resize(n);
+    }
+
+    /**
+     * @brief	Sizes every array. New slots hold default values until written.
+     * @param	n	        Number of boids.
+     */
+    void resize(size_t n)
+    {
+        resizeKinematics(n);
+        radius.resize(n);
+        color.resize(n);
+        id.resize(n);
+    }
+
+    /**
+     * @brief	Exchanges position and velocity arrays with another state in O(1).
+     * @param	other	    State to swap with.
+     */
+    void swapKinematics(FlockState &other)
+    {
+        posX.swap(other.posX);
+        posY.swap(other.posY);
+        velX.swap(other.velX);
+        velY.swap(other.velY);
+    }
+
+    /**
+     * @brief	Reorders every array so that slot k holds the boid previously in slot order[k].
+     * @param	order	    Permutation of [0, size()).
+     * @param	scratch	    Receives the old arrays. Its storage is reused between calls.
+     */
+    void permute(const uint32_t *order, FlockState &scratch)
+    {
+        gather(posX, order, scratch.posX);
+        gather(posY, order, scratch.posY);
+        gather(velX, order, scratch.velX);
+        gather(velY, order, scratch.velY);
+        gather(radius, order, scratch.radius);
+        gather(color, order, scratch.color);
+        gather(id, order, scratch.id);
+    }
+
+    /**
+     * @brief	Removes all boids. Capacity is kept.
+     */
+    void clear()
+    {
+        posX.clear();
+        posY.clear();
+        velX.clear();
+        velY.clear();
+        radius.clear();
+        color.clear();
+        id.clear();
+    }
+
+private:
+    template <typename Array> static void gather(Array &a, const uint32_t *order, Array &scratch)
+    {
+        scratch.resize(a.size());
+        for (size_t k = 0; k < a.size(); k++)
+        {
+            scratch[k] = a[order[k]];
+        }
+        a.swap(scratch);
+    }
+};
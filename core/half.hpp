@@ -0,0 +1,50 @@
+#pragma once
+
+#include <bit>
+#include <cstdint>
+
+/**
+ * IEEE 754 binary16 conversions for the compact boid layout. Halves keep 11 significant bits, so
+ * a velocity is stored to within 2^-11 of its magnitude.
+ */
+
+/**
+ * @brief	Rounds a float to the nearest half, ties to even. Overflows to infinity, keeps NaN.
+ * @param	f	        Value to convert.
+ */
+inline uint16_t floatToHalf(float f)
+{
+    uint32_t x = std::bit_cast<uint32_t>(f);
+    const auto sign = static_cast<uint16_t>((x >> 16) & 0x8000u);
+    x &= 0x7fffffffu;
+
+    if (x >= 0x7f800000u)
+    {
+        return sign | (x > 0x7f800000u ? 0x7e00u : 0x7c00u);
+    }
+    if (x >= 0x477ff000u)
+    {
+        return sign | 0x7c00u; // Rounds past the largest half, 65504.
+    }
+    if (x < 0x38800000u)
+    {
+        // Below the smallest normal half. Adding 0.5 lines the float's last mantissa bit up with
+        // the half's denormal step, so the addition does the rounding.
+        const float shifted = std::bit_cast<float>(x) + 0.5f;
+        return sign | static_cast<uint16_t>(std::bit_cast<uint32_t>(shifted) - 0x3f000000u);
+    }
+    // Rebias the exponent from 127 to 15 and round the 13 dropped bits to even.
+    x += 0xc8000fffu + ((x >> 13) & 1u);
+    return sign | static_cast<uint16_t>(x >> 13);
+}
+
+/**
+ * @brief	Widens a finite half to a float. Infinities and NaN come out as large finite values.
+ * @param	h	        Half to convert.
+ */
+inline float halfToFloat(uint16_t h)
+{
+    // Shifted into place the half reads as a float 2^112 too small, denormals included.
+    const float magnitude = std::bit_cast<float>(uint32_t{h & 0x7fffu} << 13) * 0x1p112f;
+    return std::bit_cast<float>(std::bit_cast<uint32_t>(magnitude) | uint32_t{h & 0x8000u} << 16);
+}
@@ -0,0 +1,77 @@
+#include "core/transport.hpp"
+
+#include <mpi.h>
+#include <algorithm>
+#include <cstdint>
+
+MpiTransport::MpiTransport()
+{
+    int rank = 0;
+    int size = 1;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+    mRank = static_cast<size_t>(rank);
+    mSize = static_cast<size_t>(size);
+    mSendCounts.resize(mSize);
+    mSendOffsets.resize(mSize);
+    mRecvCounts.resize(mSize);
+    mRecvOffsets.resize(mSize);
+}
+
+bool MpiTransport::exchange(const std::vector<Buffer> &out, std::vector<Buffer> &in,
+                            std::string &error)
+{
+    if (out.size() != mSize)
+    {
+        error = "exchange needs one buffer per rank";
+        return false;
+    }
+
+    // Counts are ints in MPI, which caps each message at 2 GiB.
+    size_t total = 0;
+    for (size_t r = 0; r < mSize; r++)
+    {
+        if (out[r].size() > INT32_MAX || total + out[r].size() > INT32_MAX)
+        {
+            error = "message to rank " + std::to_string(r) + " is too large for MPI";
+            return false;
+        }
+        mSendCounts[r] = static_cast<int>(out[r].size());
+        mSendOffsets[r] = static_cast<int>(total);
+        total += out[r].size();
+    }
+    mSend.resize(total);
+    for (size_t r = 0; r < mSize; r++)
+    {
+        std::copy(out[r].begin(), out[r].end(), mSend.begin() + mSendOffsets[r]);
+    }
+
+    if (MPI_Alltoall(mSendCounts.data(), 1, MPI_INT, mRecvCounts.data(), 1, MPI_INT,
+                     MPI_COMM_WORLD) != MPI_SUCCESS)
+    {
+        error = "MPI_Alltoall failed";
+        return false;
+    }
+    total = 0;
+    for (size_t r = 0; r < mSize; r++)
+    {
+        mRecvOffsets[r] = static_cast<int>(total);
+        total += static_cast<size_t>(mRecvCounts[r]);
+    }
+    mRecv.resize(total);
+    if (MPI_Alltoallv(mSend.data(), mSendCounts.data(), mSendOffsets.data(), MPI_BYTE,
+                      mRecv.data(), mRecvCounts.data(), mRecvOffsets.data(), MPI_BYTE,
+                      MPI_COMM_WORLD) != MPI_SUCCESS)
+    {
+        error = "MPI_Alltoallv failed";
+        return false;
+    }
+
+    in.resize(mSize);
+    for (size_t r = 0; r < mSize; r++)
+    {
+        const auto first = mRecv.begin() + mRecvOffsets[r];
+        in[r].assign(first, first + mRecvCounts[r]);
+    }
+    return true;
+}
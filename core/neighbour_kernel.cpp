@@ -0,0 +1,801 @@
+#include "core/neighbour_kernel.hpp"
+#include "core/fast_math.hpp"
+#include "core/half.hpp"
+#include "core/vec2.hpp"
+
+#include <cmath>
+#include <initializer_list>
+
+/**
+ * @brief	Separation push of a candidate neighbour, if it is within the visual range.
+ * @tparam	Fast	    Use the MathMode::Fast approximations.
+ * @param	toOther	    From the boid to the candidate.
+ * @param	radii	    Sum of both radii.
+ * @param	range	    Visual range.
+ * @param	push	    Receives the push if the candidate is a neighbour.
+ * @return	false if the candidate is out of range.
+ */
+template <bool Fast>
+static inline bool pairPush(Vec2 toOther, float radii, float range, Vec2 &push)
+{
+    if constexpr (Fast)
+    {
+        // dist < range exactly when the squared distance is below (range + radii)^2, so most
+        // candidates are rejected before any square root.
+        const float d2 = toOther.lengthSquared();
+        const float reach = range + radii;
+        if (!(d2 < reach * reach))
+        {
+            return false;
+        }
+        const float rs = fastRsqrt(d2);
+        push = toOther * (rs * fastExp2(radii - d2 * rs));
+    }
+    else
+    {
+        const float len = toOther.length();
+        const float dist = len - radii;
+        if (!(dist < range))
+        {
+            return false;
+        }
+        push = toOther / (len * std::pow(2.f, dist));
+    }
+    return true;
+}
+
+/**
+ * @brief	Reference kernel. Adds one candidate neighbour j to the neighbourhood of boid i.
+ * @tparam	Fast	    Use the MathMode::Fast approximations.
+ */
+template <bool Fast>
+static inline void accumulateScalar(const KernelInput &in, uint32_t i, uint32_t j,
+                                    Neighbourhood &nb)
+{
+    if (i == j)
+    {
+        return;
+    }
+
+    const Vec2 toOther{in.posX[j] - in.posX[i], in.posY[j] - in.posY[i]};
+    Vec2 push;
+    if (!pairPush<Fast>(toOther, in.radius[i] + in.radius[j], in.visualRange, push))
+    {
+        return;
+    }
+
+    nb.sepX -= push.x;
+    nb.sepY -= push.y;
+    nb.velX += in.velX[j];
+    nb.velY += in.velY[j];
+    nb.posX += in.posX[j];
+    nb.posY += in.posY[j];
+    nb.count++;
+}
+
+template <bool Fast>
+static void scalarRange(const KernelInput &in, uint32_t i, uint32_t begin, uint32_t end,
+                        Neighbourhood &nb)
+{
+    for (uint32_t j = begin; j < end; j++)
+    {
+        accumulateScalar<Fast>(in, i, j, nb);
+    }
+}
+
+template <bool Fast>
+static void scalarIndexed(const KernelInput &in, uint32_t i, const uint32_t *indices,
+                          size_t count, Neighbourhood &nb)
+{
+    for (size_t k = 0; k < count; k++)
+    {
+        accumulateScalar<Fast>(in, i, indices[k], nb);
+    }
+}
+
+/**
+ * @brief	Reference compact kernel. Adds one candidate neighbour j, in the cell at q.cellMin, to
+ *          the neighbourhood of the query boid.
+ * @tparam	Fast	    Use the MathMode::Fast approximations.
+ */
+template <bool Fast>
+static inline void accumulateCompact(const CompactInput &in, const CompactQuery &q, uint32_t j,
+                                     Neighbourhood &nb)
+{
+    if (j == q.self)
+    {
+        return;
+    }
+
+    // Relative to the cell, like the SIMD kernels, so both round the same way.
+    const uint32_t pos = in.pos[j];
+    const Vec2 at{static_cast<float>(pos & 0xffffu) * in.scale,
+                  static_cast<float>(pos >> 16) * in.scale};
+    const Vec2 toOther = at - (q.pos - q.cellMin);
+    Vec2 push;
+    if (!pairPush<Fast>(toOther, q.radius + in.palette[in.radius[j]], in.visualRange, push))
+    {
+        return;
+    }
+
+    const uint32_t vel = in.vel[j];
+    nb.sepX -= push.x;
+    nb.sepY -= push.y;
+    nb.velX += halfToFloat(static_cast<uint16_t>(vel));
+    nb.velY += halfToFloat(static_cast<uint16_t>(vel >> 16));
+    nb.posX += q.cellMin.x + at.x;
+    nb.posY += q.cellMin.y + at.y;
+    nb.count++;
+}
+
+template <bool Fast>
+static void scalarCompactRange(const CompactInput &in, const CompactQuery &q, uint32_t begin,
+                               uint32_t end, Neighbourhood &nb)
+{
+    for (uint32_t j = begin; j < end; j++)
+    {
+        accumulateCompact<Fast>(in, q, j, nb);
+    }
+}
+
+template <bool Fast>
+static void scalarCompactIndexed(const CompactInput &in, const CompactQuery &q,
+                                 const uint32_t *indices, size_t count, Neighbourhood &nb)
+{
+    for (size_t k = 0; k < count; k++)
+    {
+        accumulateCompact<Fast>(in, q, indices[k], nb);
+    }
+}
+
+static constexpr NeighbourKernel SCALAR_KERNEL{"scalar", scalarRange<false>, scalarIndexed<false>,
+                                               scalarCompactRange<false>,
+                                               scalarCompactIndexed<false>};
+static constexpr NeighbourKernel SCALAR_FAST_KERNEL{"scalar", scalarRange<true>,
+                                                    scalarIndexed<true>, scalarCompactRange<true>,
+                                                    scalarCompactIndexed<true>};
+
+// Coefficients of 2^f - 1 = f * P(f) on [-0.5, 0.5] (Cephes exp2f), relative error ~2e-7.
+static constexpr float EXP2_P0 = 1.535336188319500e-4f;
+static constexpr float EXP2_P1 = 1.339887440266574e-3f;
+static constexpr float EXP2_P2 = 9.618437357674640e-3f;
+static constexpr float EXP2_P3 = 5.550332471162809e-2f;
+static constexpr float EXP2_P4 = 2.402264791363012e-1f;
+static constexpr float EXP2_P5 = 6.931472028550421e-1f;
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define FLOCK_HAVE_AVX2 1
+#include <immintrin.h>
+
+// Compiled for AVX2 regardless of the baseline target; only called after a CPU feature check.
+// F16C, for the compact layout's velocities, shipped on every AVX2 CPU alongside it.
+#define FLOCK_AVX2 __attribute__((target("avx2,fma,f16c")))
+
+/**
+ * @brief	Polynomial exp2 for |x| <= 126, 8 lanes at a time.
+ */
+FLOCK_AVX2 static inline __m256 exp2Avx2(__m256 x)
+{
+    x = _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(-126.f)), _mm256_set1_ps(126.f));
+    const __m256 whole = _mm256_round_ps(x, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    const __m256 f = _mm256_sub_ps(x, whole);
+
+    __m256 p = _mm256_set1_ps(EXP2_P0);
+    p = _mm256_fmadd_ps(p, f, _mm256_set1_ps(EXP2_P1));
+    p = _mm256_fmadd_ps(p, f, _mm256_set1_ps(EXP2_P2));
+    p = _mm256_fmadd_ps(p, f, _mm256_set1_ps(EXP2_P3));
+    p = _mm256_fmadd_ps(p, f, _mm256_set1_ps(EXP2_P4));
+    p = _mm256_fmadd_ps(p, f, _mm256_set1_ps(EXP2_P5));
+    p = _mm256_fmadd_ps(p, f, _mm256_set1_ps(1.f));
+
+    const __m256i bias = _mm256_add_epi32(_mm256_cvtps_epi32(whole), _mm256_set1_epi32(127));
+    return _mm256_mul_ps(p, _mm256_castsi256_ps(_mm256_slli_epi32(bias, 23)));
+}
+
+/**
+ * @brief	fastExp2(), 8 lanes at a time.
+ */
+FLOCK_AVX2 static inline __m256 fastExp2Avx2(__m256 x)
+{
+    x = _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(-126.f)), _mm256_set1_ps(126.f));
+    const __m256 whole = _mm256_round_ps(x, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    const __m256 f = _mm256_sub_ps(x, whole);
+
+    __m256 p = _mm256_set1_ps(FAST_EXP2_C3);
+    p = _mm256_fmadd_ps(p, f, _mm256_set1_ps(FAST_EXP2_C2));
+    p = _mm256_fmadd_ps(p, f, _mm256_set1_ps(FAST_EXP2_C1));
+    p = _mm256_fmadd_ps(p, f, _mm256_set1_ps(FAST_EXP2_C0));
+
+    const __m256i bias = _mm256_add_epi32(_mm256_cvtps_epi32(whole), _mm256_set1_epi32(127));
+    return _mm256_mul_ps(p, _mm256_castsi256_ps(_mm256_slli_epi32(bias, 23)));
+}
+
+/**
+ * @brief	Hardware 1 / sqrt(x) estimate refined by one Newton step, within fastRsqrt()'s bound.
+ */
+FLOCK_AVX2 static inline __m256 rsqrtAvx2(__m256 x)
+{
+    const __m256 y = _mm256_rsqrt_ps(x);
+    const __m256 halfXY = _mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(0.5f), x), y);
+    return _mm256_mul_ps(y, _mm256_fnmadd_ps(halfXY, y, _mm256_set1_ps(1.5f)));
+}
+
+struct Avx2Sums
+{
+    __m256 sepX;
+    __m256 sepY;
+    __m256 velX;
+    __m256 velY;
+    __m256 posX;
+    __m256 posY;
+    int count;
+};
+
+/**
+ * Velocities of 8 candidates as floats.
+ */
+struct Avx2Velocities
+{
+    __m256 x;
+    __m256 y;
+
+    FLOCK_AVX2 void unpack(__m256 &outX, __m256 &outY) const
+    {
+        outX = x;
+        outY = y;
+    }
+};
+
+/**
+ * @brief	Adds 8 candidate neighbours to the sums. Lanes outside valid contribute nothing.
+ * @tparam	Fast	    Use the MathMode::Fast approximations.
+ * @param	vel2	    Avx2Velocities, or a type with the same unpack(), which is only called if
+ *                      a lane is within range.
+ */
+template <bool Fast, typename Velocities>
+FLOCK_AVX2 static inline void accumulateAvx2(Avx2Sums &sums, __m256 px, __m256 py, __m256 pos2X,
+                                             __m256 pos2Y, const Velocities &vel2, __m256 r,
+                                             __m256 r2, __m256 range, __m256 valid)
+{
+    const __m256 dx = _mm256_sub_ps(pos2X, px);
+    const __m256 dy = _mm256_sub_ps(pos2Y, py);
+    const __m256 d2 = _mm256_fmadd_ps(dx, dx, _mm256_mul_ps(dy, dy));
+    const __m256 radii = _mm256_add_ps(r, r2);
+
+    // Fast mode tests the squared distance against (range + radii)^2, skipping the sqrt too.
+    __m256 len;
+    __m256 in;
+    if constexpr (Fast)
+    {
+        const __m256 reach = _mm256_add_ps(range, radii);
+        in = _mm256_and_ps(_mm256_cmp_ps(d2, _mm256_mul_ps(reach, reach), _CMP_LT_OQ), valid);
+    }
+    else
+    {
+        len = _mm256_sqrt_ps(d2);
+        const __m256 dist = _mm256_sub_ps(len, radii);
+        in = _mm256_and_ps(_mm256_cmp_ps(dist, range, _CMP_LT_OQ), valid);
+    }
+
+    // Most candidates fall outside the visual range; skip the divide and exp2 when all lanes do.
+    const int hits = _mm256_movemask_ps(in);
+    if (hits == 0)
+    {
+        return;
+    }
+
+    __m256 inv;
+    if constexpr (Fast)
+    {
+        // Lanes outside the range would drive exp2 to denormals, which cost a microcode assist
+        // each; zeroing their exponent keeps every lane normal.
+        const __m256 rs = rsqrtAvx2(d2);
+        const __m256 minusDist = _mm256_and_ps(in, _mm256_fnmadd_ps(d2, rs, radii));
+        inv = _mm256_mul_ps(rs, fastExp2Avx2(minusDist));
+    }
+    else
+    {
+        const __m256 dist = _mm256_sub_ps(len, radii);
+        inv = _mm256_div_ps(_mm256_set1_ps(1.f), _mm256_mul_ps(len, exp2Avx2(dist)));
+    }
+
+    __m256 vel2X;
+    __m256 vel2Y;
+    vel2.unpack(vel2X, vel2Y);
+    sums.sepX = _mm256_sub_ps(sums.sepX, _mm256_and_ps(in, _mm256_mul_ps(dx, inv)));
+    sums.sepY = _mm256_sub_ps(sums.sepY, _mm256_and_ps(in, _mm256_mul_ps(dy, inv)));
+    sums.velX = _mm256_add_ps(sums.velX, _mm256_and_ps(in, vel2X));
+    sums.velY = _mm256_add_ps(sums.velY, _mm256_and_ps(in, vel2Y));
+    sums.posX = _mm256_add_ps(sums.posX, _mm256_and_ps(in, pos2X));
+    sums.posY = _mm256_add_ps(sums.posY, _mm256_and_ps(in, pos2Y));
+    sums.count += __builtin_popcount(hits);
+}
+
+FLOCK_AVX2 static inline float hsumAvx2(__m256 v)
+{
+    __m128 s = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+    s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+    s = _mm_add_ss(s, _mm_movehdup_ps(s));
+    return _mm_cvtss_f32(s);
+}
+
+FLOCK_AVX2 static inline void flushAvx2(const Avx2Sums &sums, Neighbourhood &nb)
+{
+    nb.sepX += hsumAvx2(sums.sepX);
+    nb.sepY += hsumAvx2(sums.sepY);
+    nb.velX += hsumAvx2(sums.velX);
+    nb.velY += hsumAvx2(sums.velY);
+    nb.posX += hsumAvx2(sums.posX);
+    nb.posY += hsumAvx2(sums.posY);
+    nb.count += sums.count;
+}
+
+template <bool Fast>
+FLOCK_AVX2 static void avx2Range(const KernelInput &in, uint32_t i, uint32_t begin, uint32_t end,
+                                 Neighbourhood &nb)
+{
+    const __m256 px = _mm256_set1_ps(in.posX[i]);
+    const __m256 py = _mm256_set1_ps(in.posY[i]);
+    const __m256 r = _mm256_set1_ps(in.radius[i]);
+    const __m256 range = _mm256_set1_ps(in.visualRange);
+    const __m256i self = _mm256_set1_epi32(static_cast<int>(i));
+    const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    const __m256 zero = _mm256_setzero_ps();
+
+    Avx2Sums sums{zero, zero, zero, zero, zero, zero, 0};
+    for (uint32_t j = begin; j < end; j += 8)
+    {
+        const __m256i idx = _mm256_add_epi32(_mm256_set1_epi32(static_cast<int>(j)), lanes);
+        const __m256i inRange =
+            _mm256_cmpgt_epi32(_mm256_set1_epi32(static_cast<int>(end - j)), lanes);
+        const __m256i valid = _mm256_andnot_si256(_mm256_cmpeq_epi32(idx, self), inRange);
+
+        const Avx2Velocities vel2{_mm256_maskload_ps(in.velX + j, inRange),
+                                  _mm256_maskload_ps(in.velY + j, inRange)};
+        accumulateAvx2<Fast>(sums, px, py, _mm256_maskload_ps(in.posX + j, inRange),
+                             _mm256_maskload_ps(in.posY + j, inRange), vel2, r,
+                             _mm256_maskload_ps(in.radius + j, inRange), range,
+                             _mm256_castsi256_ps(valid));
+    }
+    flushAvx2(sums, nb);
+}
+
+template <bool Fast>
+FLOCK_AVX2 static void avx2Indexed(const KernelInput &in, uint32_t i, const uint32_t *indices,
+                                   size_t count, Neighbourhood &nb)
+{
+    const __m256 px = _mm256_set1_ps(in.posX[i]);
+    const __m256 py = _mm256_set1_ps(in.posY[i]);
+    const __m256 r = _mm256_set1_ps(in.radius[i]);
+    const __m256 range = _mm256_set1_ps(in.visualRange);
+    const __m256i self = _mm256_set1_epi32(static_cast<int>(i));
+    const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    const __m256 zero = _mm256_setzero_ps();
+
+    Avx2Sums sums{zero, zero, zero, zero, zero, zero, 0};
+    for (size_t k = 0; k < count; k += 8)
+    {
+        const __m256i inRange =
+            _mm256_cmpgt_epi32(_mm256_set1_epi32(static_cast<int>(count - k)), lanes);
+        const __m256i idx =
+            _mm256_maskload_epi32(reinterpret_cast<const int *>(indices + k), inRange);
+        const __m256i valid = _mm256_andnot_si256(_mm256_cmpeq_epi32(idx, self), inRange);
+        const __m256 mask = _mm256_castsi256_ps(inRange);
+
+        const Avx2Velocities vel2{_mm256_mask_i32gather_ps(zero, in.velX, idx, mask, 4),
+                                  _mm256_mask_i32gather_ps(zero, in.velY, idx, mask, 4)};
+        accumulateAvx2<Fast>(sums, px, py, _mm256_mask_i32gather_ps(zero, in.posX, idx, mask, 4),
+                             _mm256_mask_i32gather_ps(zero, in.posY, idx, mask, 4), vel2, r,
+                             _mm256_mask_i32gather_ps(zero, in.radius, idx, mask, 4), range,
+                             _mm256_castsi256_ps(valid));
+    }
+    flushAvx2(sums, nb);
+}
+
+/**
+ * Velocities of 8 compact candidates, still packed as half pairs. Widened, as halfToFloat() does,
+ * only for candidates within range.
+ */
+struct Avx2PackedHalves
+{
+    __m256i packed;
+
+    FLOCK_AVX2 void unpack(__m256 &x, __m256 &y) const
+    {
+        // Gather the x halves of each 128-bit lane in its low and the y halves in its high 8
+        // bytes, then bring the two x quads together ahead of the y quads.
+        const __m256i split = _mm256_shuffle_epi8(
+            packed, _mm256_setr_epi8(0, 1, 4, 5, 8, 9, 12, 13, 2, 3, 6, 7, 10, 11, 14, 15, 0, 1,
+                                     4, 5, 8, 9, 12, 13, 2, 3, 6, 7, 10, 11, 14, 15));
+        const __m256i ordered = _mm256_permute4x64_epi64(split, _MM_SHUFFLE(3, 1, 2, 0));
+        x = _mm256_cvtph_ps(_mm256_castsi256_si128(ordered));
+        y = _mm256_cvtph_ps(_mm256_extracti128_si256(ordered, 1));
+    }
+};
+
+/**
+ * @brief	Radii of 8 palette indices. A small palette sits in one register, see CompactInput.
+ */
+FLOCK_AVX2 static inline __m256 paletteAvx2(const CompactInput &in, __m256 small, __m256i index)
+{
+    return in.smallPalette ? _mm256_permutevar8x32_ps(small, index)
+                           : _mm256_i32gather_ps(in.palette, index, 4);
+}
+
+/**
+ * @brief	Decodes 8 packed compact boids and adds them to the sums. Positions stay relative to
+ *          the cell, so px and py must be too.
+ */
+template <bool Fast>
+FLOCK_AVX2 static inline void accumulateCompactAvx2(Avx2Sums &sums, __m256 px, __m256 py,
+                                                    __m256i pos, __m256i vel, __m256 r,
+                                                    __m256 r2, __m256 scale, __m256 range,
+                                                    __m256 valid)
+{
+    const __m256i low = _mm256_set1_epi32(0xffff);
+    const __m256 pos2X = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_and_si256(pos, low)), scale);
+    const __m256 pos2Y = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srli_epi32(pos, 16)), scale);
+    accumulateAvx2<Fast>(sums, px, py, pos2X, pos2Y, Avx2PackedHalves{vel}, r, r2, range, valid);
+}
+
+/**
+ * @brief	flushAvx2() for sums of cell-relative positions.
+ */
+FLOCK_AVX2 static inline void flushCompactAvx2(const Avx2Sums &sums, Vec2 cellMin,
+                                               Neighbourhood &nb)
+{
+    flushAvx2(sums, nb);
+    nb.posX += static_cast<float>(sums.count) * cellMin.x;
+    nb.posY += static_cast<float>(sums.count) * cellMin.y;
+}
+
+template <bool Fast>
+FLOCK_AVX2 static void avx2CompactRange(const CompactInput &in, const CompactQuery &q,
+                                        uint32_t begin, uint32_t end, Neighbourhood &nb)
+{
+    const __m256 px = _mm256_set1_ps(q.pos.x - q.cellMin.x);
+    const __m256 py = _mm256_set1_ps(q.pos.y - q.cellMin.y);
+    const __m256 r = _mm256_set1_ps(q.radius);
+    const __m256 scale = _mm256_set1_ps(in.scale);
+    const __m256 range = _mm256_set1_ps(in.visualRange);
+    const __m256i self = _mm256_set1_epi32(static_cast<int>(q.self));
+    const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    const __m256 small = _mm256_loadu_ps(in.palette);
+    const __m256 zero = _mm256_setzero_ps();
+
+    Avx2Sums sums{zero, zero, zero, zero, zero, zero, 0};
+    for (uint32_t j = begin; j < end; j += 8)
+    {
+        const __m256i idx = _mm256_add_epi32(_mm256_set1_epi32(static_cast<int>(j)), lanes);
+        const __m256i inRange =
+            _mm256_cmpgt_epi32(_mm256_set1_epi32(static_cast<int>(end - j)), lanes);
+        const __m256i valid = _mm256_andnot_si256(_mm256_cmpeq_epi32(idx, self), inRange);
+
+        // The radius indices are padded, so all 8 bytes can be read even at the end.
+        const __m256i index = _mm256_cvtepu8_epi32(
+            _mm_loadl_epi64(reinterpret_cast<const __m128i *>(in.radius + j)));
+        accumulateCompactAvx2<Fast>(
+            sums, px, py, _mm256_maskload_epi32(reinterpret_cast<const int *>(in.pos + j), inRange),
+            _mm256_maskload_epi32(reinterpret_cast<const int *>(in.vel + j), inRange), r,
+            paletteAvx2(in, small, index), scale, range, _mm256_castsi256_ps(valid));
+    }
+    flushCompactAvx2(sums, q.cellMin, nb);
+}
+
+template <bool Fast>
+FLOCK_AVX2 static void avx2CompactIndexed(const CompactInput &in, const CompactQuery &q,
+                                          const uint32_t *indices, size_t count,
+                                          Neighbourhood &nb)
+{
+    const __m256 px = _mm256_set1_ps(q.pos.x - q.cellMin.x);
+    const __m256 py = _mm256_set1_ps(q.pos.y - q.cellMin.y);
+    const __m256 r = _mm256_set1_ps(q.radius);
+    const __m256 scale = _mm256_set1_ps(in.scale);
+    const __m256 range = _mm256_set1_ps(in.visualRange);
+    const __m256i self = _mm256_set1_epi32(static_cast<int>(q.self));
+    const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    const __m256i none = _mm256_setzero_si256();
+    const __m256 small = _mm256_loadu_ps(in.palette);
+    const __m256 zero = _mm256_setzero_ps();
+
+    Avx2Sums sums{zero, zero, zero, zero, zero, zero, 0};
+    for (size_t k = 0; k < count; k += 8)
+    {
+        const __m256i inRange =
+            _mm256_cmpgt_epi32(_mm256_set1_epi32(static_cast<int>(count - k)), lanes);
+        const __m256i idx =
+            _mm256_maskload_epi32(reinterpret_cast<const int *>(indices + k), inRange);
+        const __m256i valid = _mm256_andnot_si256(_mm256_cmpeq_epi32(idx, self), inRange);
+
+        // There is no byte gather: read 4 bytes from each index, which the padding allows, and
+        // keep the first.
+        const __m256i index = _mm256_and_si256(
+            _mm256_mask_i32gather_epi32(none, reinterpret_cast<const int *>(in.radius), idx,
+                                        inRange, 1),
+            _mm256_set1_epi32(0xff));
+        accumulateCompactAvx2<Fast>(
+            sums, px, py,
+            _mm256_mask_i32gather_epi32(none, reinterpret_cast<const int *>(in.pos), idx, inRange,
+                                        4),
+            _mm256_mask_i32gather_epi32(none, reinterpret_cast<const int *>(in.vel), idx, inRange,
+                                        4),
+            r, paletteAvx2(in, small, index), scale, range, _mm256_castsi256_ps(valid));
+    }
+    flushCompactAvx2(sums, q.cellMin, nb);
+}
+
+static constexpr NeighbourKernel AVX2_KERNEL{"avx2", avx2Range<false>, avx2Indexed<false>,
+                                             avx2CompactRange<false>, avx2CompactIndexed<false>};
+static constexpr NeighbourKernel AVX2_FAST_KERNEL{"avx2", avx2Range<true>, avx2Indexed<true>,
+                                                  avx2CompactRange<true>,
+                                                  avx2CompactIndexed<true>};
+#endif
+
+#if defined(__aarch64__) && defined(__ARM_NEON)
+#define FLOCK_HAVE_NEON 1
+#include <arm_neon.h>
+
+/**
+ * @brief	Polynomial exp2 for |x| <= 126, 4 lanes at a time.
+ */
+static inline float32x4_t exp2Neon(float32x4_t x)
+{
+    x = vminq_f32(vmaxq_f32(x, vdupq_n_f32(-126.f)), vdupq_n_f32(126.f));
+    const float32x4_t whole = vrndnq_f32(x);
+    const float32x4_t f = vsubq_f32(x, whole);
+
+    float32x4_t p = vdupq_n_f32(EXP2_P0);
+    p = vfmaq_f32(vdupq_n_f32(EXP2_P1), p, f);
+    p = vfmaq_f32(vdupq_n_f32(EXP2_P2), p, f);
+    p = vfmaq_f32(vdupq_n_f32(EXP2_P3), p, f);
+    p = vfmaq_f32(vdupq_n_f32(EXP2_P4), p, f);
+    p = vfmaq_f32(vdupq_n_f32(EXP2_P5), p, f);
+    p = vfmaq_f32(vdupq_n_f32(1.f), p, f);
+
+    const int32x4_t bias = vaddq_s32(vcvtq_s32_f32(whole), vdupq_n_s32(127));
+    return vmulq_f32(p, vreinterpretq_f32_s32(vshlq_n_s32(bias, 23)));
+}
+
+/**
+ * @brief	fastExp2(), 4 lanes at a time.
+ */
+static inline float32x4_t fastExp2Neon(float32x4_t x)
+{
+    x = vminq_f32(vmaxq_f32(x, vdupq_n_f32(-126.f)), vdupq_n_f32(126.f));
+    const float32x4_t whole = vrndnq_f32(x);
+    const float32x4_t f = vsubq_f32(x, whole);
+
+    float32x4_t p = vdupq_n_f32(FAST_EXP2_C3);
+    p = vfmaq_f32(vdupq_n_f32(FAST_EXP2_C2), p, f);
+    p = vfmaq_f32(vdupq_n_f32(FAST_EXP2_C1), p, f);
+    p = vfmaq_f32(vdupq_n_f32(FAST_EXP2_C0), p, f);
+
+    const int32x4_t bias = vaddq_s32(vcvtq_s32_f32(whole), vdupq_n_s32(127));
+    return vmulq_f32(p, vreinterpretq_f32_s32(vshlq_n_s32(bias, 23)));
+}
+
+/**
+ * @brief	Hardware 1 / sqrt(x) estimate refined by two Newton steps, within fastRsqrt()'s
+ *          bound. The NEON estimate is only good to 8 bits, one step fewer than AVX2 needs.
+ */
+static inline float32x4_t rsqrtNeon(float32x4_t x)
+{
+    float32x4_t y = vrsqrteq_f32(x);
+    y = vmulq_f32(y, vrsqrtsq_f32(vmulq_f32(x, y), y));
+    return vmulq_f32(y, vrsqrtsq_f32(vmulq_f32(x, y), y));
+}
+
+struct NeonSums
+{
+    float32x4_t sepX = vdupq_n_f32(0.f);
+    float32x4_t sepY = vdupq_n_f32(0.f);
+    float32x4_t velX = vdupq_n_f32(0.f);
+    float32x4_t velY = vdupq_n_f32(0.f);
+    float32x4_t posX = vdupq_n_f32(0.f);
+    float32x4_t posY = vdupq_n_f32(0.f);
+    uint32x4_t count = vdupq_n_u32(0);
+};
+
+static inline float32x4_t maskNeon(uint32x4_t mask, float32x4_t v)
+{
+    return vreinterpretq_f32_u32(vandq_u32(mask, vreinterpretq_u32_f32(v)));
+}
+
+/**
+ * @brief	Adds 4 candidate neighbours to the sums. Lanes outside valid contribute nothing.
+ * @tparam	Fast	    Use the MathMode::Fast approximations.
+ */
+template <bool Fast>
+static inline void accumulateNeon(NeonSums &sums, float32x4_t px, float32x4_t py,
+                                  float32x4_t pos2X, float32x4_t pos2Y, float32x4_t vel2X,
+                                  float32x4_t vel2Y, float32x4_t r, float32x4_t r2,
+                                  float32x4_t range, uint32x4_t valid)
+{
+    const float32x4_t dx = vsubq_f32(pos2X, px);
+    const float32x4_t dy = vsubq_f32(pos2Y, py);
+    const float32x4_t d2 = vfmaq_f32(vmulq_f32(dy, dy), dx, dx);
+    const float32x4_t radii = vaddq_f32(r, r2);
+
+    // Fast mode tests the squared distance against (range + radii)^2, skipping the sqrt too.
+    float32x4_t len;
+    uint32x4_t in;
+    if constexpr (Fast)
+    {
+        const float32x4_t reach = vaddq_f32(range, radii);
+        in = vandq_u32(vcltq_f32(d2, vmulq_f32(reach, reach)), valid);
+    }
+    else
+    {
+        len = vsqrtq_f32(d2);
+        in = vandq_u32(vcltq_f32(vsubq_f32(len, radii), range), valid);
+    }
+
+    // Most candidates fall outside the visual range; skip the divide and exp2 when all lanes do.
+    if (vmaxvq_u32(in) == 0)
+    {
+        return;
+    }
+
+    float32x4_t inv;
+    if constexpr (Fast)
+    {
+        // Lanes outside the range would drive exp2 to denormals; zeroing their exponent keeps
+        // every lane normal.
+        const float32x4_t rs = rsqrtNeon(d2);
+        inv = vmulq_f32(rs, fastExp2Neon(maskNeon(in, vfmsq_f32(radii, d2, rs))));
+    }
+    else
+    {
+        const float32x4_t dist = vsubq_f32(len, radii);
+        inv = vdivq_f32(vdupq_n_f32(1.f), vmulq_f32(len, exp2Neon(dist)));
+    }
+
+    sums.sepX = vsubq_f32(sums.sepX, maskNeon(in, vmulq_f32(dx, inv)));
+    sums.sepY = vsubq_f32(sums.sepY, maskNeon(in, vmulq_f32(dy, inv)));
+    sums.velX = vaddq_f32(sums.velX, maskNeon(in, vel2X));
+    sums.velY = vaddq_f32(sums.velY, maskNeon(in, vel2Y));
+    sums.posX = vaddq_f32(sums.posX, maskNeon(in, pos2X));
+    sums.posY = vaddq_f32(sums.posY, maskNeon(in, pos2Y));
+    sums.count = vsubq_u32(sums.count, in); // A set lane is all ones, i.e. -1.
+}
+
+static inline void flushNeon(const NeonSums &sums, Neighbourhood &nb)
+{
+    nb.sepX += vaddvq_f32(sums.sepX);
+    nb.sepY += vaddvq_f32(sums.sepY);
+    nb.velX += vaddvq_f32(sums.velX);
+    nb.velY += vaddvq_f32(sums.velY);
+    nb.posX += vaddvq_f32(sums.posX);
+    nb.posY += vaddvq_f32(sums.posY);
+    nb.count += static_cast<int>(vaddvq_u32(sums.count));
+}
+
+template <bool Fast>
+static void neonRange(const KernelInput &in, uint32_t i, uint32_t begin, uint32_t end,
+                      Neighbourhood &nb)
+{
+    const float32x4_t px = vdupq_n_f32(in.posX[i]);
+    const float32x4_t py = vdupq_n_f32(in.posY[i]);
+    const float32x4_t r = vdupq_n_f32(in.radius[i]);
+    const float32x4_t range = vdupq_n_f32(in.visualRange);
+    const uint32x4_t self = vdupq_n_u32(i);
+    const uint32_t laneInit[4] = {0, 1, 2, 3};
+    const uint32x4_t lanes = vld1q_u32(laneInit);
+
+    NeonSums sums;
+    uint32_t j = begin;
+    for (; j + 4 <= end; j += 4)
+    {
+        const uint32x4_t idx = vaddq_u32(vdupq_n_u32(j), lanes);
+        accumulateNeon<Fast>(sums, px, py, vld1q_f32(in.posX + j), vld1q_f32(in.posY + j),
+                             vld1q_f32(in.velX + j), vld1q_f32(in.velY + j), r,
+                             vld1q_f32(in.radius + j), range, vmvnq_u32(vceqq_u32(idx, self)));
+    }
+    flushNeon(sums, nb);
+
+    for (; j < end; j++)
+    {
+        accumulateScalar<Fast>(in, i, j, nb);
+    }
+}
+
+template <bool Fast>
+static void neonIndexed(const KernelInput &in, uint32_t i, const uint32_t *indices, size_t count,
+                        Neighbourhood &nb)
+{
+    const float32x4_t px = vdupq_n_f32(in.posX[i]);
+    const float32x4_t py = vdupq_n_f32(in.posY[i]);
+    const float32x4_t r = vdupq_n_f32(in.radius[i]);
+    const float32x4_t range = vdupq_n_f32(in.visualRange);
+    const uint32x4_t self = vdupq_n_u32(i);
+
+    // NEON has no gather, so lanes are filled one load at a time.
+    auto gather = [&](const float *base, size_t k)
+    {
+        float32x4_t v = vdupq_n_f32(base[indices[k]]);
+        v = vsetq_lane_f32(base[indices[k + 1]], v, 1);
+        v = vsetq_lane_f32(base[indices[k + 2]], v, 2);
+        return vsetq_lane_f32(base[indices[k + 3]], v, 3);
+    };
+
+    NeonSums sums;
+    size_t k = 0;
+    for (; k + 4 <= count; k += 4)
+    {
+        const uint32x4_t idx = vld1q_u32(indices + k);
+        accumulateNeon<Fast>(sums, px, py, gather(in.posX, k), gather(in.posY, k),
+                             gather(in.velX, k), gather(in.velY, k), r, gather(in.radius, k),
+                             range, vmvnq_u32(vceqq_u32(idx, self)));
+    }
+    flushNeon(sums, nb);
+
+    for (; k < count; k++)
+    {
+        accumulateScalar<Fast>(in, i, indices[k], nb);
+    }
+}
+
+// The compact layout runs through the scalar kernel on NEON for now.
+static constexpr NeighbourKernel NEON_KERNEL{"neon", neonRange<false>, neonIndexed<false>,
+                                             scalarCompactRange<false>,
+                                             scalarCompactIndexed<false>};
+static constexpr NeighbourKernel NEON_FAST_KERNEL{"neon", neonRange<true>, neonIndexed<true>,
+                                                  scalarCompactRange<true>,
+                                                  scalarCompactIndexed<true>};
+#endif
+
+bool isaSupported(Isa isa)
+{
+    switch (isa)
+    {
+    case Isa::Scalar:
+        return true;
+    case Isa::Avx2:
+#ifdef FLOCK_HAVE_AVX2
+        return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") &&
+               __builtin_cpu_supports("f16c");
+#else
+        return false;
+#endif
+    case Isa::Neon:
+#ifdef FLOCK_HAVE_NEON
+        return true; // Mandatory on AArch64.
+#else
+        return false;
+#endif
+    }
+    return false;
+}
+
+Isa bestIsa()
+{
+    for (Isa isa : {Isa::Avx2, Isa::Neon})
+    {
+        if (isaSupported(isa))
+        {
+            return isa;
+        }
+    }
+    return Isa::Scalar;
+}
+
+const NeighbourKernel &kernelFor(Isa isa, MathMode math)
+{
+    const bool fast = math == MathMode::Fast;
+    if (isaSupported(isa))
+    {
+#ifdef FLOCK_HAVE_AVX2
+        if (isa == Isa::Avx2)
+        {
+            return fast ? AVX2_FAST_KERNEL : AVX2_KERNEL;
+        }
+#endif
+#ifdef FLOCK_HAVE_NEON
+        if (isa == Isa::Neon)
+        {
+            return fast ? NEON_FAST_KERNEL : NEON_KERNEL;
+        }
+#endif
+    }
+    return fast ? SCALAR_FAST_KERNEL : SCALAR_KERNEL;
+}
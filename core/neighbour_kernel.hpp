@@ -0,0 +1,117 @@
+#pragma once
+
+#include "core/vec2.hpp"
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Read-only view of the arrays a neighbour kernel works on.
+ */
+struct KernelInput
+{
+    const float *posX;
+    const float *posY;
+    const float *velX;
+    const float *velY;
+    const float *radius;
+    float visualRange;
+};
+
+/**
+ * Read-only view of a CompactState. Positions are offsets into the grid cell of each boid, which
+ * the caller passes with every run of candidates.
+ */
+struct CompactInput
+{
+    const uint32_t *pos;   // Offset in the boid's cell, x in the low and y in the high 16 bits.
+    const uint32_t *vel;   // Velocity as halves, x in the low and y in the high 16 bits.
+    const uint8_t *radius; // Index into palette, padded so 8 bytes are readable from any boid.
+    const float *palette;  // 256 radii. Index 255 is NaN, which no pair passes the range test of.
+    bool smallPalette;     // At most 7 radii and index 7 NaN too, so 3 bits of an index suffice.
+    float scale;           // Pixels per unit of a position offset.
+    float visualRange;
+};
+
+/**
+ * Boid whose neighbourhood a compact kernel accumulates, at full precision, and the lower corner
+ * of the grid cell the candidates are in.
+ */
+struct CompactQuery
+{
+    uint32_t self; // Slot of the boid, skipped among the candidates.
+    Vec2 pos;
+    float radius;
+    Vec2 cellMin;
+};
+
+/**
+ * Sums gathered over the neighbourhood of one boid.
+ */
+struct Neighbourhood
+{
+    float sepX = 0.f;
+    float sepY = 0.f;
+    float velX = 0.f;
+    float velY = 0.f;
+    float posX = 0.f;
+    float posY = 0.f;
+    int count = 0;
+};
+
+/**
+ * Accumulates the separation, alignment and cohesion sums of boid i over a set of candidate
+ * neighbours. Candidates are either a contiguous range of boids or a list of boid indices; boid i
+ * itself is skipped in both.
+ */
+struct NeighbourKernel
+{
+    const char *name;
+    void (*range)(const KernelInput &in, uint32_t i, uint32_t begin, uint32_t end,
+                  Neighbourhood &nb);
+    void (*indexed)(const KernelInput &in, uint32_t i, const uint32_t *indices, size_t count,
+                    Neighbourhood &nb);
+
+    // The same over the compact layout, for candidates that all lie in the cell of the query.
+    void (*compactRange)(const CompactInput &in, const CompactQuery &q, uint32_t begin,
+                         uint32_t end, Neighbourhood &nb);
+    void (*compactIndexed)(const CompactInput &in, const CompactQuery &q,
+                           const uint32_t *indices, size_t count, Neighbourhood &nb);
+};
+
+/**
+ * Instruction set a neighbour kernel is written for.
+ */
+enum class Isa
+{
+    Scalar,
+    Avx2,
+    Neon,
+};
+
+/**
+ * Accuracy of the per-pair arithmetic.
+ */
+enum class MathMode
+{
+    Exact, // sqrt, divide and a near-exact exp2. Reference.
+    Fast,  // Squared-distance rejection, rsqrt and a short exp2. Bounds in fast_math.hpp.
+};
+
+/**
+ * @brief	Checks whether the kernel for an instruction set is compiled in and runs on this CPU.
+ * @param	isa	        Instruction set.
+ */
+bool isaSupported(Isa isa);
+
+/**
+ * @brief	Widest instruction set supported by this CPU.
+ */
+Isa bestIsa();
+
+/**
+ * @brief	Kernel for an instruction set, or the scalar kernel if it is unsupported.
+ * @param	isa	        Instruction set.
+ * @param	math	    Accuracy of the per-pair arithmetic.
+ */
+const NeighbourKernel &kernelFor(Isa isa, MathMode math = MathMode::Exact);
@@ -0,0 +1,187 @@
+#include "core/profiler.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <thread>
+
+Profiler &Profiler::get()
+{
+    static Profiler profiler;
+    return profiler;
+}
+
+int64_t Profiler::now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+const char *Profiler::name(Phase phase)
+{
+    switch (phase)
+    {
+    case Phase::Events:
+        return "events";
+    case Phase::Tick:
+        return "tick";
+    case Phase::Update:
+        return "update";
+    case Phase::Search:
+        return "search";
+    case Phase::Integrate:
+        return "integrate";
+    case Phase::Draw:
+        return "draw";
+    case Phase::Display:
+        return "display";
+    default:
+        return "?";
+    }
+}
+
+/**
+ * @brief	Small id of the calling thread, in order of first use.
+ */
+static uint32_t threadIndex()
+{
+    static std::atomic<uint32_t> count{0};
+    thread_local const uint32_t index = count.fetch_add(1, std::memory_order_relaxed);
+    return index;
+}
+
+void Profiler::record(Phase phase, int64_t start, int64_t duration)
+{
+    Window &window = mWindows[static_cast<size_t>(phase)];
+    const uint64_t slot = window.next.fetch_add(1, std::memory_order_relaxed);
+    window.us[slot % WINDOW].store(duration * 1e-3f, std::memory_order_relaxed);
+
+    if (!mTracing.load(std::memory_order_relaxed))
+    {
+        return;
+    }
+    // Paired with the seq_cst store in startTrace()/stopTrace(): either they see this writer, or
+    // it sees tracing is off.
+    mTraceWriters.fetch_add(1);
+    if (mTracing.load())
+    {
+        const size_t index = mTraceNext.fetch_add(1, std::memory_order_relaxed);
+        if (index < mTrace.size())
+        {
+            mTrace[index] = {phase, threadIndex(), start, duration};
+        }
+    }
+    mTraceWriters.fetch_sub(1, std::memory_order_release);
+}
+
+size_t Profiler::copyWindow(Phase phase, float *out) const
+{
+    const Window &window = mWindows[static_cast<size_t>(phase)];
+    const size_t count = std::min<uint64_t>(window.next.load(std::memory_order_relaxed), WINDOW);
+    for (size_t i = 0; i < count; i++)
+    {
+        out[i] = window.us[i].load(std::memory_order_relaxed);
+    }
+    return count;
+}
+
+PhaseSummary Profiler::summary(Phase phase) const
+{
+    std::array<float, WINDOW> us;
+    PhaseSummary s;
+    s.samples = copyWindow(phase, us.data());
+    if (s.samples == 0)
+    {
+        return s;
+    }
+
+    float *begin = us.data();
+    float *end = begin + s.samples;
+    float sum = 0.f;
+    for (const float *v = begin; v != end; v++)
+    {
+        sum += *v;
+    }
+    s.mean = sum / s.samples;
+
+    std::nth_element(begin, begin + s.samples / 2, end);
+    s.p50 = begin[s.samples / 2];
+    const size_t p95 = std::min(s.samples - 1, s.samples * 95 / 100);
+    std::nth_element(begin, begin + p95, end);
+    s.p95 = begin[p95];
+    s.max = *std::max_element(begin, end);
+    return s;
+}
+
+float Profiler::recentMean(Phase phase, size_t count) const
+{
+    const Window &window = mWindows[static_cast<size_t>(phase)];
+    const uint64_t next = window.next.load(std::memory_order_relaxed);
+    count = std::min<uint64_t>({count, next, WINDOW});
+    float sum = 0.f;
+    for (uint64_t slot = next - count; slot < next; slot++)
+    {
+        sum += window.us[slot % WINDOW].load(std::memory_order_relaxed);
+    }
+    return count ? sum / count : 0.f;
+}
+
+void Profiler::histogram(Phase phase, uint32_t *bins, size_t binCount, float minUs,
+                         float decades) const
+{
+    std::array<float, WINDOW> us;
+    const size_t count = copyWindow(phase, us.data());
+    std::fill(bins, bins + binCount, 0u);
+
+    const float perDecade = binCount / decades;
+    for (size_t i = 0; i < count; i++)
+    {
+        const float b = std::floor(std::log10(std::max(us[i], minUs) / minUs) * perDecade);
+        bins[static_cast<size_t>(std::min(b, binCount - 1.f))]++;
+    }
+}
+
+void Profiler::startTrace()
+{
+    mTracing.store(false);
+    while (mTraceWriters.load(std::memory_order_acquire) != 0)
+    {
+        std::this_thread::yield();
+    }
+    mTrace.resize(TRACE_CAPACITY);
+    mTraceNext.store(0);
+    mTraceStart = now();
+    mTracing.store(true, std::memory_order_release);
+}
+
+bool Profiler::stopTrace(const std::string &path)
+{
+    mTracing.store(false);
+    while (mTraceWriters.load(std::memory_order_acquire) != 0)
+    {
+        std::this_thread::yield();
+    }
+
+    std::FILE *file = std::fopen(path.c_str(), "w");
+    if (!file)
+    {
+        return false;
+    }
+
+    // Complete ("X") events with microsecond timestamps relative to the start of the trace.
+    const size_t count = std::min(mTraceNext.load(), mTrace.size());
+    std::fprintf(file, "{\"traceEvents\": [\n");
+    for (size_t i = 0; i < count; i++)
+    {
+        const TraceEvent &e = mTrace[i];
+        std::fprintf(file,
+                     "  {\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %u, "
+                     "\"ts\": %.3f, \"dur\": %.3f}%s\n",
+                     name(e.phase), e.thread, (e.start - mTraceStart) * 1e-3,
+                     e.duration * 1e-3, i + 1 < count ? "," : "");
+    }
+    std::fprintf(file, "],\n\"displayTimeUnit\": \"ms\"}\n");
+    return std::fclose(file) == 0;
+}
@@ -0,0 +1,153 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * Timed phases of a frame and of a simulation tick.
+ */
+enum class Phase
+{
+    Events,    // FlockingApp::handleEvents().
+    Tick,      // World::update(), every flock of one tick.
+    Update,    // Flock::update(), one flock's part of a tick.
+    Search,    // Grid and Verlet list builds, reordering.
+    Integrate, // Neighbour kernel and flocking rules over every boid.
+    Draw,      // Building and submitting the flock's vertices.
+    Display,   // sf::Window::display(), including any vsync or frame limit wait.
+    Count,
+};
+
+/**
+ * Statistics of the rolling window of one phase, in microseconds.
+ */
+struct PhaseSummary
+{
+    float mean = 0.f;
+    float p50 = 0.f;
+    float p95 = 0.f;
+    float max = 0.f;
+    size_t samples = 0;
+};
+
+/**
+ * Collects phase durations from any thread. Each phase keeps its last WINDOW durations for live
+ * statistics; while a trace is running, every scope is also logged for a Chrome trace-event dump
+ * (chrome://tracing, Perfetto).
+ */
+class Profiler
+{
+public:
+    static constexpr size_t WINDOW = 256;
+    static constexpr size_t TRACE_CAPACITY = size_t{1} << 18; // Events kept per trace.
+
+    static Profiler &get();
+
+    /**
+     * @brief	Nanoseconds on a monotonic clock.
+     */
+    static int64_t now();
+
+    static const char *name(Phase phase);
+
+    /**
+     * @brief	Adds one duration to a phase. Thread-safe and lock-free.
+     * @param	phase	    Phase that ran.
+     * @param	start	    now() when it started.
+     * @param	duration	Nanoseconds it took.
+     */
+    void record(Phase phase, int64_t start, int64_t duration);
+
+    PhaseSummary summary(Phase phase) const;
+
+    /**
+     * @brief	Mean of the last few durations of a phase, for decisions that can't wait for the
+     *          window to turn over.
+     * @param	phase	    Phase to average.
+     * @param	count	    Durations to average, at most WINDOW.
+     * @return	Microseconds, 0 if the phase has no samples.
+     */
+    float recentMean(Phase phase, size_t count) const;
+
+    /**
+     * @brief	Counts the window of a phase into logarithmic bins, bin b covering durations from
+     *          minUs * 10^(b * decades / binCount) microseconds up. The ends catch everything
+     *          outside.
+     * @param	phase	    Phase to count.
+     * @param	bins	    Receives binCount counts.
+     * @param	binCount	Number of bins.
+     * @param	minUs	    Lower edge of the first bin.
+     * @param	decades	    Powers of ten the bins span.
+     */
+    void histogram(Phase phase, uint32_t *bins, size_t binCount, float minUs,
+                   float decades) const;
+
+    /**
+     * @brief	Starts logging every scope, discarding any previous trace.
+     */
+    void startTrace();
+
+    /**
+     * @brief	Stops logging and writes the trace as Chrome trace-event JSON.
+     * @param	path	    File to write.
+     * @return	false if the file could not be written.
+     */
+    bool stopTrace(const std::string &path);
+    bool tracing() const { return mTracing.load(std::memory_order_relaxed); }
+
+private:
+    struct Window
+    {
+        std::array<std::atomic<float>, WINDOW> us{};
+        std::atomic<uint64_t> next{0};
+    };
+
+    struct TraceEvent
+    {
+        Phase phase;
+        uint32_t thread;
+        int64_t start;
+        int64_t duration;
+    };
+
+    std::array<Window, static_cast<size_t>(Phase::Count)> mWindows;
+
+    std::vector<TraceEvent> mTrace;
+    std::atomic<size_t> mTraceNext{0};
+    std::atomic<bool> mTracing{false};
+    std::atomic<int> mTraceWriters{0}; // Threads between checking mTracing and writing.
+    int64_t mTraceStart = 0;
+
+    size_t copyWindow(Phase phase, float *out) const;
+};
+
+/**
+ * Records the lifetime of the scope as one sample of a phase.
+ */
+class ProfileScope
+{
+public:
+    explicit ProfileScope(Phase phase) : mPhase(phase), mStart(Profiler::now()) {}
+    ~ProfileScope() { Profiler::get().record(mPhase, mStart, Profiler::now() - mStart); }
+
+    ProfileScope(const ProfileScope &) = delete;
+    ProfileScope &operator=(const ProfileScope &) = delete;
+
+private:
+    Phase mPhase;
+    int64_t mStart;
+};
+
+// Times the rest of the enclosing scope. Expands to nothing unless FLOCK_ENABLE_PROFILING is set.
+#ifdef FLOCK_ENABLE_PROFILING
+#define FLOCK_PROFILE_CONCAT_(a, b) a##b
+#define FLOCK_PROFILE_CONCAT(a, b) FLOCK_PROFILE_CONCAT_(a, b)
+#define FLOCK_PROFILE_SCOPE(phase)                                                                 \
+    const ProfileScope FLOCK_PROFILE_CONCAT(flockProfileScope, __LINE__)(phase)
+#else
+#define FLOCK_PROFILE_SCOPE(phase) ((void)0)
+#endif
@@ -0,0 +1,174 @@
+#include "core/quadtree.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+void QuadTree::build(const FlockState &state)
+{
+    mNodes.clear();
+    mOrder.clear();
+
+    // A NaN boid would poison the sums of every node above it.
+    float minX = INFINITY, minY = INFINITY;
+    float maxX = -INFINITY, maxY = -INFINITY;
+    for (uint32_t i = 0; i < state.size(); i++)
+    {
+        const float x = state.posX[i];
+        const float y = state.posY[i];
+        if (std::isfinite(x) && std::isfinite(y))
+        {
+            mOrder.push_back(i);
+            minX = std::min(minX, x);
+            minY = std::min(minY, y);
+            maxX = std::max(maxX, x);
+            maxY = std::max(maxY, y);
+        }
+    }
+
+    const uint32_t n = static_cast<uint32_t>(mOrder.size());
+    if (n > 0)
+    {
+        // A hair wider than the bounds, so the largest coordinate falls inside the square.
+        const float edge = std::max({maxX - minX, maxY - minY, 1.f}) * 1.0001f;
+        buildNode(state, 0, n, minX, minY, edge, 0);
+    }
+
+    mX.resize(n);
+    mY.resize(n);
+    mVelX.resize(n);
+    mVelY.resize(n);
+    for (uint32_t k = 0; k < n; k++)
+    {
+        const uint32_t i = mOrder[k];
+        mX[k] = state.posX[i];
+        mY[k] = state.posY[i];
+        mVelX[k] = state.velX[i];
+        mVelY[k] = state.velY[i];
+    }
+}
+
+void QuadTree::buildNode(const FlockState &state, uint32_t begin, uint32_t end, float minX,
+                         float minY, float edge, int depth)
+{
+    // Children are appended after the node, so it is addressed by index, not reference.
+    const size_t index = mNodes.size();
+    mNodes.push_back({minX, minY, edge, 0.f, 0.f, 0.f, 0.f, end - begin, begin, 0, true});
+
+    double sumX = 0.0, sumY = 0.0, sumVelX = 0.0, sumVelY = 0.0;
+    if (end - begin <= LEAF_SIZE || depth >= MAX_DEPTH)
+    {
+        for (uint32_t k = begin; k < end; k++)
+        {
+            const uint32_t i = mOrder[k];
+            sumX += state.posX[i];
+            sumY += state.posY[i];
+            sumVelX += state.velX[i];
+            sumVelY += state.velY[i];
+        }
+    }
+    else
+    {
+        mNodes[index].leaf = false;
+        const float half = 0.5f * edge;
+        const float midX = minX + half;
+        const float midY = minY + half;
+        uint32_t *first = mOrder.data() + begin;
+        uint32_t *last = mOrder.data() + end;
+        auto below = [&](const float *axis, float mid)
+        { return [axis, mid](uint32_t i) { return axis[i] < mid; }; };
+
+        // Quadrants in the order left-bottom, left-top, right-bottom, right-top.
+        uint32_t *right = std::partition(first, last, below(state.posX.data(), midX));
+        uint32_t *leftTop = std::partition(first, right, below(state.posY.data(), midY));
+        uint32_t *rightTop = std::partition(right, last, below(state.posY.data(), midY));
+        const uint32_t *bounds[5] = {first, leftTop, right, rightTop, last};
+        for (int q = 0; q < 4; q++)
+        {
+            const uint32_t childBegin = static_cast<uint32_t>(bounds[q] - mOrder.data());
+            const uint32_t childEnd = static_cast<uint32_t>(bounds[q + 1] - mOrder.data());
+            if (childBegin == childEnd)
+            {
+                continue;
+            }
+
+            const size_t child = mNodes.size();
+            buildNode(state, childBegin, childEnd, q < 2 ? minX : midX, q % 2 ? midY : minY,
+                      half, depth + 1);
+            const Node &c = mNodes[child];
+            sumX += static_cast<double>(c.comX) * c.count;
+            sumY += static_cast<double>(c.comY) * c.count;
+            sumVelX += static_cast<double>(c.velX) * c.count;
+            sumVelY += static_cast<double>(c.velY) * c.count;
+        }
+    }
+
+    Node &node = mNodes[index];
+    const double count = node.count;
+    node.comX = static_cast<float>(sumX / count);
+    node.comY = static_cast<float>(sumY / count);
+    node.velX = static_cast<float>(sumVelX / count);
+    node.velY = static_cast<float>(sumVelY / count);
+    node.next = static_cast<uint32_t>(mNodes.size());
+}
+
+FarField QuadTree::farField(Vec2 pos, float theta, float near) const
+{
+    FarField field;
+    const float near2 = near * near;
+    const float theta2 = theta * theta;
+
+    for (size_t k = 0; k < mNodes.size();)
+    {
+        const Node &node = mNodes[k];
+        const float maxX = node.minX + node.edge;
+        const float maxY = node.minY + node.edge;
+
+        // Nearest and farthest point of the square from pos.
+        const float nearX = std::max({node.minX - pos.x, pos.x - maxX, 0.f});
+        const float nearY = std::max({node.minY - pos.y, pos.y - maxY, 0.f});
+        const float farX = std::max(pos.x - node.minX, maxX - pos.x);
+        const float farY = std::max(pos.y - node.minY, maxY - pos.y);
+        if (farX * farX + farY * farY < near2)
+        {
+            // Every boid below is left to the neighbour search.
+            k = node.next;
+            continue;
+        }
+
+        const float dx = node.comX - pos.x;
+        const float dy = node.comY - pos.y;
+        const float d2 = dx * dx + dy * dy;
+        if (nearX * nearX + nearY * nearY >= near2 && node.edge * node.edge < theta2 * d2)
+        {
+            const float w = node.count / d2;
+            field.pull += Vec2{dx, dy} * w;
+            field.velocity += Vec2{node.velX, node.velY} * w;
+            field.weight += w;
+            field.terms++;
+            k = node.next;
+            continue;
+        }
+
+        if (!node.leaf)
+        {
+            k++;
+            continue;
+        }
+        for (uint32_t j = node.begin; j < node.begin + node.count; j++)
+        {
+            const float bx = mX[j] - pos.x;
+            const float by = mY[j] - pos.y;
+            const float b2 = bx * bx + by * by;
+            if (b2 >= near2)
+            {
+                const float w = 1.f / b2;
+                field.pull += Vec2{bx, by} * w;
+                field.velocity += Vec2{mVelX[j], mVelY[j]} * w;
+                field.weight += w;
+                field.terms++;
+            }
+        }
+        k = node.next;
+    }
+    return field;
+}
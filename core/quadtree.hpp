@@ -0,0 +1,81 @@
+#pragma once
+
+#include "core/flock_state.hpp"
+#include "core/vec2.hpp"
+
+#include <cstdint>
+#include <vector>
+
+/**
+ * Sums of the far field of one boid, see QuadTree::farField().
+ */
+struct FarField
+{
+    Vec2 pull;          // Sum over far boids of (p_j - p) / |p_j - p|^2.
+    Vec2 velocity;      // Sum over far boids of v_j / |p_j - p|^2.
+    float weight = 0.f; // Sum over far boids of 1 / |p_j - p|^2.
+    uint32_t terms = 0; // Nodes and single boids added, the cost of the query.
+};
+
+/**
+ * Barnes-Hut quadtree over the positions of a flock. Every node keeps the number, centre of mass
+ * and mean velocity of the boids below it, so a query can stand in a whole distant node for its
+ * boids instead of visiting each, which makes the far field of every boid O(N log N) in total
+ * instead of O(N^2).
+ *
+ * Nodes are stored depth first with the index of the node after each subtree, so a query walks
+ * the array front to back without a stack. Storage is reused between builds.
+ */
+class QuadTree
+{
+public:
+    // Boids per leaf below which a node is not split.
+    static constexpr uint32_t LEAF_SIZE = 8;
+    // Depth past which a node is not split, so coincident boids can't recurse forever.
+    static constexpr int MAX_DEPTH = 24;
+
+    /**
+     * @brief	Rebuilds the tree over the current positions and velocities. Boids with a
+     *          non-finite position are left out.
+     * @param	state	    Flock to index. Not referenced after the call.
+     */
+    void build(const FlockState &state);
+
+    /**
+     * @brief	Sums the far field at pos over every indexed boid whose centre is at least near
+     *          away. A node is taken as a whole once its edge over its distance drops below
+     *          theta and it holds no boid nearer than near; theta = 0 visits every boid.
+     * @param	pos	        Query position.
+     * @param	theta	    Opening angle.
+     * @param	near	    Distance below which boids are left to the neighbour search. Positive.
+     */
+    FarField farField(Vec2 pos, float theta, float near) const;
+
+    size_t size() const { return mX.size(); }
+
+private:
+    struct Node
+    {
+        float minX, minY; // Lower corner of the square.
+        float edge;       // Edge length of the square.
+        float comX, comY; // Centre of mass.
+        float velX, velY; // Mean velocity.
+        uint32_t count;   // Boids below the node, mX[begin, begin + count).
+        uint32_t begin;
+        uint32_t next;    // Index of the node after this subtree.
+        bool leaf;
+    };
+
+    std::vector<Node> mNodes;
+    std::vector<uint32_t> mOrder; // Slots of the indexed boids, grouped by leaf.
+    std::vector<float> mX;        // Positions and velocities in mOrder order.
+    std::vector<float> mY;
+    std::vector<float> mVelX;
+    std::vector<float> mVelY;
+
+    /**
+     * @brief	Adds the node over mOrder[begin, end) and its subtree.
+     */
+    void buildNode(const FlockState &state, uint32_t begin, uint32_t end, float minX, float minY,
+                   float edge, int depth);
+};
@@ -0,0 +1,51 @@
+#include "core/quality_governor.hpp"
+
+#include <algorithm>
+
+// Longest wait before stepping up, in multiples of holdFrames.
+static constexpr unsigned int MAX_HOLD_FACTOR = 64;
+
+bool QualityGovernor::update(float simMs, float renderMs)
+{
+    const float cost = std::max(simMs, renderMs);
+    mCostMs = mPrimed ? mCostMs + mSettings.smoothing * (cost - mCostMs) : cost;
+    mPrimed = true;
+    mHeld++;
+    if (!mEnabled)
+    {
+        return false;
+    }
+
+    const unsigned int hold = std::max(mSettings.holdFrames, 1u);
+    const bool over = mCostMs > mSettings.budgetMs;
+    const bool spare = mCostMs < mSettings.budgetMs * (1.f - mSettings.hysteresis);
+    if (over && mLevel + 1 < QUALITY_LEVELS.size() && mHeld >= hold)
+    {
+        // Back over budget soon after a step up, within hold frames of the earliest step down:
+        // the level above doesn't fit, so try it less often from now on.
+        const bool bounced = mSteppedUp && mHeld < 2 * hold;
+        mLevel++;
+        unsigned int &wait = mUpHold[mLevel];
+        wait = bounced ? std::min(2 * std::max(wait, hold), MAX_HOLD_FACTOR * hold) : hold;
+        mSteppedUp = false;
+        mHeld = 0;
+        return true;
+    }
+    if (spare && mLevel > 0 && mHeld >= std::max(mUpHold[mLevel], hold))
+    {
+        mLevel--;
+        mSteppedUp = true;
+        mHeld = 0;
+        return true;
+    }
+    return false;
+}
+
+void QualityGovernor::setEnabled(bool enabled)
+{
+    mEnabled = enabled;
+    mLevel = 0;
+    mHeld = 0;
+    mSteppedUp = false;
+    mUpHold.fill(0);
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+
+/**
+ * Settings of the simulation and renderer at one quality level.
+ */
+struct QualityLevel
+{
+    unsigned int stagger;      // Flock::setStagger().
+    unsigned int neighbourCap; // Flock::setNeighbourCap(), 0 is uncapped.
+    float renderLod;           // FlockRenderer::setLodScale().
+};
+
+/**
+ * Levels from full quality down, each cheaper than the one before. Neighbour caps go first since
+ * they only matter where the flock is dense; staggering costs smoothness everywhere.
+ */
+inline constexpr std::array<QualityLevel, 7> QUALITY_LEVELS{{
+    {1, 0, 1.f},
+    {1, 64, 1.f},
+    {1, 32, 2.f},
+    {2, 32, 2.f},
+    {2, 16, 4.f},
+    {4, 16, 4.f},
+    {8, 8, 8.f},
+}};
+
+/**
+ * Tuning of QualityGovernor.
+ */
+struct GovernorSettings
+{
+    float budgetMs = 1000.f / 60.f; // Frame time to stay under.
+    float hysteresis = 0.25f;       // Fraction of the budget a level must leave spare to step up.
+    unsigned int holdFrames = 30;   // Frames a level is kept at least, for its cost to settle.
+    float smoothing = 0.1f;         // Weight of the newest frame in the running cost.
+};
+
+/**
+ * Picks a QUALITY_LEVELS entry that keeps the frame under budget, one step per decision.
+ *
+ * The cost of a frame is the slower of the simulation and the render thread, smoothed over a few
+ * frames. Over budget, the governor steps down once the current level has been held for
+ * holdFrames; with more than the hysteresis spare, it steps back up. A step up that has to be
+ * undone in the holdFrames after it first could be, less than 2 * holdFrames after it, doubles
+ * the wait before the next step up from that level, up to 64 * holdFrames. So a load right
+ * between two levels settles on the cheaper one instead of alternating.
+ */
+class QualityGovernor
+{
+public:
+    explicit QualityGovernor(const GovernorSettings &settings = {}) : mSettings(settings) {}
+
+    /**
+     * @brief	Feeds the cost of one frame.
+     * @param	simMs	    Simulation time spent on the ticks of the frame.
+     * @param	renderMs	Time the render thread spent on the frame, without waiting for display.
+     * @return	true if the level changed.
+     */
+    bool update(float simMs, float renderMs);
+
+    /**
+     * @brief	Turns the governor off, back to full quality, or on again from full quality.
+     */
+    void setEnabled(bool enabled);
+    bool enabled() const { return mEnabled; }
+
+    void setSettings(const GovernorSettings &settings) { mSettings = settings; }
+    const GovernorSettings &settings() const { return mSettings; }
+
+    size_t level() const { return mLevel; }
+    const QualityLevel &quality() const { return QUALITY_LEVELS[mLevel]; }
+
+    /**
+     * @brief	Smoothed frame cost as a fraction of the budget.
+     */
+    float load() const { return mCostMs / mSettings.budgetMs; }
+
+private:
+    GovernorSettings mSettings;
+    bool mEnabled = true;
+    size_t mLevel = 0;
+    float mCostMs = 0.f;
+    bool mPrimed = false;      // Whether mCostMs holds a measurement yet.
+    unsigned int mHeld = 0;    // Frames since the last change.
+    bool mSteppedUp = false;   // Whether the last change was a step up.
+    std::array<unsigned int, QUALITY_LEVELS.size()> mUpHold{}; // Wait before leaving each level.
+};
@@ -0,0 +1,28 @@
+#include "core/scratch_arena.hpp"
+
+void ScratchArena::reset()
+{
+    if (!mSpilled.empty())
+    {
+        mSpilled.clear();
+        Block().swap(mBlock);
+        mBlock.resize(mRequested);
+    }
+    mUsed = 0;
+    mRequested = 0;
+}
+
+void *ScratchArena::allocateBytes(size_t bytes)
+{
+    // Round up so every allocation starts on its own cache line.
+    bytes = (bytes + CACHE_LINE - 1) / CACHE_LINE * CACHE_LINE;
+    mRequested += bytes;
+
+    if (mUsed + bytes <= mBlock.size())
+    {
+        void *p = mBlock.data() + mUsed;
+        mUsed += bytes;
+        return p;
+    }
+    return mSpilled.emplace_back(bytes).data();
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "core/aligned_allocator.hpp"
+
+#include <cstddef>
+#include <type_traits>
+#include <vector>
+
+/**
+ * Monotonic allocator for scratch data that lives for one tick. Allocation bumps an offset into
+ * one retained block and reset() releases everything at once. A tick that needs more than the
+ * block spills into extra heap blocks; the following reset() replaces them with a single block
+ * large enough for that tick, so a steady workload stops touching the heap after a few ticks.
+ */
+class ScratchArena
+{
+public:
+    /**
+     * @brief	Uninitialised storage for n values, aligned to a cache line. Valid until reset().
+     * @param	n	        Number of values.
+     */
+    template <typename T> T *allocate(size_t n)
+    {
+        static_assert(std::is_trivially_destructible_v<T>, "reset() runs no destructors");
+        static_assert(alignof(T) <= CACHE_LINE, "allocations are cache-line aligned");
+        return static_cast<T *>(allocateBytes(n * sizeof(T)));
+    }
+
+    /**
+     * @brief	Releases every allocation. Grows the block if the last tick spilled.
+     */
+    void reset();
+
+    size_t capacity() const { return mBlock.size(); }
+
+private:
+    using Block = std::vector<std::byte, AlignedAllocator<std::byte>>;
+
+    Block mBlock;
+    size_t mUsed = 0;
+    size_t mRequested = 0; // Bytes asked for since the last reset, spilled or not.
+    std::vector<Block> mSpilled;
+
+    void *allocateBytes(size_t bytes);
+};
@@ -0,0 +1,104 @@
+#include "core/simulation_thread.hpp"
+
+#include <algorithm>
+
+SimulationThread::SimulationThread(World &world, ThreadPool *pool, double tickRate,
+                                   CommandHandler handler, TickHandler onTick)
+    : mWorld(world), mPool(pool), mTimestep(tickRate), mTickRate(tickRate),
+      mRequestedRate(tickRate), mHandler(std::move(handler)), mOnTick(std::move(onTick))
+{
+    publish(std::chrono::steady_clock::now());
+    mThread = std::thread([this] { loop(); });
+}
+
+SimulationThread::~SimulationThread()
+{
+    mStop.store(true, std::memory_order_relaxed);
+    mThread.join();
+}
+
+float SimulationThread::alpha(const FlockSnapshot &snapshot) const
+{
+    if (snapshot.tickSeconds <= 0.0)
+    {
+        return 0.f;
+    }
+    const std::chrono::duration<double> age = std::chrono::steady_clock::now() - snapshot.time;
+    return static_cast<float>(std::clamp(age.count() / snapshot.tickSeconds, 0.0, 1.0));
+}
+
+void SimulationThread::loop()
+{
+    using Clock = std::chrono::steady_clock;
+
+    // Longest sleep while paused, which bounds how late commands and stopping are noticed.
+    constexpr std::chrono::milliseconds PAUSE_POLL{50};
+
+    Clock::time_point last = Clock::now();
+    while (!mStop.load(std::memory_order_relaxed))
+    {
+        SimCommand command;
+        bool changed = false;
+        while (mCommands.pop(command))
+        {
+            mHandler(mWorld, command);
+            changed = true;
+        }
+
+        const double rate = mRequestedRate.load(std::memory_order_relaxed);
+        if (rate != mTickRate)
+        {
+            mTickRate = rate;
+            if (rate > 0.0)
+            {
+                mTimestep.setTickRate(rate);
+            }
+            mTimestep.reset();
+            last = Clock::now();
+        }
+        if (mTickRate <= 0.0)
+        {
+            // Show what the commands did, e.g. a reset, without ticking.
+            if (changed)
+            {
+                publish(Clock::now());
+            }
+            std::this_thread::sleep_for(PAUSE_POLL);
+            continue;
+        }
+
+        const Clock::time_point now = Clock::now();
+        const unsigned int ticks =
+            mTimestep.advance(std::chrono::duration<double>(now - last).count());
+        last = now;
+
+        for (unsigned int t = 0; t < ticks; t++)
+        {
+            mWorld.update(mPool);
+            mTick++;
+            if (mOnTick)
+            {
+                mOnTick(mWorld, mTick);
+            }
+        }
+        if (ticks > 0)
+        {
+            publish(now);
+        }
+
+        // Sleep until the next tick is due.
+        const double wait = mTimestep.tickSeconds() * (1.0 - mTimestep.alpha());
+        std::this_thread::sleep_for(std::chrono::duration<double>(wait));
+    }
+}
+
+void SimulationThread::publish(std::chrono::steady_clock::time_point now)
+{
+    // Gathering into the slot's existing arrays reuses their capacity.
+    FlockSnapshot &snapshot = mSnapshots.back();
+    mWorld.gather(snapshot.state);
+    snapshot.tick = mTick;
+    snapshot.time = now;
+    snapshot.tickSeconds = mTickRate > 0.0 ? mTimestep.tickSeconds() : 0.0;
+    mSnapshots.publish();
+}
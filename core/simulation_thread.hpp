@@ -0,0 +1,126 @@
+#pragma once
+
+#include "core/fixed_timestep.hpp"
+#include "core/flock.hpp"
+#include "core/flock_params.hpp"
+#include "core/flock_state.hpp"
+#include "core/spsc_queue.hpp"
+#include "core/thread_pool.hpp"
+#include "core/triple_buffer.hpp"
+#include "core/vec2.hpp"
+#include "core/world.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <thread>
+
+/**
+ * Request from the frontend to the simulation, applied between two ticks.
+ */
+struct SimCommand
+{
+    enum class Type
+    {
+        SetDest,            // Steer flock number value towards dest.
+        SetNeighbourSearch, // value is a NeighbourSearch.
+        SetIsa,             // value is an Isa.
+        SetMathMode,        // value is a MathMode.
+        SetLayout,          // value is a BoidLayout.
+        SetQuality,         // value indexes QUALITY_LEVELS.
+        Reset,              // Replace the flocks with new random ones.
+        SetParams,          // Replace the rule constants with params.
+        SetInteraction,     // value != 0 lets every flock see every other, 0 only itself.
+        SaveSnapshot,       // Write every flock to a snapshot file.
+    };
+
+    Type type = Type::SetDest;
+    Vec2 dest;
+    int value = 0;
+    FlockParams params;
+};
+
+/**
+ * Copy of every flock after a completed tick, gathered flock after flock, handed from the
+ * simulation to the renderer.
+ */
+struct FlockSnapshot
+{
+    FlockState state;
+    uint64_t tick = 0;
+    std::chrono::steady_clock::time_point time; // When the tick was published.
+    double tickSeconds = 1.0 / 60.0;            // Tick length it ran at, 0 if paused.
+};
+
+/**
+ * Runs a world of flocks at a fixed tick rate on its own thread. The frontend talks to it only
+ * through a lock-free command queue and reads results from a triple buffer of snapshots, so
+ * drawing one tick overlaps with simulating the next.
+ */
+class SimulationThread
+{
+public:
+    using CommandHandler = std::function<void(World &, const SimCommand &)>;
+    using TickHandler = std::function<void(const World &, uint64_t tick)>;
+
+    /**
+     * @brief	Construct a new Simulation Thread object. The thread starts immediately and owns
+     *          world and pool until destruction.
+     * @param	world	    Flocks to simulate.
+     * @param	pool	    Workers for World::update(). May be null.
+     * @param	tickRate	Simulation ticks per second.
+     * @param	handler	    Applies commands to the world, called on the simulation thread.
+     * @param	onTick	    Called on the simulation thread after every tick, e.g. to record it.
+     *                      Runs between ticks, so it must be quick. May be empty.
+     */
+    SimulationThread(World &world, ThreadPool *pool, double tickRate, CommandHandler handler,
+                     TickHandler onTick = {});
+    ~SimulationThread();
+
+    SimulationThread(const SimulationThread &) = delete;
+    SimulationThread &operator=(const SimulationThread &) = delete;
+
+    /**
+     * @brief	Queues a command for the next tick. Call from a single thread only.
+     * @return	false if the queue is full and the command was dropped.
+     */
+    bool post(const SimCommand &command) { return mCommands.push(command); }
+
+    /**
+     * @brief	Changes the tick rate, e.g. while the window is in the background. 0 pauses: commands
+     *          are still applied, but no ticks run. Time accumulated at the old rate is dropped, so
+     *          resuming continues from the current state instead of catching up on missed ticks.
+     * @param	tickRate	Simulation ticks per second.
+     */
+    void setTickRate(double tickRate) { mRequestedRate.store(tickRate, std::memory_order_relaxed); }
+
+    /**
+     * @brief	Latest published snapshot. Call from a single thread only.
+     */
+    const FlockSnapshot &latest() { return mSnapshots.front(); }
+
+    /**
+     * @brief	Fraction of a tick elapsed since a snapshot was published, in [0, 1].
+     * @param	snapshot	Snapshot returned by latest().
+     */
+    float alpha(const FlockSnapshot &snapshot) const;
+
+private:
+    World &mWorld;
+    ThreadPool *mPool;
+    FixedTimestep mTimestep;
+    double mTickRate;                   // Rate mTimestep runs at, 0 while paused.
+    std::atomic<double> mRequestedRate; // Set by setTickRate(), applied by the loop.
+    CommandHandler mHandler;
+    TickHandler mOnTick;
+    uint64_t mTick = 0;
+
+    SpscQueue<SimCommand, 256> mCommands;
+    TripleBuffer<FlockSnapshot> mSnapshots;
+    std::atomic<bool> mStop{false};
+    std::thread mThread;
+
+    void loop();
+    void publish(std::chrono::steady_clock::time_point now);
+};
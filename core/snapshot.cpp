@@ -0,0 +1,376 @@
+#include "core/snapshot.hpp"
+#include "core/aligned_allocator.hpp"
+#include "core/flock_params.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <utility>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define FLOCK_HAVE_MMAP 1
+#endif
+
+/**
+ * File layout: the header, one record per flock, then the arrays of every flock, each starting
+ * on a cache line. All fields are native byte order.
+ */
+struct SnapshotHeader
+{
+    char magic[8];     // SNAPSHOT_MAGIC.
+    uint32_t version;  // SNAPSHOT_VERSION.
+    uint32_t flocks;   // Number of SnapshotFlock records.
+    uint32_t seed;     // World seed, for flocks added after loading.
+    uint32_t reserved; // 0.
+};
+
+/**
+ * Arrays of a flock, in the order of SnapshotFlock::offsets.
+ */
+enum SnapshotArray
+{
+    POS_X,
+    POS_Y,
+    VEL_X,
+    VEL_Y,
+    RADIUS,
+    COLOR,
+    ID,
+    ARRAY_COUNT,
+};
+
+struct SnapshotFlock
+{
+    uint64_t boids;                // Length of every array.
+    uint64_t tick;                 // Flock::tick().
+    uint64_t sees;                 // Bit j is set if the flock sees flock j.
+    uint32_t seed;                 // Flock::seed().
+    float dest[2];                 // Flock::dest().
+    FlockParams params;            // Flock::params().
+    uint64_t offsets[ARRAY_COUNT]; // Byte offset of each array from the start of the file.
+};
+
+static constexpr char SNAPSHOT_MAGIC[8] = {'F', 'L', 'O', 'C', 'K', 'S', 'N', 'P'};
+
+// A layout change without a version bump would read garbage, so pin the sizes.
+static_assert(sizeof(FlockParams) == 11 * sizeof(float), "bump SNAPSHOT_VERSION");
+static_assert(sizeof(SnapshotHeader) == 24, "bump SNAPSHOT_VERSION");
+static_assert(sizeof(SnapshotFlock) == 136, "bump SNAPSHOT_VERSION");
+static_assert(sizeof(Color) == 4, "bump SNAPSHOT_VERSION");
+
+static constexpr size_t ELEMENT_SIZE[ARRAY_COUNT] = {
+    sizeof(float), sizeof(float), sizeof(float), sizeof(float),
+    sizeof(float), sizeof(Color), sizeof(uint32_t),
+};
+
+/**
+ * @brief	Start and size in bytes of each array of a state, in SnapshotArray order.
+ */
+static std::array<std::pair<const void *, size_t>, ARRAY_COUNT> arraysOf(const FlockState &s)
+{
+    const size_t n = s.size();
+    return {{{s.posX.data(), n * sizeof(float)},
+             {s.posY.data(), n * sizeof(float)},
+             {s.velX.data(), n * sizeof(float)},
+             {s.velY.data(), n * sizeof(float)},
+             {s.radius.data(), n * sizeof(float)},
+             {s.color.data(), n * sizeof(Color)},
+             {s.id.data(), n * sizeof(uint32_t)}}};
+}
+
+static uint64_t alignUp(uint64_t offset)
+{
+    return (offset + CACHE_LINE - 1) / CACHE_LINE * CACHE_LINE;
+}
+
+bool saveSnapshot(const World &world, const std::filesystem::path &path, std::string &error)
+{
+    const size_t flocks = world.flockCount();
+    SnapshotHeader header{{}, SNAPSHOT_VERSION, static_cast<uint32_t>(flocks), world.seed(), 0};
+    std::memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    std::vector<SnapshotFlock> records(flocks);
+
+    uint64_t offset = sizeof(SnapshotHeader) + flocks * sizeof(SnapshotFlock);
+    for (size_t f = 0; f < flocks; f++)
+    {
+        const Flock &flock = world.flock(f);
+        SnapshotFlock &record = records[f];
+        record.boids = flock.state().size();
+        record.tick = flock.tick();
+        for (size_t other = 0; other < flocks; other++)
+        {
+            record.sees |= uint64_t{world.interacts(f, other)} << other;
+        }
+        record.seed = flock.seed();
+        record.dest[0] = flock.dest().x;
+        record.dest[1] = flock.dest().y;
+        record.params = flock.params();
+        for (size_t a = 0; a < ARRAY_COUNT; a++)
+        {
+            offset = alignUp(offset);
+            record.offsets[a] = offset;
+            offset += record.boids * ELEMENT_SIZE[a];
+        }
+    }
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file)
+    {
+        error = "cannot open " + path.string() + " for writing";
+        return false;
+    }
+
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char *>(records.data()),
+               static_cast<std::streamsize>(records.size() * sizeof(SnapshotFlock)));
+
+    static constexpr char PADDING[CACHE_LINE] = {};
+    uint64_t written = sizeof(SnapshotHeader) + flocks * sizeof(SnapshotFlock);
+    for (size_t f = 0; f < flocks; f++)
+    {
+        const auto arrays = arraysOf(world.flock(f).state());
+        for (size_t a = 0; a < ARRAY_COUNT; a++)
+        {
+            file.write(PADDING, static_cast<std::streamsize>(records[f].offsets[a] - written));
+            file.write(static_cast<const char *>(arrays[a].first),
+                       static_cast<std::streamsize>(arrays[a].second));
+            written = records[f].offsets[a] + arrays[a].second;
+        }
+    }
+
+    if (!file.flush())
+    {
+        error = "write to " + path.string() + " failed";
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Read-only view of a whole file: memory-mapped where the platform has mmap, read into memory
+ * otherwise.
+ */
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    ~MappedFile()
+    {
+#ifdef FLOCK_HAVE_MMAP
+        if (mMapped)
+        {
+            munmap(mMapped, mSize);
+        }
+#endif
+    }
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    /**
+     * @brief	Maps a file.
+     * @param	path	    File to map.
+     * @return	false if it can't be opened or mapped.
+     */
+    bool open(const std::filesystem::path &path)
+    {
+#ifdef FLOCK_HAVE_MMAP
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+        {
+            return false;
+        }
+        struct stat info;
+        if (fstat(fd, &info) != 0)
+        {
+            ::close(fd);
+            return false;
+        }
+        mSize = static_cast<size_t>(info.st_size);
+        if (mSize > 0)
+        {
+            void *p = mmap(nullptr, mSize, PROT_READ, MAP_PRIVATE, fd, 0);
+            mMapped = p == MAP_FAILED ? nullptr : p;
+        }
+        // The mapping keeps the file alive.
+        ::close(fd);
+        if (!mMapped && mSize > 0)
+        {
+            return false;
+        }
+        if (mMapped)
+        {
+            // Every page is read once, front to back.
+            madvise(mMapped, mSize, MADV_SEQUENTIAL);
+        }
+        mData = static_cast<const std::byte *>(mMapped);
+        return true;
+#else
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+        if (!file)
+        {
+            return false;
+        }
+        mSize = static_cast<size_t>(file.tellg());
+        mBuffer.resize(mSize);
+        file.seekg(0);
+        file.read(reinterpret_cast<char *>(mBuffer.data()), static_cast<std::streamsize>(mSize));
+        mData = mBuffer.data();
+        return static_cast<bool>(file);
+#endif
+    }
+
+    const std::byte *data() const { return mData; }
+    size_t size() const { return mSize; }
+
+private:
+    const std::byte *mData = nullptr;
+    size_t mSize = 0;
+#ifdef FLOCK_HAVE_MMAP
+    void *mMapped = nullptr;
+#else
+    std::vector<std::byte> mBuffer;
+#endif
+};
+
+/**
+ * @brief	Whether every element of a float array is finite.
+ */
+template <typename Array> static bool allFinite(const Array &array)
+{
+    return std::all_of(array.begin(), array.end(), [](float v) { return std::isfinite(v); });
+}
+
+/**
+ * @brief	Copies n elements from the mapped file into an array.
+ */
+template <typename Array> static void copyArray(Array &array, const std::byte *from, size_t n)
+{
+    array.resize(n);
+    std::memcpy(array.data(), from, n * sizeof(typename Array::value_type));
+}
+
+bool loadSnapshot(const std::filesystem::path &path, World &world, std::string &error)
+{
+    MappedFile file;
+    if (!file.open(path))
+    {
+        error = "cannot open " + path.string();
+        return false;
+    }
+
+    SnapshotHeader header;
+    if (file.size() < sizeof(header))
+    {
+        error = path.string() + ": not a snapshot";
+        return false;
+    }
+    std::memcpy(&header, file.data(), sizeof(header));
+    if (std::memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0)
+    {
+        error = path.string() + ": not a snapshot";
+        return false;
+    }
+    if (header.version != SNAPSHOT_VERSION)
+    {
+        error = path.string() + ": snapshot version " + std::to_string(header.version) +
+                ", expected " + std::to_string(SNAPSHOT_VERSION);
+        return false;
+    }
+    if (header.flocks > World::MAX_FLOCKS ||
+        file.size() < sizeof(header) + header.flocks * sizeof(SnapshotFlock))
+    {
+        error = path.string() + ": truncated or corrupt header";
+        return false;
+    }
+    if (header.flocks == 0)
+    {
+        // Every user of a world assumes at least one flock, e.g. the one the mouse steers.
+        error = path.string() + ": snapshot holds no flocks";
+        return false;
+    }
+
+    // Copy everything out and check it before touching the world.
+    std::vector<SnapshotFlock> records(header.flocks);
+    std::memcpy(records.data(), file.data() + sizeof(header),
+                records.size() * sizeof(SnapshotFlock));
+    std::vector<FlockState> states(header.flocks);
+    for (size_t f = 0; f < records.size(); f++)
+    {
+        const SnapshotFlock &record = records[f];
+        const std::string where = path.string() + ": flock " + std::to_string(f) + ": ";
+        for (size_t a = 0; a < ARRAY_COUNT; a++)
+        {
+            const uint64_t offset = record.offsets[a];
+            if (record.boids > file.size() / ELEMENT_SIZE[a] || offset % CACHE_LINE != 0 ||
+                offset > file.size() || file.size() - offset < record.boids * ELEMENT_SIZE[a])
+            {
+                error = where + "array out of bounds";
+                return false;
+            }
+        }
+        if (!checkParams(record.params, error))
+        {
+            error = where + error;
+            return false;
+        }
+
+        const size_t n = record.boids;
+        const std::byte *base = file.data();
+        FlockState &state = states[f];
+        copyArray(state.posX, base + record.offsets[POS_X], n);
+        copyArray(state.posY, base + record.offsets[POS_Y], n);
+        copyArray(state.velX, base + record.offsets[VEL_X], n);
+        copyArray(state.velY, base + record.offsets[VEL_Y], n);
+        copyArray(state.radius, base + record.offsets[RADIUS], n);
+        copyArray(state.color, base + record.offsets[COLOR], n);
+        copyArray(state.id, base + record.offsets[ID], n);
+
+        // One boid at inf would turn every neighbour it reaches into NaN.
+        if (!allFinite(state.posX) || !allFinite(state.posY) || !allFinite(state.velX) ||
+            !allFinite(state.velY))
+        {
+            error = where + "non-finite position or velocity";
+            return false;
+        }
+
+        // Flock::setState() indexes by id, so they must be a permutation.
+        std::vector<bool> seen(n, false);
+        for (const uint32_t id : state.id)
+        {
+            if (id >= n || seen[id])
+            {
+                error = where + "ids are not a permutation";
+                return false;
+            }
+            seen[id] = true;
+        }
+    }
+
+    world.clear();
+    world.setSeed(header.seed);
+    for (size_t f = 0; f < records.size(); f++)
+    {
+        const SnapshotFlock &record = records[f];
+        Flock &flock = *world.addFlock();
+        flock.setState(std::move(states[f]));
+        flock.setDest({record.dest[0], record.dest[1]});
+        flock.setParams(record.params);
+        flock.setSeed(record.seed, record.tick);
+    }
+    for (size_t f = 0; f < records.size(); f++)
+    {
+        for (size_t other = 0; other < records.size(); other++)
+        {
+            world.setInteraction(f, other, records[f].sees >> other & 1);
+        }
+    }
+    return true;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "core/world.hpp"
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+
+// Bumped whenever the layout below or FlockParams changes. Older files are rejected.
+inline constexpr uint32_t SNAPSHOT_VERSION = 2;
+
+/**
+ * @brief	Writes every flock of a world to a binary snapshot: boid arrays, destination, rule
+ *          constants, noise seed and tick, plus which flocks see each other. Arrays are stored
+ *          raw in native byte order at cache-line aligned offsets, so loading is a bulk copy.
+ * @param	world	    Flocks to save.
+ * @param	path	    File to write. Replaced if it exists.
+ * @param	error	    Receives a description of the problem on failure.
+ * @return	false if the file can't be written.
+ */
+bool saveSnapshot(const World &world, const std::filesystem::path &path, std::string &error);
+
+/**
+ * @brief	Replaces the flocks of a world with those of a snapshot written by saveSnapshot().
+ *          The file is memory-mapped and its arrays are copied straight into the flocks.
+ *          Search, update scheme, kernel and reorder settings are not part of a snapshot and
+ *          start at their defaults.
+ * @param	path	    File to read.
+ * @param	world	    Receives the flocks. Left untouched on failure.
+ * @param	error	    Receives a description of the problem on failure.
+ * @return	false if the file can't be read, is not a snapshot of this version, holds no flocks or
+ *          is truncated or inconsistent.
+ */
+bool loadSnapshot(const std::filesystem::path &path, World &world, std::string &error);
@@ -0,0 +1,95 @@
+#include "core/spatial_grid.hpp"
+
+#include <limits>
+#include <numeric>
+
+void SpatialGrid::build(const FlockState &state, float cellSize, ScratchArena &scratch)
+{
+    const size_t n = state.size();
+    mSorted.resize(n);
+    if (n == 0)
+    {
+        mCols = mRows = 0;
+        mCellStart.assign(1, 0);
+        return;
+    }
+
+    // Like QuadTree::build(), the bounds skip boids that are not finite, whether left at NaN by
+    // coincident neighbours or set to inf from outside. An infinite extent would make the cell
+    // size infinite and the column count NaN. cellCoord() clamps such boids into a border cell,
+    // so order() still holds every boid.
+    constexpr float INF = std::numeric_limits<float>::infinity();
+    Vec2 lo{INF, INF};
+    Vec2 hi{-INF, -INF};
+    for (size_t i = 0; i < n; i++)
+    {
+        const float x = state.posX[i];
+        const float y = state.posY[i];
+        if (std::isfinite(x) && std::isfinite(y))
+        {
+            lo = {std::min(lo.x, x), std::min(lo.y, y)};
+            hi = {std::max(hi.x, x), std::max(hi.y, y)};
+        }
+    }
+    if (!(lo.x <= hi.x && lo.y <= hi.y))
+    {
+        lo = hi = {0.f, 0.f};
+    }
+
+    // A widely scattered flock would otherwise need far more cells than boids. Growing the cells
+    // keeps the query exact, it only admits more candidates.
+    const float maxCells = 4.f * static_cast<float>(n) + 64.f;
+    const float area = std::max(hi.x - lo.x, cellSize) * std::max(hi.y - lo.y, cellSize);
+    mCellSize = std::max(cellSize, std::sqrt(area / maxCells));
+
+    mOrigin = lo;
+    mCols = static_cast<int>((hi.x - lo.x) / mCellSize) + 1;
+    mRows = static_cast<int>((hi.y - lo.y) / mCellSize) + 1;
+    const size_t cells = static_cast<size_t>(mCols) * mRows;
+
+    // Count into the slot after each cell so the prefix sum leaves each cell's start in place.
+    // Reserving past the cap up front stops a flock that spreads out from reallocating the table.
+    // Twice the cap leaves room for rounding the column and row counts up.
+    mCellStart.reserve(std::max(cells + 1, 2 * static_cast<size_t>(maxCells)));
+    mCellStart.assign(cells + 1, 0);
+    uint32_t *cellOf = scratch.allocate<uint32_t>(n);
+    for (size_t i = 0; i < n; i++)
+    {
+        const uint32_t cell = static_cast<uint32_t>(cellIndex({state.posX[i], state.posY[i]}));
+        cellOf[i] = cell;
+        mCellStart[cell + 1]++;
+    }
+    std::partial_sum(mCellStart.begin(), mCellStart.end(), mCellStart.begin());
+
+    // Scattering advances each cell's start to its end, which is the next cell's start, so
+    // shifting the table back by one restores it. Boids go in ascending order within a cell.
+    for (uint32_t i = 0; i < n; i++)
+    {
+        mSorted[mCellStart[cellOf[i]]++] = i;
+    }
+    for (size_t c = cells; c > 0; c--)
+    {
+        mCellStart[c] = mCellStart[c - 1];
+    }
+    mCellStart[0] = 0;
+}
+
+float SpatialGrid::disorder() const
+{
+    if (mSorted.size() < 2)
+    {
+        return 0.f;
+    }
+
+    size_t breaks = 0;
+    for (size_t k = 1; k < mSorted.size(); k++)
+    {
+        breaks += mSorted[k] != mSorted[k - 1] + 1;
+    }
+    return static_cast<float>(breaks) / static_cast<float>(mSorted.size() - 1);
+}
+
+void SpatialGrid::markReordered()
+{
+    std::iota(mSorted.begin(), mSorted.end(), 0u);
+}
@@ -0,0 +1,154 @@
+#pragma once
+
+#include "core/flock_state.hpp"
+#include "core/scratch_arena.hpp"
+#include "core/vec2.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+/**
+ * Uniform grid over the bounding box of the flock. Boids are binned by position so that a
+ * neighbour query only has to visit the 3x3 block of cells around the querying boid.
+ *
+ * Binning is a counting sort: one array of boid indices in cell order plus a table of where each
+ * cell starts in it, so rebuilding never allocates once the arrays have grown.
+ */
+class SpatialGrid
+{
+public:
+    /**
+     * @brief	Rebins all boids. Cell storage is reused between calls.
+     * @param	state	    Flock to bin.
+     * @param	cellSize	Minimum edge length of a cell.
+     * @param	scratch	    Arena for the per-boid cell indices, only used during the call.
+     */
+    void build(const FlockState &state, float cellSize, ScratchArena &scratch);
+
+    /**
+     * @brief	Boid indices sorted by cell, ascending within each cell.
+     */
+    const uint32_t *order() const { return mSorted.data(); }
+
+    /**
+     * @brief	Fraction of neighbouring entries of order() that are not consecutive boid indices.
+     *          0 right after the flock has been reordered by order(), towards 1 when scattered.
+     */
+    float disorder() const;
+
+    /**
+     * @brief	Call after permuting the flock by order(). Cells are unchanged, but every cell now
+     *          holds a consecutive run of boid indices.
+     */
+    void markReordered();
+
+    /**
+     * @brief	Calls fn with the boid indices of each cell in the 3x3 block around pos.
+     * @param	pos	    Query position.
+     * @param	fn	    Callable taking (const uint32_t *indices, size_t count), or those and the
+     *                  lower corner of the cell, (..., Vec2 cellMin).
+     */
+    template <typename Fn> void forEachCandidateCell(Vec2 pos, Fn &&fn) const
+    {
+        const int cx = cellCoord(pos.x - mOrigin.x, mCols);
+        const int cy = cellCoord(pos.y - mOrigin.y, mRows);
+
+        for (int y = std::max(cy - 1, 0); y <= std::min(cy + 1, mRows - 1); y++)
+        {
+            for (int x = std::max(cx - 1, 0); x <= std::min(cx + 1, mCols - 1); x++)
+            {
+                const size_t cell = static_cast<size_t>(y) * mCols + x;
+                const uint32_t begin = mCellStart[cell];
+                const uint32_t end = mCellStart[cell + 1];
+                if (begin == end)
+                {
+                    continue;
+                }
+                if constexpr (std::is_invocable_v<Fn, const uint32_t *, size_t, Vec2>)
+                {
+                    fn(mSorted.data() + begin, end - begin,
+                       Vec2{mOrigin.x + x * mCellSize, mOrigin.y + y * mCellSize});
+                }
+                else
+                {
+                    fn(mSorted.data() + begin, end - begin);
+                }
+            }
+        }
+    }
+
+    /**
+     * @brief	Calls fn with the boid indices and lower corner of each non-empty cell overlapping
+     *          the rectangle [lo, hi]. Cells on the border of the grid extend to infinity, since
+     *          boids outside the bounds are clamped into them.
+     * @param	lo	    Lower corner of the rectangle.
+     * @param	hi	    Upper corner of the rectangle.
+     * @param	fn	    Callable taking (const uint32_t *indices, size_t count, Vec2 cellMin).
+     */
+    template <typename Fn> void forEachCellIn(Vec2 lo, Vec2 hi, Fn &&fn) const
+    {
+        if (mCols == 0 || !(lo.x <= hi.x && lo.y <= hi.y))
+        {
+            return;
+        }
+        const int x0 = cellCoord(lo.x - mOrigin.x, mCols);
+        const int x1 = cellCoord(hi.x - mOrigin.x, mCols);
+        const int y0 = cellCoord(lo.y - mOrigin.y, mRows);
+        const int y1 = cellCoord(hi.y - mOrigin.y, mRows);
+
+        for (int y = y0; y <= y1; y++)
+        {
+            for (int x = x0; x <= x1; x++)
+            {
+                const size_t cell = static_cast<size_t>(y) * mCols + x;
+                const uint32_t begin = mCellStart[cell];
+                const uint32_t end = mCellStart[cell + 1];
+                if (begin != end)
+                {
+                    fn(mSorted.data() + begin, end - begin,
+                       Vec2{mOrigin.x + x * mCellSize, mOrigin.y + y * mCellSize});
+                }
+            }
+        }
+    }
+
+    /**
+     * @brief	Lower corner of the cell a position is binned into, the same value the callbacks
+     *          above receive for it.
+     */
+    Vec2 cellMinOf(Vec2 pos) const
+    {
+        return {mOrigin.x + cellCoord(pos.x - mOrigin.x, mCols) * mCellSize,
+                mOrigin.y + cellCoord(pos.y - mOrigin.y, mRows) * mCellSize};
+    }
+
+    /**
+     * @brief	Edge length of a cell after the last build(). At least the requested size, larger
+     *          when the flock is spread too thin for that many cells.
+     */
+    float cellSize() const { return mCellSize; }
+
+private:
+    float mCellSize = 1.f;
+    Vec2 mOrigin;
+    int mCols = 0;
+    int mRows = 0;
+    std::vector<uint32_t> mCellStart; // Cell c holds mSorted[mCellStart[c], mCellStart[c + 1]).
+    std::vector<uint32_t> mSorted;
+
+    int cellCoord(float offset, int count) const
+    {
+        // Clamped as a float so NaN lands in cell 0 and huge offsets never overflow the int.
+        const float c = std::floor(offset / mCellSize);
+        return c > 0.f ? static_cast<int>(std::min(c, static_cast<float>(count - 1))) : 0;
+    }
+
+    size_t cellIndex(Vec2 pos) const
+    {
+        return static_cast<size_t>(cellCoord(pos.y - mOrigin.y, mRows)) * mCols +
+               cellCoord(pos.x - mOrigin.x, mCols);
+    }
+};
@@ -0,0 +1,187 @@
+#include "core/spawn.hpp"
+#include "core/counter_rng.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <numbers>
+
+// Counters each boid draws from: boid k uses key + CHANNELS * k + channel.
+static constexpr uint32_t CHANNELS = 8;
+static constexpr uint32_t CHANNEL_X = 0;
+static constexpr uint32_t CHANNEL_Y = 1;
+static constexpr uint32_t CHANNEL_PICK = 2; // Cluster or density cell.
+static constexpr uint32_t CHANNEL_RADIUS = 3;
+static constexpr uint32_t CHANNEL_COLOR = 4;
+
+// Keep the placement apart from the steering noise of a flock seeded with the same value.
+static constexpr uint32_t SPAWN_SALT = 0x9e3779b9u;
+static constexpr uint32_t CENTRE_SALT = 0x632be5abu;
+
+/**
+ * @brief	Uniform value in [0, 1) with 24 random bits.
+ * @param	hash	    Output of counterHash().
+ */
+static float unitValue(uint32_t hash) { return static_cast<float>(hash >> 8) * 0x1p-24f; }
+
+Spawner::Spawner(const SpawnDistribution &distribution)
+    : mDistribution(distribution), mKey(counterHash(distribution.seed ^ SPAWN_SALT))
+{
+    const Vec2 size = mDistribution.max - mDistribution.min;
+    if (mDistribution.shape == SpawnShape::Clusters)
+    {
+        const uint32_t key = counterHash(mKey ^ CENTRE_SALT);
+        mCentres.resize(mDistribution.clusters);
+        for (uint32_t c = 0; c < mCentres.size(); c++)
+        {
+            const Vec2 at{unitValue(counterHash(key + 2 * c)),
+                          unitValue(counterHash(key + 2 * c + 1))};
+            mCentres[c] = mDistribution.min + Vec2{size.x * at.x, size.y * at.y};
+        }
+        if (mCentres.empty())
+        {
+            mDistribution.shape = SpawnShape::Uniform;
+        }
+    }
+    else if (mDistribution.shape == SpawnShape::Density)
+    {
+        const DensityMap *map = mDistribution.density;
+        double total = 0.0;
+        if (map && map->weight.size() == size_t{map->width} * map->height)
+        {
+            mCdf.resize(map->weight.size());
+            for (size_t c = 0; c < mCdf.size(); c++)
+            {
+                const float w = map->weight[c];
+                total += std::isfinite(w) && w > 0.f ? w : 0.f;
+                mCdf[c] = static_cast<float>(total);
+            }
+            mWidth = map->width;
+            mHeight = map->height;
+        }
+        if (total > 0.0)
+        {
+            for (float &sum : mCdf)
+            {
+                sum = static_cast<float>(sum / total);
+            }
+        }
+        else
+        {
+            mCdf.clear();
+            mDistribution.shape = SpawnShape::Uniform;
+        }
+    }
+    mDistribution.density = nullptr;
+}
+
+float Spawner::random(uint32_t k, uint32_t channel) const
+{
+    return unitValue(counterHash(mKey + CHANNELS * k + channel));
+}
+
+Vec2 Spawner::position(uint32_t k) const
+{
+    const SpawnDistribution &d = mDistribution;
+    const Vec2 size = d.max - d.min;
+    const Vec2 u{random(k, CHANNEL_X), random(k, CHANNEL_Y)};
+    constexpr float TAU = 2.f * std::numbers::pi_v<float>;
+
+    switch (d.shape)
+    {
+    case SpawnShape::Clusters:
+    {
+        // Box-Muller, with 1 - u.x in (0, 1] so the log stays finite.
+        const auto c = static_cast<size_t>(
+            uint64_t{counterHash(mKey + CHANNELS * k + CHANNEL_PICK)} * mCentres.size() >> 32);
+        const float r = d.spread * std::sqrt(-2.f * std::log(1.f - u.x));
+        const Vec2 at = mCentres[c] + Vec2{std::cos(TAU * u.y), std::sin(TAU * u.y)} * r;
+        return {std::clamp(at.x, d.min.x, d.max.x), std::clamp(at.y, d.min.y, d.max.y)};
+    }
+    case SpawnShape::Ring:
+    {
+        // Uniform in the square of the radius, so the density is even over the area.
+        const float half = 0.5f * std::min(size.x, size.y);
+        const float inner = d.innerRadius * half;
+        const float outer = d.outerRadius * half;
+        const float r = std::sqrt(inner * inner + u.x * (outer * outer - inner * inner));
+        return (d.min + d.max) * 0.5f + Vec2{std::cos(TAU * u.y), std::sin(TAU * u.y)} * r;
+    }
+    case SpawnShape::Density:
+    {
+        const float t = random(k, CHANNEL_PICK);
+        const size_t cell = std::min<size_t>(
+            std::upper_bound(mCdf.begin(), mCdf.end(), t) - mCdf.begin(), mCdf.size() - 1);
+        const float cx = static_cast<float>(cell % mWidth) + u.x;
+        const float cy = static_cast<float>(cell / mWidth) + u.y;
+        return d.min + Vec2{size.x * cx / mWidth, size.y * cy / mHeight};
+    }
+    default:
+        return d.min + Vec2{size.x * u.x, size.y * u.y};
+    }
+}
+
+float Spawner::radius(uint32_t k) const
+{
+    const SpawnDistribution &d = mDistribution;
+    const float u = random(k, CHANNEL_RADIUS);
+    if (d.radiusSteps == 0)
+    {
+        return d.minRadius + u * (d.maxRadius - d.minRadius);
+    }
+    // u < 1, so the step index stays below radiusSteps.
+    const float step = d.radiusSteps > 1 ? (d.maxRadius - d.minRadius) / (d.radiusSteps - 1) : 0.f;
+    const auto index = static_cast<int32_t>(u * static_cast<float>(d.radiusSteps));
+    return d.minRadius + static_cast<float>(index) * step;
+}
+
+Color Spawner::color(uint32_t k) const
+{
+    const uint32_t h = counterHash(mKey + CHANNELS * k + CHANNEL_COLOR);
+    return Color(static_cast<uint8_t>(h), static_cast<uint8_t>(h >> 8),
+                 static_cast<uint8_t>(h >> 16));
+}
+
+void Spawner::fill(FlockState &state, size_t begin, size_t end, uint32_t first) const
+{
+    const auto count = static_cast<uint32_t>(end - begin);
+    float *posX = state.posX.data() + begin;
+    float *posY = state.posY.data() + begin;
+    float *radii = state.radius.data() + begin;
+    Color *colors = state.color.data() + begin;
+
+    // One array at a time, so each loop is a straight run of hashes the compiler vectorizes.
+    if (mDistribution.shape == SpawnShape::Uniform)
+    {
+        const Vec2 min = mDistribution.min;
+        const Vec2 size = mDistribution.max - mDistribution.min;
+        for (uint32_t j = 0; j < count; j++)
+        {
+            posX[j] = min.x + size.x * random(first + j, CHANNEL_X);
+        }
+        for (uint32_t j = 0; j < count; j++)
+        {
+            posY[j] = min.y + size.y * random(first + j, CHANNEL_Y);
+        }
+    }
+    else
+    {
+        for (uint32_t j = 0; j < count; j++)
+        {
+            const Vec2 pos = position(first + j);
+            posX[j] = pos.x;
+            posY[j] = pos.y;
+        }
+    }
+    for (uint32_t j = 0; j < count; j++)
+    {
+        radii[j] = radius(first + j);
+    }
+    for (uint32_t j = 0; j < count; j++)
+    {
+        colors[j] = color(first + j);
+    }
+    std::fill_n(state.velX.data() + begin, count, 0.f);
+    std::fill_n(state.velY.data() + begin, count, 0.f);
+}
+
+SpawnedBoid Spawner::boid(uint32_t k) const { return {position(k), radius(k), color(k)}; }
@@ -0,0 +1,105 @@
+#pragma once
+
+#include "core/color.hpp"
+#include "core/flock_state.hpp"
+#include "core/vec2.hpp"
+
+#include <cstdint>
+#include <vector>
+
+/**
+ * How Spawner places boids in its area.
+ */
+enum class SpawnShape
+{
+    Uniform,  // Anywhere in the area with equal probability.
+    Clusters, // Normally distributed around a few centres drawn uniformly in the area.
+    Ring,     // Uniformly over an annulus centred in the area.
+    Density,  // Proportionally to a DensityMap stretched over the area, e.g. a loaded image.
+};
+
+/**
+ * Relative density of boids over a grid of cells, row major from the top left. Negative or
+ * non-finite weights count as 0.
+ */
+struct DensityMap
+{
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::vector<float> weight;
+};
+
+/**
+ * Initial placement, size and color of spawned boids.
+ */
+struct SpawnDistribution
+{
+    SpawnShape shape = SpawnShape::Uniform;
+    Vec2 min; // Area the boids are placed in.
+    Vec2 max{1920.f, 1080.f};
+    uint32_t seed = 0;
+    float minRadius = 2.f;
+    float maxRadius = 7.f;
+    unsigned int radiusSteps = 6; // Radii are this many even steps in [min, max]. 0 is any.
+    unsigned int clusters = 6;    // Clusters: number of centres.
+    float spread = 40.f;          // Clusters: standard deviation in pixels around a centre.
+    float innerRadius = 0.6f;     // Ring: radii relative to half the shorter side of the area.
+    float outerRadius = 0.9f;
+    const DensityMap *density = nullptr; // Density: map to sample. Uniform if null or all 0.
+};
+
+/**
+ * Boid drawn by Spawner::boid().
+ */
+struct SpawnedBoid
+{
+    Vec2 pos;
+    float radius;
+    Color color;
+};
+
+/**
+ * Draws boids from a SpawnDistribution with counter-based random numbers: boid k is a function of
+ * the seed and k alone, so a flock can be filled in any order, by any number of threads, and one
+ * boid can be drawn on its own without drawing those before it. The loops over uniformly placed
+ * boids, radii and colors are plain integer hashing and vectorize.
+ */
+class Spawner
+{
+public:
+    /**
+     * @brief	Prepares the distribution: draws the cluster centres or sums up the density map.
+     * @param	distribution	Distribution to draw from. The density map is only read here.
+     */
+    explicit Spawner(const SpawnDistribution &distribution);
+
+    /**
+     * @brief	Draws boids [first, first + end - begin) into slots [begin, end) of state, at rest.
+     *          The arrays must be sized already. Writes the positions, velocities, radii and
+     *          colors of the range, not the ids.
+     * @param	state	    State to write to.
+     * @param	begin	    First slot to write.
+     * @param	end	        One past the last slot to write.
+     * @param	first	    Boid drawn into slot begin.
+     */
+    void fill(FlockState &state, size_t begin, size_t end, uint32_t first) const;
+
+    /**
+     * @brief	Draws a single boid, the same as fill() writes for it.
+     * @param	k	        Boid to draw.
+     */
+    SpawnedBoid boid(uint32_t k) const;
+
+private:
+    SpawnDistribution mDistribution;
+    uint32_t mKey;
+    std::vector<Vec2> mCentres; // Clusters.
+    std::vector<float> mCdf;    // Density: running sum of the weights, normalized to 1.
+    uint32_t mWidth = 0;        // Density: size of the map behind mCdf.
+    uint32_t mHeight = 0;
+
+    float random(uint32_t k, uint32_t channel) const;
+    Vec2 position(uint32_t k) const;
+    float radius(uint32_t k) const;
+    Color color(uint32_t k) const;
+};
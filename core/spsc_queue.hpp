@@ -0,0 +1,53 @@
+#pragma once
+
+#include "core/aligned_allocator.hpp"
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+/**
+ * Lock-free bounded queue between exactly one producer thread and one consumer thread.
+ */
+template <typename T, size_t Capacity> class SpscQueue
+{
+    static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+    /**
+     * @brief	Enqueues a value. Producer only.
+     * @return	false if the queue is full.
+     */
+    bool push(const T &value)
+    {
+        const size_t head = mHead.load(std::memory_order_relaxed);
+        if (head - mTail.load(std::memory_order_acquire) == Capacity)
+        {
+            return false;
+        }
+        mItems[head & (Capacity - 1)] = value;
+        mHead.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief	Dequeues a value. Consumer only.
+     * @return	false if the queue is empty.
+     */
+    bool pop(T &value)
+    {
+        const size_t tail = mTail.load(std::memory_order_relaxed);
+        if (tail == mHead.load(std::memory_order_acquire))
+        {
+            return false;
+        }
+        value = mItems[tail & (Capacity - 1)];
+        mTail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    std::array<T, Capacity> mItems{};
+    alignas(CACHE_LINE) std::atomic<size_t> mHead{0};
+    alignas(CACHE_LINE) std::atomic<size_t> mTail{0};
+};
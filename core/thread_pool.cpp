@@ -0,0 +1,88 @@
+#include "core/thread_pool.hpp"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(unsigned int threads)
+{
+    if (threads == 0)
+    {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    for (unsigned int i = 1; i < threads; i++)
+    {
+        mWorkers.emplace_back([this] { workerLoop(); });
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard lock(mMutex);
+        mStop = true;
+    }
+    mWake.notify_all();
+
+    for (auto &worker : mWorkers)
+    {
+        worker.join();
+    }
+}
+
+void ThreadPool::run(size_t count, size_t chunk, Task task, void *ctx)
+{
+    {
+        std::lock_guard lock(mMutex);
+        mTask = task;
+        mCtx = ctx;
+        mCount = count;
+        mChunk = chunk;
+        mNext.store(0, std::memory_order_relaxed);
+        mPending = mWorkers.size();
+        mGeneration++;
+    }
+    mWake.notify_all();
+
+    work();
+
+    std::unique_lock lock(mMutex);
+    mDone.wait(lock, [this] { return mPending == 0; });
+}
+
+void ThreadPool::work()
+{
+    for (;;)
+    {
+        const size_t begin = mNext.fetch_add(mChunk, std::memory_order_relaxed);
+        if (begin >= mCount)
+        {
+            return;
+        }
+        mTask(mCtx, begin, std::min(begin + mChunk, mCount));
+    }
+}
+
+void ThreadPool::workerLoop()
+{
+    uint64_t seen = 0;
+    for (;;)
+    {
+        {
+            std::unique_lock lock(mMutex);
+            mWake.wait(lock, [&] { return mStop || mGeneration != seen; });
+            if (mStop)
+            {
+                return;
+            }
+            seen = mGeneration;
+        }
+
+        work();
+
+        std::lock_guard lock(mMutex);
+        if (--mPending == 0)
+        {
+            mDone.notify_one();
+        }
+    }
+}
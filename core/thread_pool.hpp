@@ -0,0 +1,76 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+/**
+ * Fixed set of worker threads that split index ranges between them. The threads are created once
+ * and sleep between jobs, so dispatching a job costs a wake-up rather than a thread spawn.
+ */
+class ThreadPool
+{
+public:
+    /**
+     * @brief	Construct a new Thread Pool object.
+     * @param	threads	    Total number of threads including the caller. 0 uses one per core.
+     */
+    explicit ThreadPool(unsigned int threads = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    /**
+     * @brief	Number of threads that take part in a job, including the caller.
+     */
+    unsigned int size() const { return static_cast<unsigned int>(mWorkers.size()) + 1; }
+
+    /**
+     * @brief	Calls fn(begin, end) on consecutive chunks of [0, count) and waits for all of them.
+     *          The calling thread works on chunks too.
+     * @param	count	    Number of indices.
+     * @param	chunk	    Indices per call.
+     * @param	fn	        Callable taking (size_t begin, size_t end).
+     */
+    template <typename Fn> void parallelFor(size_t count, size_t chunk, Fn &&fn)
+    {
+        if (mWorkers.empty() || count <= chunk)
+        {
+            fn(size_t{0}, count);
+            return;
+        }
+
+        using F = std::remove_reference_t<Fn>;
+        run(count, chunk, [](void *ctx, size_t begin, size_t end)
+            { (*static_cast<F *>(ctx))(begin, end); },
+            const_cast<void *>(static_cast<const void *>(&fn)));
+    }
+
+private:
+    using Task = void (*)(void *, size_t, size_t);
+
+    std::vector<std::thread> mWorkers;
+    std::mutex mMutex;
+    std::condition_variable mWake;
+    std::condition_variable mDone;
+    bool mStop = false;
+    uint64_t mGeneration = 0;
+    size_t mPending = 0;
+
+    // Current job. Written under mMutex before mGeneration is bumped.
+    Task mTask = nullptr;
+    void *mCtx = nullptr;
+    size_t mCount = 0;
+    size_t mChunk = 0;
+    std::atomic<size_t> mNext{0};
+
+    void run(size_t count, size_t chunk, Task task, void *ctx);
+    void work();
+    void workerLoop();
+};
@@ -0,0 +1,282 @@
+#include "core/tile_domain.hpp"
+#include "core/profiler.hpp"
+
+#include <cmath>
+#include <cstring>
+
+/**
+ * @brief	Appends the bytes of a trivially copyable value to a message.
+ */
+template <typename T> static void append(Buffer &buffer, const T &value)
+{
+    const size_t at = buffer.size();
+    buffer.resize(at + sizeof(T));
+    std::memcpy(buffer.data() + at, &value, sizeof(T));
+}
+
+/**
+ * @brief	Calls fn with each WireBoid of a message.
+ * @return	false if the message is not a whole number of boids.
+ */
+template <typename Fn> static bool forEachWireBoid(const Buffer &buffer, Fn &&fn)
+{
+    if (buffer.size() % sizeof(WireBoid) != 0)
+    {
+        return false;
+    }
+    for (size_t at = 0; at < buffer.size(); at += sizeof(WireBoid))
+    {
+        WireBoid boid;
+        std::memcpy(&boid, buffer.data() + at, sizeof(WireBoid));
+        fn(boid);
+    }
+    return true;
+}
+
+TileNode::TileNode(const TileLayout &layout, size_t tile) : mLayout(layout), mTile(tile)
+{
+    const Vec2 edge{(layout.max.x - layout.min.x) / layout.cols,
+                    (layout.max.y - layout.min.y) / layout.rows};
+    const float col = static_cast<float>(tile % layout.cols);
+    const float row = static_cast<float>(tile / layout.cols);
+    mMin = {layout.min.x + col * edge.x, layout.min.y + row * edge.y};
+    mMax = {mMin.x + edge.x, mMin.y + edge.y};
+}
+
+void TileNode::addBoid(float x, float y, float radius, Color color, uint32_t globalId)
+{
+    mFlock.addBoid(x, y, radius, color);
+    mGlobalId.push_back(globalId);
+}
+
+void TileNode::addBoids(const FlockState &boids, const std::vector<uint32_t> &globalIds)
+{
+    // Flock::migrate() renumbers the ids to the slots, so the global ids go in slot order.
+    const size_t n = mFlock.state().size();
+    mKeptIds.clear();
+    for (uint32_t k = 0; k < n; k++)
+    {
+        mKeptIds.push_back(globalId(k));
+    }
+    mKeptIds.insert(mKeptIds.end(), globalIds.begin(), globalIds.end());
+    mLeaving.assign(n, 0);
+    mFlock.migrate(mLeaving, boids);
+    mGlobalId.swap(mKeptIds);
+}
+
+bool TileNode::step(Transport &transport, ThreadPool *pool, std::string &error)
+{
+    if (transport.size() != mLayout.tileCount() || transport.rank() != mTile)
+    {
+        error = "need one rank per tile, rank i owning tile i";
+        return false;
+    }
+    if (!migrate(transport, error))
+    {
+        return false;
+    }
+
+    // A pair interacts while the gap between edges is below the visual range, so a ghost is
+    // needed wherever a boid of the largest radius could be within that of it.
+    const float reach = mFlock.params().visualRange + 2.f * mLayout.maxRadius;
+    if (!exchangeHalo(transport, reach, error))
+    {
+        return false;
+    }
+
+    {
+        FLOCK_PROFILE_SCOPE(Phase::Search);
+        mScratch.reset();
+        mSharedGrid.build(mShared, reach, mScratch);
+    }
+    const uint32_t start[3] = {0, static_cast<uint32_t>(mFlock.state().size()),
+                               static_cast<uint32_t>(mShared.size())};
+    mFlock.update(pool, {&mShared, &mSharedGrid, start, 2, 0, 0b11});
+    return true;
+}
+
+bool TileNode::migrate(Transport &transport, std::string &error)
+{
+    const FlockState &state = mFlock.state();
+    const size_t n = state.size();
+    mOut.resize(transport.size());
+    for (Buffer &buffer : mOut)
+    {
+        buffer.clear();
+    }
+    mLeaving.assign(n, 0);
+    size_t leaving = 0;
+    for (uint32_t k = 0; k < n; k++)
+    {
+        const size_t owner = mLayout.tileOf({state.posX[k], state.posY[k]});
+        if (owner != mTile)
+        {
+            mLeaving[k] = 1;
+            leaving++;
+            append(mOut[owner], WireBoid{state.posX[k], state.posY[k], state.velX[k],
+                                         state.velY[k], state.radius[k], state.color[k],
+                                         globalId(k)});
+        }
+    }
+
+    if (!transport.exchange(mOut, mIn, error))
+    {
+        return false;
+    }
+
+    mArriving.clear();
+    mArrivingIds.clear();
+    for (size_t from = 0; from < mIn.size(); from++)
+    {
+        const bool ok = forEachWireBoid(mIn[from],
+                                        [&](const WireBoid &boid)
+                                        {
+                                            mArriving.add(boid.posX, boid.posY, boid.radius,
+                                                          boid.color);
+                                            mArriving.velX.back() = boid.velX;
+                                            mArriving.velY.back() = boid.velY;
+                                            mArrivingIds.push_back(boid.globalId);
+                                        });
+        if (!ok)
+        {
+            error = "malformed migration from rank " + std::to_string(from);
+            return false;
+        }
+    }
+
+    mMigrated = leaving + mArriving.size();
+    if (mMigrated == 0)
+    {
+        // Migrating renumbers the ids, which would reshuffle the jitter for nothing.
+        return true;
+    }
+    mKeptIds.clear();
+    for (uint32_t k = 0; k < n; k++)
+    {
+        if (!mLeaving[k])
+        {
+            mKeptIds.push_back(globalId(k));
+        }
+    }
+    mKeptIds.insert(mKeptIds.end(), mArrivingIds.begin(), mArrivingIds.end());
+    mFlock.migrate(mLeaving, mArriving);
+    mGlobalId.swap(mKeptIds);
+    return true;
+}
+
+bool TileNode::exchangeHalo(Transport &transport, float halo, std::string &error)
+{
+    const FlockState &state = mFlock.state();
+    const size_t n = state.size();
+    for (Buffer &buffer : mOut)
+    {
+        buffer.clear();
+    }
+
+    for (uint32_t k = 0; k < n; k++)
+    {
+        const float x = state.posX[k];
+        const float y = state.posY[k];
+        if (!std::isfinite(x) || !std::isfinite(y))
+        {
+            continue;
+        }
+        if (x - mMin.x >= halo && mMax.x - x >= halo && y - mMin.y >= halo && mMax.y - y >= halo)
+        {
+            // Most boids are nowhere near a border.
+            continue;
+        }
+
+        const uint32_t col0 = mLayout.colOf(x - halo), col1 = mLayout.colOf(x + halo);
+        const uint32_t row0 = mLayout.rowOf(y - halo), row1 = mLayout.rowOf(y + halo);
+        for (uint32_t row = row0; row <= row1; row++)
+        {
+            for (uint32_t col = col0; col <= col1; col++)
+            {
+                const size_t tile = mLayout.tileAt(col, row);
+                if (tile != mTile)
+                {
+                    append(mOut[tile], WireBoid{x, y, state.velX[k], state.velY[k],
+                                                state.radius[k], state.color[k], globalId(k)});
+                }
+            }
+        }
+    }
+
+    if (!transport.exchange(mOut, mIn, error))
+    {
+        return false;
+    }
+
+    mShared.clear();
+    mShared.posX.insert(mShared.posX.end(), state.posX.begin(), state.posX.end());
+    mShared.posY.insert(mShared.posY.end(), state.posY.begin(), state.posY.end());
+    mShared.velX.insert(mShared.velX.end(), state.velX.begin(), state.velX.end());
+    mShared.velY.insert(mShared.velY.end(), state.velY.begin(), state.velY.end());
+    mShared.radius.insert(mShared.radius.end(), state.radius.begin(), state.radius.end());
+    for (size_t from = 0; from < mIn.size(); from++)
+    {
+        const bool ok = forEachWireBoid(mIn[from],
+                                        [&](const WireBoid &boid)
+                                        {
+                                            mShared.posX.push_back(boid.posX);
+                                            mShared.posY.push_back(boid.posY);
+                                            mShared.velX.push_back(boid.velX);
+                                            mShared.velY.push_back(boid.velY);
+                                            mShared.radius.push_back(boid.radius);
+                                        });
+        if (!ok)
+        {
+            error = "malformed halo from rank " + std::to_string(from);
+            return false;
+        }
+    }
+    return true;
+}
+
+bool TileNode::gatherPreview(Transport &transport, size_t stride,
+                             std::vector<PreviewBoid> &preview, uint64_t &total,
+                             std::string &error)
+{
+    const FlockState &state = mFlock.state();
+    mOut.resize(transport.size());
+    for (Buffer &buffer : mOut)
+    {
+        buffer.clear();
+    }
+    append(mOut[0], uint64_t{state.size()});
+    for (size_t k = 0; k < state.size(); k += std::max<size_t>(stride, 1))
+    {
+        append(mOut[0], PreviewBoid{state.posX[k], state.posY[k], state.color[k]});
+    }
+
+    if (!transport.exchange(mOut, mIn, error))
+    {
+        return false;
+    }
+
+    preview.clear();
+    total = 0;
+    if (transport.rank() != 0)
+    {
+        return true;
+    }
+    for (size_t from = 0; from < mIn.size(); from++)
+    {
+        const Buffer &buffer = mIn[from];
+        uint64_t boids = 0;
+        if (buffer.size() < sizeof(boids) ||
+            (buffer.size() - sizeof(boids)) % sizeof(PreviewBoid) != 0)
+        {
+            error = "malformed preview from rank " + std::to_string(from);
+            return false;
+        }
+        std::memcpy(&boids, buffer.data(), sizeof(boids));
+        total += boids;
+        const size_t first = preview.size();
+        preview.resize(first + (buffer.size() - sizeof(boids)) / sizeof(PreviewBoid));
+        std::memcpy(preview.data() + first, buffer.data() + sizeof(boids),
+                    (preview.size() - first) * sizeof(PreviewBoid));
+    }
+    return true;
+}
@@ -0,0 +1,172 @@
+#pragma once
+
+#include "core/color.hpp"
+#include "core/flock.hpp"
+#include "core/flock_state.hpp"
+#include "core/spatial_grid.hpp"
+#include "core/thread_pool.hpp"
+#include "core/transport.hpp"
+#include "core/vec2.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * Split of the world rectangle into cols x rows equal tiles, tile = row * cols + col. Positions
+ * outside the rectangle belong to the nearest border tile.
+ */
+struct TileLayout
+{
+    Vec2 min;
+    Vec2 max{1920.f, 1080.f};
+    uint32_t cols = 1;
+    uint32_t rows = 1;
+    float maxRadius = 8.f; // Largest boid radius of any tile, for the halo width.
+
+    size_t tileCount() const { return static_cast<size_t>(cols) * rows; }
+
+    /**
+     * @brief	Tile column or row of a coordinate, clamped to the layout. NaN maps to 0.
+     */
+    uint32_t colOf(float x) const { return coordOf(x, min.x, max.x, cols); }
+    uint32_t rowOf(float y) const { return coordOf(y, min.y, max.y, rows); }
+    size_t tileAt(uint32_t col, uint32_t row) const { return size_t{row} * cols + col; }
+    size_t tileOf(Vec2 pos) const { return tileAt(colOf(pos.x), rowOf(pos.y)); }
+
+private:
+    static uint32_t coordOf(float v, float lo, float hi, uint32_t count)
+    {
+        const float t = (v - lo) / (hi - lo) * count;
+        return t >= 0.f ? static_cast<uint32_t>(std::min(t, count - 1.f)) : 0;
+    }
+};
+
+/**
+ * Boid as sent between tiles, native byte order.
+ */
+struct WireBoid
+{
+    float posX, posY;
+    float velX, velY;
+    float radius;
+    Color color;
+    uint32_t globalId; // Identity across the whole run, kept through migrations.
+};
+
+/**
+ * Boid of a down-sampled preview, for a renderer that can't take the full state. Only flock_node
+ * reads it so far, and only counts it; the SFML frontend draws a World of its own.
+ */
+struct PreviewBoid
+{
+    float posX, posY;
+    Color color;
+};
+
+/**
+ * One tile of a distributed run, owned by the rank of the same index. Each tick the tile hands
+ * boids that left it to their new owner, sends copies of the boids within reach of its border to
+ * the neighbouring tiles, and updates its own boids against those ghosts through the
+ * SharedNeighbours path of Flock, so boids near a border see the same neighbours as in one
+ * process.
+ *
+ * The ghosts are the state before the tick, so this is a Jacobi update across tiles. The jitter
+ * is keyed on ids local to the tile, which migrations renumber, so the noise differs from a
+ * single-process run with the same seed. Without noise the tiles match one Flock up to the order
+ * of the sums, which flock_node --verify checks.
+ */
+class TileNode
+{
+public:
+    /**
+     * @brief	Construct a new Tile Node object.
+     * @param	layout	    Split of the world, the same on every rank.
+     * @param	tile	    Tile this rank owns, its rank in the transport.
+     */
+    TileNode(const TileLayout &layout, size_t tile);
+
+    /**
+     * @brief	Adds a boid. Boids outside the tile are handed to their owner on the next step().
+     * @param	globalId	Identity of the boid across all tiles.
+     */
+    void addBoid(float x, float y, float radius, Color color, uint32_t globalId);
+
+    /**
+     * @brief	Appends boids with their velocities, e.g. the state of a single-process run being
+     *          split into tiles. Boids outside the tile are handed to their owner on the next
+     *          step().
+     * @param	boids	    Boids to add. Their ids are ignored.
+     * @param	globalIds	Identity of each boid across all tiles, boids.size() entries.
+     */
+    void addBoids(const FlockState &boids, const std::vector<uint32_t> &globalIds);
+
+    /**
+     * @brief	Migrates boids between tiles, exchanges halos and updates the tile by one tick.
+     *          Collective: every rank must call it.
+     * @param	transport	Ranks of the run, one per tile.
+     * @param	pool	    Threads to split the tile's boids between. May be null.
+     * @param	error	    Receives a description of the problem on failure.
+     * @return	false if the transport failed or a peer sent a malformed message.
+     */
+    bool step(Transport &transport, ThreadPool *pool, std::string &error);
+
+    /**
+     * @brief	Gathers every stride-th boid of every tile at rank 0. Collective.
+     * @param	transport	Ranks of the run.
+     * @param	stride	    Keep one boid in stride. At least 1.
+     * @param	preview	    Receives the preview of all tiles on rank 0, nothing on other ranks.
+     * @param	total	    Receives the total boid count on rank 0.
+     * @param	error	    Receives a description of the problem on failure.
+     */
+    bool gatherPreview(Transport &transport, size_t stride, std::vector<PreviewBoid> &preview,
+                       uint64_t &total, std::string &error);
+
+    Flock &flock() { return mFlock; }
+    const Flock &flock() const { return mFlock; }
+    size_t tile() const { return mTile; }
+
+    /**
+     * @brief	Global id of the boid in a slot of flock().
+     */
+    uint32_t globalId(uint32_t slot) const { return mGlobalId[mFlock.state().id[slot]]; }
+
+    /**
+     * @brief	Ghosts received in the last step() and boids that left or arrived in it.
+     */
+    size_t ghosts() const { return mShared.size() - mFlock.state().size(); }
+    size_t migrated() const { return mMigrated; }
+
+private:
+    TileLayout mLayout;
+    size_t mTile;
+    Vec2 mMin; // Bounds of the tile.
+    Vec2 mMax;
+
+    Flock mFlock;
+    std::vector<uint32_t> mGlobalId; // Global id of each id of mFlock.
+    size_t mMigrated = 0;
+
+    std::vector<Buffer> mOut; // Per-rank messages, reused between steps.
+    std::vector<Buffer> mIn;
+    std::vector<uint8_t> mLeaving;
+    FlockState mArriving;
+    std::vector<uint32_t> mArrivingIds;
+    std::vector<uint32_t> mKeptIds; // mGlobalId after a migration.
+    FlockState mShared; // Own boids followed by the ghosts.
+    SpatialGrid mSharedGrid;
+    ScratchArena mScratch;
+
+    /**
+     * @brief	Hands every boid outside the tile to its owner and takes in those handed to this
+     *          one.
+     */
+    bool migrate(Transport &transport, std::string &error);
+
+    /**
+     * @brief	Sends the boids within halo of the border to each tile they could be seen from and
+     *          collects the ghosts sent to this one after the own boids in mShared.
+     */
+    bool exchangeHalo(Transport &transport, float halo, std::string &error);
+};
@@ -0,0 +1,426 @@
+#include "core/trajectory_recorder.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+/**
+ * File layout: the header, then frames back to back, each a FrameHeader and its payload. All
+ * fields are native byte order.
+ *
+ * Channels are, in order, position x and y (unsigned, across the bounds) and velocity x and y
+ * (signed, stored as their 16-bit two's complement). A keyframe payload is each channel's array
+ * in turn. A delta payload is, boid after boid, the four channels' differences to the previous
+ * frame modulo 2^16, zigzag coded and written as little-endian base-128 varints.
+ */
+struct TrajectoryHeader
+{
+    char magic[8];             // TRAJECTORY_MAGIC.
+    uint32_t version;          // TRAJECTORY_VERSION.
+    uint32_t keyframeInterval; // TrajectoryFormat::keyframeInterval.
+    float min[2];              // TrajectoryFormat::min.
+    float max[2];              // TrajectoryFormat::max.
+    float velocityRange;       // TrajectoryFormat::velocityRange.
+    uint32_t reserved;         // 0.
+};
+
+struct FrameHeader
+{
+    uint32_t keyframe; // 1 for a keyframe, 0 for a delta frame.
+    uint32_t boids;
+    uint64_t tick;
+    uint64_t bytes; // Of the payload that follows.
+};
+
+static constexpr char TRAJECTORY_MAGIC[8] = {'F', 'L', 'O', 'C', 'K', 'T', 'R', 'J'};
+static constexpr size_t CHANNELS = 4;
+static constexpr size_t MAX_VARINT = 3; // Bytes of a 16-bit varint.
+
+static_assert(sizeof(TrajectoryHeader) == 40, "bump TRAJECTORY_VERSION");
+static_assert(sizeof(FrameHeader) == 24, "bump TRAJECTORY_VERSION");
+
+static uint16_t quantizePos(float v, float lo, float hi)
+{
+    // NaN fails the comparison and goes to 0.
+    const float t = (v - lo) / (hi - lo) * 65535.f + 0.5f;
+    return t > 0.f ? static_cast<uint16_t>(std::min(t, 65535.f)) : 0;
+}
+
+static uint16_t quantizeVel(float v, float range)
+{
+    const float t = std::clamp(v / range * 32767.f, -32767.f, 32767.f);
+    return static_cast<uint16_t>(static_cast<int16_t>(t == t ? std::lround(t) : 0));
+}
+
+static float dequantizePos(uint16_t q, float lo, float hi)
+{
+    return lo + q * ((hi - lo) / 65535.f);
+}
+
+static float dequantizeVel(uint16_t q, float range)
+{
+    return static_cast<int16_t>(q) * (range / 32767.f);
+}
+
+TrajectoryRecorder::~TrajectoryRecorder()
+{
+    close();
+}
+
+bool TrajectoryRecorder::open(const std::filesystem::path &path, const TrajectoryFormat &format,
+                              size_t slots, std::string &error)
+{
+    if (isOpen())
+    {
+        error = "a recording is already open";
+        return false;
+    }
+    if (slots < 1 || slots > MAX_SLOTS || !(format.max.x > format.min.x) ||
+        !(format.max.y > format.min.y) || !(format.velocityRange > 0.f))
+    {
+        error = "invalid recording format";
+        return false;
+    }
+    mFile.open(path, std::ios::binary | std::ios::trunc);
+    if (!mFile)
+    {
+        error = "cannot open " + path.string() + " for writing";
+        return false;
+    }
+
+    mFormat = format;
+    TrajectoryHeader header{{},
+                            TRAJECTORY_VERSION,
+                            format.keyframeInterval,
+                            {format.min.x, format.min.y},
+                            {format.max.x, format.max.y},
+                            format.velocityRange,
+                            0};
+    std::memcpy(header.magic, TRAJECTORY_MAGIC, sizeof(TRAJECTORY_MAGIC));
+    mFile.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+    // No writer runs yet, so both ends of both queues are ours until the thread starts.
+    uint32_t index;
+    while (mFree.pop(index) || mQueued.pop(index))
+    {
+    }
+    mSlots.assign(slots, {});
+    for (uint32_t s = 0; s < slots; s++)
+    {
+        mFree.push(s);
+    }
+    for (auto &channel : mLast)
+    {
+        channel.clear();
+    }
+    mSinceKeyframe = format.keyframeInterval; // The first frame is a keyframe.
+    mStop = false;
+    mFailed = !mFile;
+    mRecorded = 0;
+    mDropped = 0;
+    mBytes = sizeof(header);
+    mThread = std::thread([this] { writerLoop(); });
+    return true;
+}
+
+bool TrajectoryRecorder::record(const World &world, uint64_t tick)
+{
+    uint32_t index;
+    if (!isOpen() || !mFree.pop(index))
+    {
+        mDropped.fetch_add(isOpen(), std::memory_order_relaxed);
+        return false;
+    }
+
+    // Resizing only allocates while the flock grows; otherwise this is a scatter by id.
+    Slot &slot = mSlots[index];
+    const size_t n = world.size();
+    slot.tick = tick;
+    slot.posX.resize(n);
+    slot.posY.resize(n);
+    slot.velX.resize(n);
+    slot.velY.resize(n);
+    size_t base = 0;
+    for (size_t f = 0; f < world.flockCount(); f++)
+    {
+        const FlockState &state = world.flock(f).state();
+        for (size_t k = 0; k < state.size(); k++)
+        {
+            const size_t j = base + state.id[k];
+            slot.posX[j] = state.posX[k];
+            slot.posY[j] = state.posY[k];
+            slot.velX[j] = state.velX[k];
+            slot.velY[j] = state.velY[k];
+        }
+        base += state.size();
+    }
+
+    mQueued.push(index);
+    mRecorded.fetch_add(1, std::memory_order_relaxed);
+    mSignal.fetch_add(1, std::memory_order_release);
+    mSignal.notify_one();
+    return true;
+}
+
+bool TrajectoryRecorder::close()
+{
+    if (!isOpen())
+    {
+        return !mFailed;
+    }
+    mStop.store(true, std::memory_order_relaxed);
+    mSignal.fetch_add(1, std::memory_order_release);
+    mSignal.notify_one();
+    mThread.join();
+    mFile.close();
+    mFailed = mFailed || mFile.fail();
+    return !mFailed;
+}
+
+void TrajectoryRecorder::writerLoop()
+{
+    for (;;)
+    {
+        // Read the signal before draining, so a push after the drain changes it and the wait
+        // returns at once instead of missing the frame.
+        const uint64_t seen = mSignal.load(std::memory_order_acquire);
+        uint32_t index;
+        while (mQueued.pop(index))
+        {
+            writeFrame(mSlots[index]);
+            mFree.push(index);
+        }
+        if (mStop.load(std::memory_order_relaxed))
+        {
+            while (mQueued.pop(index))
+            {
+                writeFrame(mSlots[index]);
+                mFree.push(index);
+            }
+            mFile.flush();
+            mFailed = mFailed || !mFile;
+            return;
+        }
+        mSignal.wait(seen, std::memory_order_acquire);
+    }
+}
+
+void TrajectoryRecorder::writeFrame(const Slot &slot)
+{
+    const size_t n = slot.posX.size();
+    const bool keyframe = mSinceKeyframe >= mFormat.keyframeInterval || mLast[0].size() != n;
+    mSinceKeyframe = keyframe ? 0 : mSinceKeyframe + 1;
+
+    mPayload.clear();
+    mPayload.reserve(keyframe ? n * CHANNELS * sizeof(uint16_t) : n * CHANNELS * MAX_VARINT);
+    if (keyframe)
+    {
+        for (auto &channel : mLast)
+        {
+            channel.resize(n);
+        }
+    }
+
+    for (size_t k = 0; k < n; k++)
+    {
+        const uint16_t q[CHANNELS] = {quantizePos(slot.posX[k], mFormat.min.x, mFormat.max.x),
+                                      quantizePos(slot.posY[k], mFormat.min.y, mFormat.max.y),
+                                      quantizeVel(slot.velX[k], mFormat.velocityRange),
+                                      quantizeVel(slot.velY[k], mFormat.velocityRange)};
+        for (size_t c = 0; c < CHANNELS; c++)
+        {
+            if (!keyframe)
+            {
+                const auto delta = static_cast<int16_t>(q[c] - mLast[c][k]);
+                uint32_t zigzag = static_cast<uint16_t>((delta << 1) ^ (delta >> 15));
+                while (zigzag >= 0x80)
+                {
+                    mPayload.push_back(static_cast<uint8_t>(zigzag | 0x80));
+                    zigzag >>= 7;
+                }
+                mPayload.push_back(static_cast<uint8_t>(zigzag));
+            }
+            mLast[c][k] = q[c];
+        }
+    }
+    if (keyframe)
+    {
+        for (const auto &channel : mLast)
+        {
+            const auto *bytes = reinterpret_cast<const uint8_t *>(channel.data());
+            mPayload.insert(mPayload.end(), bytes, bytes + n * sizeof(uint16_t));
+        }
+    }
+
+    const FrameHeader header{keyframe, static_cast<uint32_t>(n), slot.tick, mPayload.size()};
+    mFile.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    mFile.write(reinterpret_cast<const char *>(mPayload.data()),
+                static_cast<std::streamsize>(mPayload.size()));
+    if (!mFile)
+    {
+        mFailed = true;
+    }
+    mBytes.fetch_add(sizeof(header) + mPayload.size(), std::memory_order_relaxed);
+}
+
+bool TrajectoryReader::open(const std::filesystem::path &path, std::string &error)
+{
+    mFile = std::ifstream(path, std::ios::binary | std::ios::ate);
+    if (!mFile)
+    {
+        error = "cannot open " + path.string();
+        return false;
+    }
+    const uint64_t size = static_cast<uint64_t>(mFile.tellg());
+    mFile.seekg(0);
+
+    TrajectoryHeader header;
+    if (!mFile.read(reinterpret_cast<char *>(&header), sizeof(header)) ||
+        std::memcmp(header.magic, TRAJECTORY_MAGIC, sizeof(TRAJECTORY_MAGIC)) != 0)
+    {
+        error = path.string() + ": not a trajectory recording";
+        return false;
+    }
+    if (header.version != TRAJECTORY_VERSION)
+    {
+        error = path.string() + ": recording version " + std::to_string(header.version) +
+                ", expected " + std::to_string(TRAJECTORY_VERSION);
+        return false;
+    }
+    mFormat = {{header.min[0], header.min[1]},
+               {header.max[0], header.max[1]},
+               header.velocityRange,
+               header.keyframeInterval};
+
+    mFrames.clear();
+    mDecoded = SIZE_MAX;
+    uint64_t offset = sizeof(header);
+    FrameHeader frame;
+    while (size - offset >= sizeof(frame) &&
+           mFile.read(reinterpret_cast<char *>(&frame), sizeof(frame)))
+    {
+        offset += sizeof(frame);
+        if (frame.bytes > size - offset)
+        {
+            break; // Cut off while recording.
+        }
+        const uint64_t n = frame.boids;
+        const bool follows = !mFrames.empty() && mFrames.back().boids == frame.boids;
+        const bool valid = frame.keyframe
+                               ? frame.bytes == n * CHANNELS * sizeof(uint16_t)
+                               : follows && frame.bytes >= n * CHANNELS &&
+                                     frame.bytes <= n * CHANNELS * MAX_VARINT;
+        if (frame.keyframe > 1 || !valid)
+        {
+            error = path.string() + ": corrupt frame " + std::to_string(mFrames.size());
+            return false;
+        }
+        mFrames.push_back({offset, frame.bytes, frame.tick, frame.boids, frame.keyframe == 1});
+        offset += frame.bytes;
+        mFile.seekg(static_cast<std::streamoff>(offset));
+    }
+    mFile.clear();
+    return true;
+}
+
+bool TrajectoryReader::read(size_t frame, TrajectoryFrame &out, std::string &error)
+{
+    if (frame >= mFrames.size())
+    {
+        error = "frame " + std::to_string(frame) + " out of range";
+        return false;
+    }
+
+    // Continue from the frame decoded last if no keyframe lies in between, else from the
+    // keyframe at or before the one asked for. open() checked the first frame is a keyframe.
+    size_t start = frame;
+    while (!mFrames[start].keyframe)
+    {
+        start--;
+    }
+    if (mDecoded != SIZE_MAX && mDecoded >= start && mDecoded <= frame)
+    {
+        start = mDecoded + 1;
+    }
+    for (size_t f = start; f <= frame; f++)
+    {
+        if (!decode(f, error))
+        {
+            mDecoded = SIZE_MAX;
+            return false;
+        }
+        mDecoded = f;
+    }
+
+    const size_t n = mFrames[frame].boids;
+    out.tick = mFrames[frame].tick;
+    out.posX.resize(n);
+    out.posY.resize(n);
+    out.velX.resize(n);
+    out.velY.resize(n);
+    for (size_t k = 0; k < n; k++)
+    {
+        out.posX[k] = dequantizePos(mLast[0][k], mFormat.min.x, mFormat.max.x);
+        out.posY[k] = dequantizePos(mLast[1][k], mFormat.min.y, mFormat.max.y);
+        out.velX[k] = dequantizeVel(mLast[2][k], mFormat.velocityRange);
+        out.velY[k] = dequantizeVel(mLast[3][k], mFormat.velocityRange);
+    }
+    return true;
+}
+
+bool TrajectoryReader::decode(size_t frame, std::string &error)
+{
+    const Entry &entry = mFrames[frame];
+    mPayload.resize(entry.bytes);
+    mFile.seekg(static_cast<std::streamoff>(entry.offset));
+    if (!mFile.read(reinterpret_cast<char *>(mPayload.data()),
+                    static_cast<std::streamsize>(entry.bytes)))
+    {
+        mFile.clear();
+        error = "read of frame " + std::to_string(frame) + " failed";
+        return false;
+    }
+
+    const size_t n = entry.boids;
+    if (entry.keyframe)
+    {
+        for (size_t c = 0; c < CHANNELS; c++)
+        {
+            mLast[c].resize(n);
+            std::memcpy(mLast[c].data(), mPayload.data() + c * n * sizeof(uint16_t),
+                        n * sizeof(uint16_t));
+        }
+        return true;
+    }
+
+    size_t at = 0;
+    for (size_t k = 0; k < n; k++)
+    {
+        for (size_t c = 0; c < CHANNELS; c++)
+        {
+            uint32_t zigzag = 0;
+            for (int shift = 0;; shift += 7)
+            {
+                if (at == mPayload.size() || shift > 14)
+                {
+                    error = "corrupt delta in frame " + std::to_string(frame);
+                    return false;
+                }
+                const uint8_t byte = mPayload[at++];
+                zigzag |= uint32_t{byte & 0x7fu} << shift;
+                if (!(byte & 0x80))
+                {
+                    break;
+                }
+            }
+            const auto delta = static_cast<uint16_t>((zigzag >> 1) ^ (0u - (zigzag & 1)));
+            mLast[c][k] = static_cast<uint16_t>(mLast[c][k] + delta);
+        }
+    }
+    if (at != mPayload.size())
+    {
+        error = "corrupt delta in frame " + std::to_string(frame);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,181 @@
+#pragma once
+
+#include "core/aligned_allocator.hpp"
+#include "core/spsc_queue.hpp"
+#include "core/vec2.hpp"
+#include "core/world.hpp"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Bumped whenever the file layout changes. Older files are rejected.
+inline constexpr uint32_t TRAJECTORY_VERSION = 1;
+
+/**
+ * Quantization of a recording: positions are 16-bit fixed point across the world bounds,
+ * velocities 16-bit signed fixed point across [-velocityRange, velocityRange]. Coordinates
+ * outside either range are clamped.
+ */
+struct TrajectoryFormat
+{
+    Vec2 min;
+    Vec2 max{1920.f, 1080.f};
+    float velocityRange = 8.f;
+    uint32_t keyframeInterval = 64; // Delta frames between two keyframes.
+};
+
+/**
+ * Streams the positions and velocities of every boid of a world to a file, one frame per
+ * recorded tick, from a thread of its own.
+ *
+ * record() only copies the state into one of a fixed number of frame slots and hands it to the
+ * writer thread; it never waits for it. When every slot is still queued the frame is dropped and
+ * counted, so memory stays bounded at slots * boids * 16 bytes and a slow disk can't stall the
+ * simulation. The writer quantizes each frame and stores it either whole, as a keyframe, or as
+ * per-boid differences to the last frame written, zigzag varint coded, which takes about one byte
+ * per channel for boids moving a few pixels per tick.
+ *
+ * Boids are stored flock after flock, in id order within each flock, so boid k of a frame is the
+ * same boid in every frame between two changes of the boid count.
+ */
+class TrajectoryRecorder
+{
+public:
+    // Upper bound of open()'s slot count.
+    static constexpr size_t MAX_SLOTS = 16;
+
+    TrajectoryRecorder() = default;
+    ~TrajectoryRecorder();
+
+    TrajectoryRecorder(const TrajectoryRecorder &) = delete;
+    TrajectoryRecorder &operator=(const TrajectoryRecorder &) = delete;
+
+    /**
+     * @brief	Creates the file and starts the writer thread.
+     * @param	path	    File to write. Replaced if it exists.
+     * @param	format	    Quantization and keyframe interval.
+     * @param	slots	    Frames that may wait for the writer at once, in [1, MAX_SLOTS].
+     * @param	error	    Receives a description of the problem on failure.
+     * @return	false if the file can't be created or a recording is already open.
+     */
+    bool open(const std::filesystem::path &path, const TrajectoryFormat &format, size_t slots,
+              std::string &error);
+
+    /**
+     * @brief	Queues the current state of the world as the frame of a tick. Never blocks. Call
+     *          from one thread only.
+     * @param	world	    Flocks to record.
+     * @param	tick	    Tick number stored with the frame.
+     * @return	false if no recording is open or every slot is queued and the frame was dropped.
+     */
+    bool record(const World &world, uint64_t tick);
+
+    /**
+     * @brief	Writes the frames still queued, stops the writer and closes the file.
+     * @return	false if a write failed at any point of the recording.
+     */
+    bool close();
+
+    bool isOpen() const { return mThread.joinable(); }
+    uint64_t recorded() const { return mRecorded.load(std::memory_order_relaxed); }
+    uint64_t dropped() const { return mDropped.load(std::memory_order_relaxed); }
+    uint64_t bytesWritten() const { return mBytes.load(std::memory_order_relaxed); }
+
+private:
+    struct Slot
+    {
+        uint64_t tick = 0;
+        FloatArray posX; // In recording order, see the class comment.
+        FloatArray posY;
+        FloatArray velX;
+        FloatArray velY;
+    };
+
+    TrajectoryFormat mFormat;
+    std::ofstream mFile;
+    std::vector<Slot> mSlots;
+    SpscQueue<uint32_t, MAX_SLOTS> mFree;   // Slots record() may fill, returned by the writer.
+    SpscQueue<uint32_t, MAX_SLOTS> mQueued; // Slots waiting for the writer.
+    std::atomic<uint64_t> mSignal{0};       // Bumped after every push to mQueued or on close.
+    std::atomic<bool> mStop{false};
+    std::atomic<bool> mFailed{false};
+    std::thread mThread;
+
+    std::atomic<uint64_t> mRecorded{0};
+    std::atomic<uint64_t> mDropped{0};
+    std::atomic<uint64_t> mBytes{0};
+
+    // Writer state: the last frame written, quantized, and the frame being encoded.
+    std::array<std::vector<uint16_t>, 4> mLast;
+    std::vector<uint8_t> mPayload;
+    uint32_t mSinceKeyframe = 0;
+
+    void writerLoop();
+    void writeFrame(const Slot &slot);
+};
+
+/**
+ * Frame of a recording, dequantized.
+ */
+struct TrajectoryFrame
+{
+    uint64_t tick = 0;
+    std::vector<float> posX; // In recording order, see TrajectoryRecorder.
+    std::vector<float> posY;
+    std::vector<float> velX;
+    std::vector<float> velY;
+};
+
+/**
+ * Random access to a file written by TrajectoryRecorder. open() indexes the frame headers, so
+ * reading a frame decodes from the keyframe at or before it, at most keyframeInterval frames.
+ */
+class TrajectoryReader
+{
+public:
+    /**
+     * @brief	Opens and indexes a recording.
+     * @param	path	    File to read.
+     * @param	error	    Receives a description of the problem on failure.
+     * @return	false if the file can't be read, is not a recording of this version or is corrupt.
+     *          A frame cut off at the end, e.g. by a crash while recording, is ignored.
+     */
+    bool open(const std::filesystem::path &path, std::string &error);
+
+    const TrajectoryFormat &format() const { return mFormat; }
+    size_t frameCount() const { return mFrames.size(); }
+    uint64_t tick(size_t frame) const { return mFrames[frame].tick; }
+
+    /**
+     * @brief	Decodes one frame. Reading frames in order decodes each only once.
+     * @param	frame	    Index in [0, frameCount()).
+     * @param	out	        Receives the frame. Its capacity is reused.
+     * @param	error	    Receives a description of the problem on failure.
+     */
+    bool read(size_t frame, TrajectoryFrame &out, std::string &error);
+
+private:
+    struct Entry
+    {
+        uint64_t offset; // Of the payload in the file.
+        uint64_t bytes;  // Of the payload.
+        uint64_t tick;
+        uint32_t boids;
+        bool keyframe;
+    };
+
+    std::ifstream mFile;
+    TrajectoryFormat mFormat;
+    std::vector<Entry> mFrames;
+    std::array<std::vector<uint16_t>, 4> mLast; // Quantized frame mDecoded.
+    size_t mDecoded = SIZE_MAX;
+    std::vector<uint8_t> mPayload;
+
+    bool decode(size_t frame, std::string &error);
+};
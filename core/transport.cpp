@@ -0,0 +1,438 @@
+#include "core/transport.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#define FLOCK_HAVE_SOCKETS 1
+#endif
+
+/**
+ * Transport of one rank of a LocalHub. Every message goes through the hub's mailbox between two
+ * barriers: one so all ranks have posted before any collects, one so none posts the next round
+ * before all have collected.
+ */
+class LocalHub::Rank : public Transport
+{
+public:
+    Rank(LocalHub &hub, size_t rank) : mHub(hub), mRank(rank) {}
+
+    size_t rank() const override { return mRank; }
+    size_t size() const override { return mHub.mRanks; }
+
+    bool exchange(const std::vector<Buffer> &out, std::vector<Buffer> &in,
+                  std::string &error) override
+    {
+        const size_t ranks = mHub.mRanks;
+        if (out.size() != ranks)
+        {
+            error = "exchange needs one buffer per rank";
+            return false;
+        }
+        for (size_t to = 0; to < ranks; to++)
+        {
+            mHub.mMail[mRank * ranks + to] = out[to];
+        }
+        mHub.mBarrier.arrive_and_wait();
+        in.resize(ranks);
+        for (size_t from = 0; from < ranks; from++)
+        {
+            in[from] = mHub.mMail[from * ranks + mRank];
+        }
+        mHub.mBarrier.arrive_and_wait();
+        return true;
+    }
+
+private:
+    LocalHub &mHub;
+    size_t mRank;
+};
+
+LocalHub::LocalHub(size_t ranks)
+    : mRanks(ranks), mMail(ranks * ranks), mBarrier(static_cast<std::ptrdiff_t>(ranks))
+{
+    for (size_t r = 0; r < ranks; r++)
+    {
+        mTransports.push_back(std::make_unique<Rank>(*this, r));
+    }
+}
+
+LocalHub::~LocalHub() = default;
+
+Transport &LocalHub::transport(size_t rank)
+{
+    return *mTransports[rank];
+}
+
+#ifdef FLOCK_HAVE_SOCKETS
+
+// Larger length prefixes are taken as a corrupt stream rather than allocated.
+static constexpr uint64_t MAX_MESSAGE = uint64_t{1} << 32;
+
+#ifdef MSG_NOSIGNAL
+static constexpr int SEND_FLAGS = MSG_NOSIGNAL;
+#else
+static constexpr int SEND_FLAGS = 0;
+#endif
+
+/**
+ * @brief	Splits "host:port" at the last colon.
+ * @return	false if either part is empty.
+ */
+static bool splitEndpoint(const std::string &endpoint, std::string &host, std::string &port)
+{
+    const size_t colon = endpoint.rfind(':');
+    if (colon == std::string::npos || colon == 0 || colon + 1 == endpoint.size())
+    {
+        return false;
+    }
+    host = endpoint.substr(0, colon);
+    port = endpoint.substr(colon + 1);
+    return true;
+}
+
+/**
+ * @brief	Reads or writes exactly size bytes on a blocking socket.
+ */
+static bool readAll(int fd, void *data, size_t size)
+{
+    auto *p = static_cast<char *>(data);
+    while (size > 0)
+    {
+        const ssize_t n = recv(fd, p, size, 0);
+        if (n <= 0)
+        {
+            return false;
+        }
+        p += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+static bool writeAll(int fd, const void *data, size_t size)
+{
+    const auto *p = static_cast<const char *>(data);
+    while (size > 0)
+    {
+        const ssize_t n = send(fd, p, size, SEND_FLAGS);
+        if (n <= 0)
+        {
+            return false;
+        }
+        p += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+/**
+ * @brief	Opens a socket listening on port on every interface.
+ * @return	The socket, or -1.
+ */
+static int listenOn(const std::string &port, int backlog)
+{
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+    addrinfo *addresses = nullptr;
+    if (getaddrinfo(nullptr, port.c_str(), &hints, &addresses) != 0)
+    {
+        return -1;
+    }
+
+    int fd = -1;
+    for (addrinfo *a = addresses; a && fd < 0; a = a->ai_next)
+    {
+        fd = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+        if (fd < 0)
+        {
+            continue;
+        }
+        const int on = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+        if (bind(fd, a->ai_addr, a->ai_addrlen) != 0 || listen(fd, backlog) != 0)
+        {
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(addresses);
+    return fd;
+}
+
+/**
+ * @brief	Connects to host:port once.
+ * @return	The socket, or -1.
+ */
+static int connectTo(const std::string &host, const std::string &port)
+{
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo *addresses = nullptr;
+    if (getaddrinfo(host.c_str(), port.c_str(), &hints, &addresses) != 0)
+    {
+        return -1;
+    }
+
+    int fd = -1;
+    for (addrinfo *a = addresses; a && fd < 0; a = a->ai_next)
+    {
+        fd = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+        if (fd >= 0 && connect(fd, a->ai_addr, a->ai_addrlen) != 0)
+        {
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(addresses);
+    return fd;
+}
+
+TcpTransport::~TcpTransport()
+{
+    for (const int fd : mSockets)
+    {
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+    }
+}
+
+bool TcpTransport::open(const std::vector<std::string> &endpoints, size_t rank,
+                        std::string &error)
+{
+    const size_t ranks = endpoints.size();
+    if (rank >= ranks)
+    {
+        error = "rank " + std::to_string(rank) + " is not in the endpoint list";
+        return false;
+    }
+    std::string host, port;
+    for (const std::string &endpoint : endpoints)
+    {
+        if (!splitEndpoint(endpoint, host, port))
+        {
+            error = "expected host:port, got '" + endpoint + "'";
+            return false;
+        }
+    }
+
+    mRank = rank;
+    mSockets.assign(ranks, -1);
+
+    // Listen before connecting, so ranks above that start early queue in the backlog.
+    splitEndpoint(endpoints[rank], host, port);
+    const int listener = ranks - 1 > rank ? listenOn(port, static_cast<int>(ranks)) : -1;
+    if (ranks - 1 > rank && listener < 0)
+    {
+        error = "cannot listen on port " + port;
+        return false;
+    }
+
+    const auto deadline =
+        std::chrono::steady_clock::now() + std::chrono::seconds(CONNECT_TIMEOUT_S);
+    bool ok = true;
+    for (size_t peer = 0; peer < rank && ok; peer++)
+    {
+        splitEndpoint(endpoints[peer], host, port);
+        int fd = -1;
+        while ((fd = connectTo(host, port)) < 0 && std::chrono::steady_clock::now() < deadline)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+        const uint32_t self = static_cast<uint32_t>(rank);
+        if (fd < 0 || !writeAll(fd, &self, sizeof(self)))
+        {
+            error = "cannot reach rank " + std::to_string(peer) + " at " + endpoints[peer];
+            if (fd >= 0)
+            {
+                close(fd);
+            }
+            ok = false;
+            break;
+        }
+        mSockets[peer] = fd;
+    }
+
+    for (size_t accepted = rank + 1; accepted < ranks && ok; accepted++)
+    {
+        pollfd wait{listener, POLLIN, 0};
+        const auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+            deadline - std::chrono::steady_clock::now());
+        uint32_t peer = 0;
+        const int fd = poll(&wait, 1, static_cast<int>(std::max<int64_t>(left.count(), 0))) > 0
+                           ? accept(listener, nullptr, nullptr)
+                           : -1;
+        if (fd < 0 || !readAll(fd, &peer, sizeof(peer)) || peer <= rank || peer >= ranks ||
+            mSockets[peer] >= 0)
+        {
+            error = "gave up waiting for the ranks above " + std::to_string(rank);
+            if (fd >= 0)
+            {
+                close(fd);
+            }
+            ok = false;
+            break;
+        }
+        mSockets[peer] = fd;
+    }
+    if (listener >= 0)
+    {
+        close(listener);
+    }
+    if (!ok)
+    {
+        return false;
+    }
+
+    for (const int fd : mSockets)
+    {
+        if (fd >= 0)
+        {
+            // Halo messages are latency bound, so don't hold them back for coalescing.
+            const int on = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+            fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        }
+    }
+    return true;
+}
+
+bool TcpTransport::exchange(const std::vector<Buffer> &out, std::vector<Buffer> &in,
+                            std::string &error)
+{
+    const size_t ranks = mSockets.size();
+    if (out.size() != ranks)
+    {
+        error = "exchange needs one buffer per rank";
+        return false;
+    }
+    in.resize(ranks);
+    in[mRank] = out[mRank];
+
+    // Progress through each peer's length prefix and body, in both directions.
+    struct Peer
+    {
+        uint64_t sendLength;
+        uint64_t recvLength;
+        size_t sent;     // Bytes of prefix plus body written.
+        size_t received; // Bytes of prefix plus body read.
+    };
+    constexpr size_t PREFIX = sizeof(uint64_t);
+    std::vector<Peer> peers(ranks);
+    std::vector<pollfd> fds;
+    std::vector<size_t> fdPeer;
+    size_t pending = 0;
+    for (size_t r = 0; r < ranks; r++)
+    {
+        peers[r] = {out[r].size(), 0, 0, 0};
+        pending += r != mRank ? 2 : 0;
+    }
+
+    while (pending > 0)
+    {
+        fds.clear();
+        fdPeer.clear();
+        for (size_t r = 0; r < ranks; r++)
+        {
+            const Peer &p = peers[r];
+            const bool sending = p.sent < PREFIX + p.sendLength;
+            const bool receiving = p.received < PREFIX || p.received < PREFIX + p.recvLength;
+            if (r != mRank && (sending || receiving))
+            {
+                const short events = (sending ? POLLOUT : 0) | (receiving ? POLLIN : 0);
+                fds.push_back({mSockets[r], events, 0});
+                fdPeer.push_back(r);
+            }
+        }
+        if (poll(fds.data(), fds.size(), -1) < 0)
+        {
+            error = std::string("poll failed: ") + std::strerror(errno);
+            return false;
+        }
+
+        for (size_t k = 0; k < fds.size(); k++)
+        {
+            const size_t r = fdPeer[k];
+            Peer &p = peers[r];
+            const int fd = mSockets[r];
+            if (fds[k].revents & POLLOUT)
+            {
+                const auto *prefix = reinterpret_cast<const char *>(&p.sendLength);
+                const bool inPrefix = p.sent < PREFIX;
+                const char *from = inPrefix ? prefix + p.sent
+                                            : reinterpret_cast<const char *>(out[r].data()) +
+                                                  (p.sent - PREFIX);
+                const size_t left = inPrefix ? PREFIX - p.sent : PREFIX + p.sendLength - p.sent;
+                const ssize_t n = send(fd, from, left, SEND_FLAGS);
+                if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+                {
+                    error = "send to rank " + std::to_string(r) + " failed";
+                    return false;
+                }
+                p.sent += n > 0 ? static_cast<size_t>(n) : 0;
+                pending -= p.sent == PREFIX + p.sendLength;
+            }
+            const bool receiving = p.received < PREFIX || p.received < PREFIX + p.recvLength;
+            if (receiving && fds[k].revents & (POLLIN | POLLHUP | POLLERR))
+            {
+                const bool inPrefix = p.received < PREFIX;
+                char *to = inPrefix ? reinterpret_cast<char *>(&p.recvLength) + p.received
+                                    : reinterpret_cast<char *>(in[r].data()) +
+                                          (p.received - PREFIX);
+                const size_t left =
+                    inPrefix ? PREFIX - p.received : PREFIX + p.recvLength - p.received;
+                const ssize_t n = recv(fd, to, left, 0);
+                if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+                {
+                    error = "rank " + std::to_string(r) + " disconnected";
+                    return false;
+                }
+                p.received += n > 0 ? static_cast<size_t>(n) : 0;
+                if (inPrefix && p.received == PREFIX)
+                {
+                    if (p.recvLength > MAX_MESSAGE)
+                    {
+                        error = "corrupt message from rank " + std::to_string(r);
+                        return false;
+                    }
+                    in[r].resize(p.recvLength);
+                }
+                pending -= p.received >= PREFIX && p.received == PREFIX + p.recvLength;
+            }
+        }
+    }
+    return true;
+}
+
+#else
+
+TcpTransport::~TcpTransport() = default;
+
+bool TcpTransport::open(const std::vector<std::string> &, size_t, std::string &error)
+{
+    error = "the TCP transport needs POSIX sockets";
+    return false;
+}
+
+bool TcpTransport::exchange(const std::vector<Buffer> &, std::vector<Buffer> &, std::string &error)
+{
+    error = "the TCP transport needs POSIX sockets";
+    return false;
+}
+
+#endif
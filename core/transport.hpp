@@ -0,0 +1,137 @@
+#pragma once
+
+#include <barrier>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+using Buffer = std::vector<std::byte>;
+
+/**
+ * Message passing between the processes of a distributed run, one rank each. The only operation
+ * is a collective all-to-all exchange, the shape of MPI_Alltoallv, so any transport that can
+ * move one buffer between every pair of ranks can be plugged in.
+ */
+class Transport
+{
+public:
+    virtual ~Transport() = default;
+
+    /**
+     * @brief	Index of this process, in [0, size()).
+     */
+    virtual size_t rank() const = 0;
+
+    /**
+     * @brief	Number of processes.
+     */
+    virtual size_t size() const = 0;
+
+    /**
+     * @brief	Sends out[r] to every rank r and receives what every rank sent to this one.
+     *          Collective: blocks until every rank has called it.
+     * @param	out	        One buffer per rank, size() in all. out[rank()] is delivered to
+     *                      in[rank()]. Empty buffers are allowed.
+     * @param	in	        Receives one buffer per rank. Its storage is reused.
+     * @param	error	    Receives a description of the problem on failure.
+     * @return	false if a peer disconnected or the transport failed. The run can't continue.
+     */
+    virtual bool exchange(const std::vector<Buffer> &out, std::vector<Buffer> &in,
+                          std::string &error) = 0;
+};
+
+/**
+ * Ranks that are threads of one process, for runs and checks on a single machine.
+ */
+class LocalHub
+{
+public:
+    /**
+     * @brief	Construct a new Local Hub object.
+     * @param	ranks	    Number of ranks. Each must be driven by its own thread.
+     */
+    explicit LocalHub(size_t ranks);
+    ~LocalHub();
+
+    LocalHub(const LocalHub &) = delete;
+    LocalHub &operator=(const LocalHub &) = delete;
+
+    /**
+     * @brief	Transport of one rank. Lives as long as the hub.
+     */
+    Transport &transport(size_t rank);
+
+private:
+    class Rank;
+
+    size_t mRanks;
+    std::vector<Buffer> mMail; // mMail[from * mRanks + to].
+    std::barrier<> mBarrier;
+    std::vector<std::unique_ptr<Rank>> mTransports;
+};
+
+/**
+ * Full mesh of TCP connections between the ranks. Messages are length-prefixed and all sockets
+ * are driven together by poll(), so two ranks sending each other more than a socket buffer
+ * can't deadlock.
+ */
+class TcpTransport : public Transport
+{
+public:
+    // How long open() keeps retrying peers that are not listening yet.
+    static constexpr int CONNECT_TIMEOUT_S = 30;
+
+    TcpTransport() = default;
+    ~TcpTransport() override;
+
+    TcpTransport(const TcpTransport &) = delete;
+    TcpTransport &operator=(const TcpTransport &) = delete;
+
+    /**
+     * @brief	Connects to every other rank. Ranks listen on their own endpoint, accept the ranks
+     *          above them and connect to those below, so they may be started in any order.
+     * @param	endpoints	"host:port" of every rank, the same list on every rank.
+     * @param	rank	    Index of this process in endpoints.
+     * @param	error	    Receives a description of the problem on failure.
+     * @return	false if an endpoint is malformed or a peer can't be reached in time.
+     */
+    bool open(const std::vector<std::string> &endpoints, size_t rank, std::string &error);
+
+    size_t rank() const override { return mRank; }
+    size_t size() const override { return mSockets.size(); }
+    bool exchange(const std::vector<Buffer> &out, std::vector<Buffer> &in,
+                  std::string &error) override;
+
+private:
+    size_t mRank = 0;
+    std::vector<int> mSockets; // Connected socket of each rank, -1 for this one.
+};
+
+#ifdef FLOCK_HAVE_MPI
+/**
+ * Ranks of an MPI communicator. MPI_Init must have been called before construction.
+ * Experimental: so far only compiled against a stub mpi.h, never run on a real MPI.
+ */
+class MpiTransport : public Transport
+{
+public:
+    MpiTransport();
+
+    size_t rank() const override { return mRank; }
+    size_t size() const override { return mSize; }
+    bool exchange(const std::vector<Buffer> &out, std::vector<Buffer> &in,
+                  std::string &error) override;
+
+private:
+    size_t mRank = 0;
+    size_t mSize = 1;
+    std::vector<int> mSendCounts; // Per-rank counts and displacements for MPI_Alltoallv.
+    std::vector<int> mSendOffsets;
+    std::vector<int> mRecvCounts;
+    std::vector<int> mRecvOffsets;
+    Buffer mSend;
+    Buffer mRecv;
+};
+#endif
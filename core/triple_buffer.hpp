@@ -0,0 +1,51 @@
+#pragma once
+
+#include "core/aligned_allocator.hpp"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+/**
+ * Lock-free single-producer single-consumer triple buffer. The writer fills back() and publishes
+ * it; the reader always gets the most recently published value and never waits for the writer.
+ * Values published faster than they are read are skipped.
+ */
+template <typename T> class TripleBuffer
+{
+public:
+    /**
+     * @brief	Slot the writer fills. Only touched by the writer thread.
+     */
+    T &back() { return mSlots[mBack]; }
+
+    /**
+     * @brief	Makes back() visible to the reader and hands the writer a free slot.
+     */
+    void publish()
+    {
+        mBack = mMiddle.exchange(mBack | FRESH, std::memory_order_acq_rel) & INDEX;
+    }
+
+    /**
+     * @brief	Latest published value. Only touched by the reader thread.
+     * @return	The same slot until the writer publishes again.
+     */
+    const T &front()
+    {
+        if (mMiddle.load(std::memory_order_relaxed) & FRESH)
+        {
+            mFront = mMiddle.exchange(mFront, std::memory_order_acq_rel) & INDEX;
+        }
+        return mSlots[mFront];
+    }
+
+private:
+    static constexpr uint8_t INDEX = 0x3;
+    static constexpr uint8_t FRESH = 0x4;
+
+    std::array<T, 3> mSlots;
+    uint8_t mBack = 0;
+    alignas(CACHE_LINE) std::atomic<uint8_t> mMiddle{1};
+    alignas(CACHE_LINE) uint8_t mFront = 2;
+};
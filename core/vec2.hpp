@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cmath>
+
+/**
+ * 2D vector used by the simulation. Covers the part of sf::Vector2f the flocking rules need, so
+ * the core builds without SFML.
+ */
+struct Vec2
+{
+    float x = 0.f;
+    float y = 0.f;
+
+    constexpr Vec2() = default;
+    constexpr Vec2(float x, float y) : x(x), y(y) {}
+
+    float length() const { return std::sqrt(x * x + y * y); }
+    constexpr float lengthSquared() const { return x * x + y * y; }
+
+    /**
+     * @brief	Vector of length 1 in the same direction. Undefined for the zero vector.
+     */
+    Vec2 normalized() const
+    {
+        const float len = length();
+        return {x / len, y / len};
+    }
+
+    constexpr Vec2 &operator+=(Vec2 o)
+    {
+        x += o.x;
+        y += o.y;
+        return *this;
+    }
+
+    constexpr Vec2 &operator-=(Vec2 o)
+    {
+        x -= o.x;
+        y -= o.y;
+        return *this;
+    }
+
+    constexpr Vec2 &operator*=(float s)
+    {
+        x *= s;
+        y *= s;
+        return *this;
+    }
+
+    constexpr Vec2 &operator/=(float s)
+    {
+        x /= s;
+        y /= s;
+        return *this;
+    }
+};
+
+constexpr Vec2 operator+(Vec2 a, Vec2 b) { return {a.x + b.x, a.y + b.y}; }
+constexpr Vec2 operator-(Vec2 a, Vec2 b) { return {a.x - b.x, a.y - b.y}; }
+constexpr Vec2 operator-(Vec2 a) { return {-a.x, -a.y}; }
+constexpr Vec2 operator*(Vec2 a, float s) { return {a.x * s, a.y * s}; }
+constexpr Vec2 operator*(float s, Vec2 a) { return {a.x * s, a.y * s}; }
+constexpr Vec2 operator/(Vec2 a, float s) { return {a.x / s, a.y / s}; }
+constexpr bool operator==(Vec2 a, Vec2 b) { return a.x == b.x && a.y == b.y; }
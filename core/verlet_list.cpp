@@ -0,0 +1,111 @@
+#include "core/verlet_list.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+bool VerletList::needsRebuild(const FlockState &state, float maxDisplacement) const
+{
+    const size_t n = state.size();
+    if (!mValid || mRefX.size() != n)
+    {
+        return true;
+    }
+
+    // Written so a NaN displacement does not count as a move.
+    const float limit = maxDisplacement * maxDisplacement;
+    for (size_t i = 0; i < n; i++)
+    {
+        const float dx = state.posX[i] - mRefX[i];
+        const float dy = state.posY[i] - mRefY[i];
+        if (dx * dx + dy * dy > limit)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+template <typename Fn>
+void VerletList::forEachInRange(const FlockState &state, const SpatialGrid &grid, uint32_t i,
+                                float range, Fn &&fn)
+{
+    const float x = state.posX[i];
+    const float y = state.posY[i];
+    const float r = state.radius[i];
+    grid.forEachCandidateCell({x, y},
+                              [&](const uint32_t *indices, size_t count)
+                              {
+                                  for (size_t k = 0; k < count; k++)
+                                  {
+                                      const uint32_t j = indices[k];
+                                      const float dx = state.posX[j] - x;
+                                      const float dy = state.posY[j] - y;
+                                      const float reach = range + r + state.radius[j];
+                                      if (j != i && dx * dx + dy * dy < reach * reach)
+                                      {
+                                          fn(j);
+                                      }
+                                  }
+                              });
+}
+
+void VerletList::build(const FlockState &state, const SpatialGrid &grid, float range,
+                       ThreadPool *pool, size_t chunk)
+{
+    const size_t n = state.size();
+    chunk = std::max<size_t>(chunk, 1);
+    const size_t chunks = (n + chunk - 1) / chunk;
+
+    mStart.resize(n + 1);
+    mChunkLists.resize(std::max(chunks, mChunkLists.size()));
+    mRefX.assign(state.posX.begin(), state.posX.end());
+    mRefY.assign(state.posY.begin(), state.posY.end());
+
+    // One sweep: each chunk of boids appends to its own list, mStart[i + 1] holding the running
+    // count within the chunk. The pool hands out chunk-aligned ranges, and a range covering
+    // several chunks (the single-threaded case) is split here.
+    auto fill = [&](size_t begin, size_t end)
+    {
+        for (size_t c = begin; c < end; c += chunk)
+        {
+            std::vector<uint32_t> &out = mChunkLists[c / chunk];
+            out.clear();
+            for (uint32_t i = c; i < std::min(end, c + chunk); i++)
+            {
+                forEachInRange(state, grid, i, range, [&](uint32_t j) { out.push_back(j); });
+                mStart[i + 1] = static_cast<uint32_t>(out.size());
+            }
+        }
+    };
+    if (pool)
+    {
+        pool->parallelFor(n, chunk, fill);
+    }
+    else
+    {
+        fill(0, n);
+    }
+
+    // Concatenate the chunks and turn the running counts into offsets.
+    size_t total = 0;
+    for (size_t c = 0; c < chunks; c++)
+    {
+        total += mChunkLists[c].size();
+    }
+    mList.resize(total);
+
+    mStart[0] = 0;
+    uint32_t base = 0;
+    for (size_t c = 0; c < chunks; c++)
+    {
+        const std::vector<uint32_t> &list = mChunkLists[c];
+        std::copy(list.begin(), list.end(), mList.begin() + base);
+        for (size_t i = c * chunk; i < std::min(n, (c + 1) * chunk); i++)
+        {
+            mStart[i + 1] += base;
+        }
+        base += static_cast<uint32_t>(list.size());
+    }
+
+    mValid = true;
+}
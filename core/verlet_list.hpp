@@ -0,0 +1,65 @@
+#pragma once
+
+#include "core/aligned_allocator.hpp"
+#include "core/flock_state.hpp"
+#include "core/spatial_grid.hpp"
+#include "core/thread_pool.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Per-boid lists of every boid within the visual range plus a skin, kept across ticks. While no
+ * boid has moved more than half the skin since the lists were built, every pair within the visual
+ * range is still in them, so the neighbour search only runs when that no longer holds.
+ */
+class VerletList
+{
+public:
+    /**
+     * @brief	Whether the lists may miss a neighbour. Always true before the first build and
+     *          after invalidate().
+     * @param	state	    Current flock.
+     * @param	maxDisplacement	Largest distance a boid may have moved since the build.
+     */
+    bool needsRebuild(const FlockState &state, float maxDisplacement) const;
+
+    /**
+     * @brief	Rebuilds every list from a grid binned with cells at least range + 2 * max radius.
+     * @param	state	    Flock to build the lists of.
+     * @param	grid	    Grid of state.
+     * @param	range	    Gap between boid edges below which a pair is listed.
+     * @param	pool	    Threads to split the boids between. May be null.
+     * @param	chunk	    Boids per pool task.
+     */
+    void build(const FlockState &state, const SpatialGrid &grid, float range, ThreadPool *pool,
+               size_t chunk);
+
+    /**
+     * @brief	Forces the next needsRebuild() to return true, e.g. after boids were added,
+     *          removed or moved to other slots.
+     */
+    void invalidate() { mValid = false; }
+
+    /**
+     * @brief	Listed candidates of boid i.
+     */
+    const uint32_t *neighbours(uint32_t i) const { return mList.data() + mStart[i]; }
+    size_t count(uint32_t i) const { return mStart[i + 1] - mStart[i]; }
+
+private:
+    bool mValid = false;
+    std::vector<uint32_t> mStart; // Boid i's list is mList[mStart[i], mStart[i + 1]).
+    std::vector<uint32_t> mList;
+    std::vector<std::vector<uint32_t>> mChunkLists; // Per-chunk output of build(), kept for reuse.
+    FloatArray mRefX; // Positions at the last build.
+    FloatArray mRefY;
+
+    /**
+     * @brief	Visits the candidates of boid i within range, in grid order.
+     */
+    template <typename Fn>
+    static void forEachInRange(const FlockState &state, const SpatialGrid &grid, uint32_t i,
+                               float range, Fn &&fn);
+};
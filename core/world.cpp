@@ -0,0 +1,225 @@
+#include "core/world.hpp"
+#include "core/counter_rng.hpp"
+
+#include <algorithm>
+#include <numeric>
+
+Flock *World::addFlock()
+{
+    if (mFlocks.size() == MAX_FLOCKS)
+    {
+        return nullptr;
+    }
+    mSees.push_back(uint64_t{1} << mFlocks.size());
+    mFlocks.push_back(std::make_unique<Flock>());
+    mFlocks.back()->setSeed(noiseKey(mSeed, static_cast<uint32_t>(mFlocks.size() - 1)));
+    mGroupsDirty = true;
+    return mFlocks.back().get();
+}
+
+void World::setSeed(uint32_t seed)
+{
+    mSeed = seed;
+    for (size_t f = 0; f < mFlocks.size(); f++)
+    {
+        mFlocks[f]->setSeed(noiseKey(mSeed, static_cast<uint32_t>(f)));
+    }
+}
+
+void World::setInteraction(size_t observer, size_t other, bool sees)
+{
+    const uint64_t bit = uint64_t{1} << other;
+    mSees[observer] = sees ? mSees[observer] | bit : mSees[observer] & ~bit;
+    mGroupsDirty = true;
+}
+
+void World::update(ThreadPool *pool)
+{
+    FLOCK_PROFILE_SCOPE(Phase::Tick);
+    if (mGroupsDirty)
+    {
+        buildGroups();
+    }
+
+    // Singles first, then groups. Neither reads what another one writes.
+    const size_t units = mSingles.size() + mGroups.size();
+    auto updateUnit = [&](size_t u, ThreadPool *inner)
+    {
+        if (u < mSingles.size())
+        {
+            mFlocks[mSingles[u]]->update(inner);
+        }
+        else
+        {
+            updateGroup(mGroups[u - mSingles.size()], inner);
+        }
+    };
+
+    // Splitting a flock between threads pays a dispatch per flock and leaves threads idle in the
+    // serial search phase, so with enough singles and groups each thread takes whole ones instead.
+    if (pool && units >= pool->size())
+    {
+        pool->parallelFor(units, 1,
+                          [&](size_t begin, size_t end)
+                          {
+                              for (size_t u = begin; u < end; u++)
+                              {
+                                  updateUnit(u, nullptr);
+                              }
+                          });
+    }
+    else
+    {
+        for (size_t u = 0; u < units; u++)
+        {
+            updateUnit(u, pool);
+        }
+    }
+}
+
+void World::updateGroup(Group &group, ThreadPool *pool)
+{
+    // Copy the members one after another, so each member's boids are one run of slots and every
+    // member reads the same pre-tick positions however the updates are ordered.
+    FlockState &shared = group.shared;
+    group.scratch.reset();
+    shared.clear();
+    group.start.clear();
+    float cellSize = 0.f;
+    float maxRadius = 0.f;
+    for (const uint32_t f : group.members)
+    {
+        const Flock &flock = *mFlocks[f];
+        const FlockState &state = flock.state();
+        group.start.push_back(static_cast<uint32_t>(shared.size()));
+        shared.posX.insert(shared.posX.end(), state.posX.begin(), state.posX.end());
+        shared.posY.insert(shared.posY.end(), state.posY.begin(), state.posY.end());
+        shared.velX.insert(shared.velX.end(), state.velX.begin(), state.velX.end());
+        shared.velY.insert(shared.velY.end(), state.velY.begin(), state.velY.end());
+        shared.radius.insert(shared.radius.end(), state.radius.begin(), state.radius.end());
+        cellSize = std::max(cellSize, flock.params().visualRange);
+        maxRadius = std::max(maxRadius, flock.maxRadius());
+    }
+    group.start.push_back(static_cast<uint32_t>(shared.size()));
+
+    {
+        FLOCK_PROFILE_SCOPE(Phase::Search);
+        group.grid.build(shared, cellSize + 2.f * maxRadius, group.scratch);
+    }
+
+    for (size_t m = 0; m < group.members.size(); m++)
+    {
+        // Remap the observer's mask from flock indices to member indices.
+        const uint64_t sees = mSees[group.members[m]];
+        uint64_t memberSees = 0;
+        for (size_t k = 0; k < group.members.size(); k++)
+        {
+            memberSees |= (sees >> group.members[k] & 1) << k;
+        }
+
+        const SharedNeighbours neighbours{&shared, &group.grid, group.start.data(),
+                                          group.members.size(), static_cast<uint32_t>(m),
+                                          memberSees};
+        mFlocks[group.members[m]]->update(pool, neighbours);
+    }
+}
+
+void World::buildGroups()
+{
+    // Union-find over both directions of every interaction between two different flocks.
+    const size_t n = mFlocks.size();
+    std::vector<uint32_t> parent(n);
+    std::iota(parent.begin(), parent.end(), 0u);
+    auto find = [&](uint32_t f)
+    {
+        while (parent[f] != f)
+        {
+            f = parent[f] = parent[parent[f]];
+        }
+        return f;
+    };
+    for (uint32_t i = 0; i < n; i++)
+    {
+        for (uint32_t j = 0; j < n; j++)
+        {
+            if (i != j && interacts(i, j))
+            {
+                parent[find(i)] = find(j);
+            }
+        }
+    }
+
+    mSingles.clear();
+    mGroups.clear();
+    std::vector<int> groupOf(n, -1);
+    std::vector<uint32_t> size(n, 0);
+    for (uint32_t f = 0; f < n; f++)
+    {
+        size[find(f)]++;
+    }
+    for (uint32_t f = 0; f < n; f++)
+    {
+        // A lone flock that ignores itself still goes through a group of one, whose mask keeps it
+        // from seeing its own boids; Flock::update(pool) always searches them.
+        const uint32_t root = find(f);
+        if (size[root] == 1 && interacts(f, f))
+        {
+            mSingles.push_back(f);
+            continue;
+        }
+        if (groupOf[root] < 0)
+        {
+            groupOf[root] = static_cast<int>(mGroups.size());
+            mGroups.emplace_back();
+        }
+        mGroups[groupOf[root]].members.push_back(f);
+    }
+    mGroupsDirty = false;
+}
+
+size_t World::size() const
+{
+    size_t n = 0;
+    for (const auto &flock : mFlocks)
+    {
+        n += flock->state().size();
+    }
+    return n;
+}
+
+FlockStats World::stats() const
+{
+    FlockStats total;
+    for (const auto &flock : mFlocks)
+    {
+        total.candidatePairs += flock->stats().candidatePairs;
+        total.neighbourPairs += flock->stats().neighbourPairs;
+        total.listRebuilds += flock->stats().listRebuilds;
+        total.farTerms += flock->stats().farTerms;
+        total.cappedBoids += flock->stats().cappedBoids;
+    }
+    return total;
+}
+
+void World::gather(FlockState &out) const
+{
+    out.clear();
+    for (const auto &flock : mFlocks)
+    {
+        const FlockState &state = flock->state();
+        out.posX.insert(out.posX.end(), state.posX.begin(), state.posX.end());
+        out.posY.insert(out.posY.end(), state.posY.begin(), state.posY.end());
+        out.velX.insert(out.velX.end(), state.velX.begin(), state.velX.end());
+        out.velY.insert(out.velY.end(), state.velY.begin(), state.velY.end());
+        out.radius.insert(out.radius.end(), state.radius.begin(), state.radius.end());
+        out.color.insert(out.color.end(), state.color.begin(), state.color.end());
+        out.id.insert(out.id.end(), state.id.begin(), state.id.end());
+    }
+}
+
+void World::clear()
+{
+    mFlocks.clear();
+    mSees.clear();
+    mGroupsDirty = true;
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include "core/flock.hpp"
+#include "core/flock_state.hpp"
+#include "core/scratch_arena.hpp"
+#include "core/spatial_grid.hpp"
+#include "core/thread_pool.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/**
+ * Owns a set of flocks, each with its own boids, destination and rule constants, and updates
+ * them together.
+ *
+ * Flocks only see their own boids unless setInteraction() says otherwise. Flocks connected by
+ * interactions form a group that is binned once into a shared grid, and each member searches it
+ * for the boids of the flocks it sees, itself included only if it sees itself. Flocks that see
+ * just themselves keep their own grid or Verlet lists, so only the members of a group share an
+ * index. Groups and such single flocks are independent of each other; when there are at least as
+ * many of them as threads, whole ones are handed to the threads instead of splitting each flock,
+ * which scales with the number of flocks as well as with their size.
+ */
+class World
+{
+public:
+    // Flocks per world, the width of the interaction masks.
+    static constexpr size_t MAX_FLOCKS = 64;
+
+    /**
+     * @brief	Adds an empty flock that sees only itself.
+     * @return	The new flock, or null if there are MAX_FLOCKS already.
+     */
+    Flock *addFlock();
+
+    /**
+     * @brief	Reseeds the random steering of every flock, present and future. Flock i gets a
+     *          seed derived from (seed, i), so flocks don't share noise.
+     * @param	seed	    World seed.
+     */
+    void setSeed(uint32_t seed);
+    uint32_t seed() const { return mSeed; }
+
+    Flock &flock(size_t i) { return *mFlocks[i]; }
+    const Flock &flock(size_t i) const { return *mFlocks[i]; }
+    size_t flockCount() const { return mFlocks.size(); }
+
+    /**
+     * @brief	Sets whether one flock reacts to the boids of another. Not symmetric: a flock can
+     *          chase another that ignores it.
+     * @param	observer	Flock whose boids steer.
+     * @param	other	    Flock whose boids they see. observer == other toggles whether a flock
+     *                      sees its own boids.
+     * @param	sees	    Whether observer sees other.
+     */
+    void setInteraction(size_t observer, size_t other, bool sees);
+    bool interacts(size_t observer, size_t other) const { return mSees[observer] >> other & 1; }
+
+    /**
+     * @brief	Updates every flock by one tick.
+     * @param	pool	    Threads to split the work between. May be null.
+     */
+    void update(ThreadPool *pool = nullptr);
+
+    /**
+     * @brief	Total number of boids.
+     */
+    size_t size() const;
+
+    /**
+     * @brief	Work counters of the last update, summed over all flocks.
+     */
+    FlockStats stats() const;
+
+    /**
+     * @brief	Copies every flock's boids into one state, flock after flock in index order. Ids
+     *          are those of each flock, so they repeat between flocks.
+     * @param	out	        Receives the boids. Its capacity is reused.
+     */
+    void gather(FlockState &out) const;
+
+    /**
+     * @brief	Removes all flocks.
+     */
+    void clear();
+
+private:
+    // A set of flocks connected by interactions, updated from one shared grid. Each group keeps
+    // its own buffers, so groups can update on different threads.
+    struct Group
+    {
+        std::vector<uint32_t> members; // Flock indices, ascending.
+        FlockState shared;             // The members' boids, member after member.
+        SpatialGrid grid;              // Over shared.
+        std::vector<uint32_t> start;   // First slot of each member, then shared.size().
+        ScratchArena scratch;          // Reset at the start of every update of the group.
+    };
+
+    std::vector<std::unique_ptr<Flock>> mFlocks;
+    uint32_t mSeed = 0;
+    std::vector<uint64_t> mSees; // Bit j of mSees[i] is set if flock i sees flock j.
+    std::vector<uint32_t> mSingles; // Flocks that see no other flock and are seen by none.
+    std::vector<Group> mGroups;
+    bool mGroupsDirty = true;
+
+    /**
+     * @brief	Splits the flocks into singles and groups from the interaction masks.
+     */
+    void buildGroups();
+
+    /**
+     * @brief	Updates the members of a group from one grid over all of their boids.
+     * @param	group	    Group to update.
+     * @param	pool	    Threads to split each member between. May be null.
+     */
+    void updateGroup(Group &group, ThreadPool *pool);
+};
@@ -1,291 +1,1011 @@
-/**
- * Sources:
- * - https://vanhunteradams.com/Pico/Animal_Movement/Boids-algorithm.html
- */
+#include "app/flock_renderer.hpp"
+#ifdef FLOCK_HAVE_GPU
+#include "app/gpu_flock.hpp"
+#endif
+#include "app/profiler_overlay.hpp"
+#include "app/sfml_convert.hpp"
+#include "core/color.hpp"
+#include "core/fixed_timestep.hpp"
+#include "core/flock.hpp"
+#include "core/flock_params.hpp"
+#include "core/profiler.hpp"
+#include "core/quality_governor.hpp"
+#include "core/simulation_thread.hpp"
+#include "core/snapshot.hpp"
+#include "core/spawn.hpp"
+#include "core/thread_pool.hpp"
+#include "core/trajectory_recorder.hpp"
+#include "core/world.hpp"
 
-#include <SFML/Graphics/CircleShape.hpp>
 #include <SFML/Graphics/Color.hpp>
+#include <SFML/Graphics/Image.hpp>
 #include <SFML/Graphics/RenderWindow.hpp>
+#include <SFML/Graphics/View.hpp>
+#include <SFML/System/Clock.hpp>
 #include <SFML/System/Vector2.hpp>
+#include <SFML/Window/Context.hpp>
+#include <SFML/Window/ContextSettings.hpp>
 #include <SFML/Window/Keyboard.hpp>
+#include <SFML/Window/Mouse.hpp>
 #include <SFML/Window/VideoMode.hpp>
-#include <bits/types/cookie_io_functions_t.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
 #include <cstdint>
-#include <ctime>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
 #include <memory>
+#include <optional>
 #include <random>
-
-class Flock;
+#include <string>
+#include <string_view>
+#include <vector>
 
 /**
- * Flocking object (boid).
+ * Startup settings of FlockingApp.
  */
-class Boid
+struct AppSettings
 {
-public:
-    Boid(float x, float y, float radius, sf::Color color)
-        : mPos(x, y), mRadius(radius), mColor(color), mCirc(radius)
-    {
-    }
-
-    /**
-     * @brief	Move the boid according to its velocity.
-     */
-    void move() { mPos += mVel; }
-
-    /**
-     * @brief	Draws the boid to an SFML window.
-     * @param	window	SFML render window.
-     */
-    void draw(sf::RenderWindow *window)
-    {
-        mCirc.setPosition(mPos - sf::Vector2f{mRadius, mRadius});
-        mCirc.setFillColor(mColor);
-        window->draw(mCirc);
-    }
-
-    sf::Vector2f &velocity() { return mVel; }
-    const sf::Vector2f &position() const { return mPos; }
-    const float &radius() const { return mRadius; }
-
-private:
-    sf::Vector2f mPos;
-    sf::Vector2f mVel{0.f, 0.f};
-
-    float mRadius;
-    sf::Color mColor = sf::Color::Red;
-    sf::CircleShape mCirc;
+    unsigned int windowWidth = 1524;  // Width in pixels of the SFML window.
+    unsigned int windowHeight = 1024; // Height in pixels of the SFML window.
+    unsigned int flockSize = 300;     // Number of boids, split evenly between the flocks.
+    unsigned int flocks = 1;          // Number of flocks, each steered by its own destination.
+    unsigned int threads = 0;         // Number of simulation threads. 0 uses one per core.
+    double tickRate = 60.0;           // Simulation ticks per second.
+    unsigned int frameLimit = 60;     // Rendered frames per second. 0 is unlimited.
+    unsigned int idleFrameLimit = 10; // Frames per second while unfocused. 0 stops drawing.
+    std::optional<double> idleTicks;  // Tick rate while unfocused, 0 pauses. Unset keeps tickRate.
+    float budgetMs = 0.f;             // Frame time the quality governor holds. 0 is the limit's.
+    float hysteresis = 0.25f;         // Spare budget the governor needs before raising quality.
+    bool governor = true;             // Lower the quality when frames run over budget.
+    bool gpu = false;                 // Simulate in compute shaders. Needs FLOCK_HAVE_GPU.
+    std::string paramsPath;           // Rule constants file, reloaded on change. May be empty.
+    std::optional<uint32_t> seed;     // Seed of the boid placement and noise. Random if unset.
+    std::string snapshotPath;         // Snapshot to start from instead of random flocks.
+    std::string recordPath;           // Trajectory recording written while running. May be empty.
+    SpawnShape spawn{};               // Placement of random flocks, uniform by default.
+    std::string spawnImage;           // Image to use as the density of random flocks. May be empty.
 };
 
 /**
- * Flock contains a set of boids which move in unison towards a destination.
+ * Runs a world of flocks. Initializes the flocks, adds boids, updates the flocks based on
+ * events, and draws them each frame to an SFML window.
  */
-class Flock
+class FlockingApp
 {
 public:
     /**
-     * @brief	Updates velocities and positions of all boids in the flock.
+     * @brief	Construct a new Flocking App object.
+     * @param	settings	Window, flock and timing settings.
      */
-    void update()
+    explicit FlockingApp(const AppSettings &settings)
+        : mPool(settings.threads), mSeed(settings.seed.value_or(std::random_device{}())),
+          mFlockSize(settings.flockSize),
+          mFlockCount(std::clamp<unsigned int>(settings.flocks, 1, World::MAX_FLOCKS)),
+          mWorldSize(settings.windowWidth, settings.windowHeight), mTickRate(settings.tickRate),
+          mFrameLimit(settings.frameLimit), mIdleFrameLimit(settings.idleFrameLimit),
+          mIdleTicks(settings.idleTicks), mRunRate(settings.tickRate)
     {
-        static std::mt19937 rng{std::random_device{}()};
-        static std::uniform_real_distribution<float> noise(-1.f, 1.f);
-
-        for (auto &boid : mBoids)
+        // Compute shaders need a 4.3 context; SFML falls back to what the driver offers.
+        sf::ContextSettings context;
+        if (settings.gpu)
         {
-            const float &r = boid->radius();
-            const sf::Vector2f &pos = boid->position();
-            sf::Vector2f &vel = boid->velocity();
-
-            sf::Vector2f separation{0.f, 0.f};
-            sf::Vector2f avg_vel{0.f, 0.f};
-            sf::Vector2f avg_pos{0.f, 0.f};
-            int neighbourhood_size = 0;
+            context.majorVersion = 4;
+            context.minorVersion = 3;
+        }
+        mWindow = sf::RenderWindow(sf::VideoMode({settings.windowWidth, settings.windowHeight}),
+                                   "Flocking Demo (SFML)", sf::Style::Default,
+                                   sf::State::Windowed, context);
+        mWindow.setFramerateLimit(settings.frameLimit);
+        GovernorSettings governor;
+        governor.budgetMs = settings.budgetMs > 0.f ? settings.budgetMs
+                            : settings.frameLimit > 0 ? 1000.f / settings.frameLimit
+                                                      : governor.budgetMs;
+        governor.hysteresis = settings.hysteresis;
+        mGovernor.setSettings(governor);
+        mGovernor.setEnabled(settings.governor);
+        mView = mWindow.getDefaultView();
+        std::cerr << "Seed " << mSeed << " (--seed " << mSeed << " repeats this run)\n";
+        mWorld.setSeed(mSeed);
+        std::string error;
+        mSpawn.shape = settings.spawn;
+        mSpawn.max = {static_cast<float>(mWorldSize.x), static_cast<float>(mWorldSize.y)};
+        if (!settings.spawnImage.empty())
+        {
+            if (loadDensity(settings.spawnImage, mDensity))
+            {
+                mSpawn.shape = SpawnShape::Density;
+                mSpawn.density = &mDensity;
+            }
+            else
+            {
+                std::cerr << "Could not read " << settings.spawnImage << ", spawning uniformly\n";
+            }
+        }
+        if (!settings.snapshotPath.empty() && loadSnapshot(settings.snapshotPath, mWorld, error))
+        {
+            // Reset then refills the same number of flocks and boids at random.
+            mFlockCount = static_cast<unsigned int>(mWorld.flockCount());
+            mFlockSize = static_cast<unsigned int>(mWorld.size());
+        }
+        else
+        {
+            if (!error.empty())
+            {
+                std::cerr << error << ", starting from random flocks\n";
+            }
+            for (unsigned int f = 0; f < mFlockCount; f++)
+            {
+                mWorld.addFlock();
+            }
+            createRandomFlocks();
+        }
+        if (!settings.paramsPath.empty())
+        {
+            mParamsFile.emplace(settings.paramsPath);
+            if (mParamsFile->poll(mParams))
+            {
+                applyCommand(mWorld, {SimCommand::Type::SetParams, {}, 0, mParams});
+            }
+        }
 
-            // Iterate over other boids
-            for (auto &other_boid : mBoids)
+        if (settings.gpu)
+        {
+#ifdef FLOCK_HAVE_GPU
+            mGpu = std::make_unique<GpuFlock>(Vec2(mWorldSize.x, mWorldSize.y), mSeed);
+            mGpu->setParams(mParams);
+            if (mWindow.setActive() && mGpu->init(mWindow.getSettings()))
             {
-                if (boid.get() == other_boid.get())
+                mWorld.gather(mGpuState);
+                mGpu->upload(mGpuState);
+                if (!settings.recordPath.empty())
                 {
-                    continue;
+                    // The recorder reads the world the simulation thread ticks, which the GPU
+                    // never touches.
+                    std::cerr << "Recording needs the CPU backend, not recording\n";
                 }
+                return;
+            }
+            std::cerr << "GPU backend unavailable (" << mGpu->error() << "), using the CPU\n";
+            mGpu.reset();
+#else
+            std::cerr << "Built without FLOCK_ENABLE_GPU, using the CPU\n";
+#endif
+        }
 
-                const float &r2 = other_boid->radius();
-                const sf::Vector2f &pos2 = other_boid->position();
-                sf::Vector2f &vel2 = other_boid->velocity();
+        if (!settings.recordPath.empty())
+        {
+            // Boids off screen clamp to the border of the recording.
+            const TrajectoryFormat format{{0.f, 0.f},
+                                          {static_cast<float>(mWorldSize.x),
+                                           static_cast<float>(mWorldSize.y)},
+                                          mParams.maxSpeed,
+                                          TrajectoryFormat{}.keyframeInterval};
+            if (!mRecorder.open(settings.recordPath, format, RECORD_SLOTS, error))
+            {
+                std::cerr << error << ", not recording\n";
+            }
+        }
 
-                sf::Vector2f toOther = pos2 - pos;
-                const float len = toOther.length();
-                const float dist = len - (r + r2);
-                if (dist < VISUAL_RANGE)
+        // From here on the world belongs to the simulation thread.
+        mSim = std::make_unique<SimulationThread>(
+            mWorld, &mPool, settings.tickRate,
+            [this](World &world, const SimCommand &command) { applyCommand(world, command); },
+            [this](const World &world, uint64_t tick)
+            {
+                if (mRecorder.isOpen())
                 {
-                    separation -= toOther / (len * std::pow(2.f, dist));
-                    avg_vel += vel2;
-                    avg_pos += pos2;
-                    neighbourhood_size++;
+                    mRecorder.record(world, tick);
                 }
+            });
+    }
+
+    /**
+     * @brief	Run the flocking app. The simulation advances at the fixed tick rate on its own
+     *          thread; each frame draws its latest snapshot interpolated from the tick before,
+     *          so the picture runs up to one tick behind the simulation.
+     *          While the window is unfocused or hidden, see updateIdle(), frames that would draw
+     *          nothing wait for the next event instead.
+     */
+    void run()
+    {
+#ifdef FLOCK_HAVE_GPU
+        if (mGpu)
+        {
+            runGpu();
+            return;
+        }
+#endif
+        while (mWindow.isOpen())
+        {
+            handleEvents();
+            if (renderPaused())
+            {
+                waitForEvent();
+                continue;
             }
 
-            if (neighbourhood_size > 0)
+            const FlockSnapshot &snapshot = mSim->latest();
+            {
+                FLOCK_PROFILE_SCOPE(Phase::Draw);
+                mWindow.clear(sf::Color::Black);
+                mWindow.setView(mView);
+                mRenderer.draw(mWindow, snapshot.state, mSim->alpha(snapshot));
+            }
+            present();
+            // Idle frames are slow on purpose, which the governor would take for overload.
+            if (!mIdle)
             {
-                avg_vel /= static_cast<float>(neighbourhood_size);
-                avg_pos /= static_cast<float>(neighbourhood_size);
+                governQuality();
             }
+        }
+    }
 
-            sf::Vector2f toTarget = mDest - pos;
-            sf::Vector2f toDest = toTarget.normalized() * MAX_SPEED;
+private:
+    static constexpr const char *TRACE_PATH = "flock_trace.json";
+    static constexpr const char *SNAPSHOT_PATH = "flock_snapshot.bin";
+    static constexpr float ZOOM_STEP = 1.15f; // View scale per mouse wheel notch.
+    static constexpr size_t RECORD_SLOTS = 8;  // Ticks the recorder may fall behind by.
+    // Longest wait for events while no frames are drawn.
+    static constexpr float IDLE_WAIT_SECONDS = 0.1f;
 
-            vel += separation * AVOID_FACTOR;                 // Separation
-            vel += MATCHING_FACTOR * (avg_vel - vel);         // Alignment
-            vel += CENTERING_FACTOR * (avg_pos - pos);        // Cohesion
-            vel = (1.f - BIAS_VAL) * vel + BIAS_VAL * toDest; // Destination
+    sf::RenderWindow mWindow;
+    ThreadPool mPool;
+    World mWorld;
+    FlockRenderer mRenderer;
+    uint32_t mSeed;
+    SpawnDistribution mSpawn; // Placement of random flocks. Seeded per flock and reset.
+    DensityMap mDensity;      // Of --spawn-image, pointed to by mSpawn.
+    uint32_t mSpawns = 0;     // Flocks spawned so far, so that every reset differs.
+    unsigned int mFlockSize;
+    unsigned int mFlockCount;
+    unsigned int mActiveFlock = 0; // Flock the mouse steers.
+    bool mInteract = false;        // Whether the flocks see each other.
+    sf::Vector2u mWorldSize;
+    double mTickRate;
+    unsigned int mFrameLimit;
+    unsigned int mIdleFrameLimit;
+    std::optional<double> mIdleTicks;
+    double mRunRate; // Tick rate the simulation is set to now, 0 while paused.
+    bool mFocused = true;
+    bool mHidden = false; // Resized to nothing, which is how some platforms minimize.
+    bool mIdle = false;   // Unfocused or hidden, see updateIdle().
+    bool mSimd = true;
+    bool mFastMath = false;
+    bool mCompact = false;
+    NeighbourSearch mSearch = NeighbourSearch::Grid;
+    FlockParams mParams; // Last sent to the simulation. The flocks' copies are not ours to read.
+    std::optional<ParamsFile> mParamsFile;
+    sf::Clock mParamsClock;
+    sf::View mView;        // Camera over the world. The overlay uses the default view.
+    bool mPanning = false; // Right mouse button held.
+    sf::Vector2i mPanFrom; // Cursor position the pan last moved from.
+    ProfilerOverlay mOverlay;
+    bool mShowOverlay = false;
+    QualityGovernor mGovernor; // Fed by the profiler, drives the flocks' quality and the LOD.
+    sf::Clock mTitleClock;
+#ifdef FLOCK_HAVE_GPU
+    std::unique_ptr<GpuFlock> mGpu; // Set when the flock runs on the GPU instead of mSim.
+    FlockState mGpuState;           // The flocks gathered for upload.
+#endif
+    TrajectoryRecorder mRecorder; // Fed by the simulation thread, so declared before mSim.
+    std::unique_ptr<SimulationThread> mSim; // Declared last so it stops before the rest goes.
+
+#ifdef FLOCK_HAVE_GPU
+    /**
+     * @brief	Render loop of the GPU backend. The compute passes need the window's GL context, so
+     *          ticks run on this thread at the fixed rate, ahead of each draw.
+     */
+    void runGpu()
+    {
+        FixedTimestep timestep(mTickRate);
+        double rate = mTickRate;
+        sf::Clock clock;
+        while (mWindow.isOpen())
+        {
+            handleEvents();
+            if (mRunRate != rate)
+            {
+                // Start the new rate afresh rather than making up the time spent at the old one.
+                rate = mRunRate;
+                timestep.setTickRate(rate > 0.0 ? rate : mTickRate);
+                timestep.reset();
+                clock.restart();
+            }
 
-            // Add random movements
-            sf::Vector2f jitter{noise(rng) * NOISE_STRENGTH, noise(rng) * NOISE_STRENGTH};
-            vel += jitter;
+            const float elapsed = clock.restart().asSeconds();
+            const unsigned int ticks = rate > 0.0 ? timestep.advance(elapsed) : 0;
+            for (unsigned int t = 0; t < ticks; t++)
+            {
+                // Times queueing the passes; the GPU running them shows up in Display, whose
+                // swap waits for it.
+                FLOCK_PROFILE_SCOPE(Phase::Tick);
+                mGpu->update();
+            }
+            if (renderPaused())
+            {
+                waitForEvent();
+                continue;
+            }
 
-            // Enforce speed limit
-            const float speed = vel.length();
-            if (speed > MAX_SPEED)
             {
-                vel *= (MAX_SPEED / (speed + 1e-2f));
+                FLOCK_PROFILE_SCOPE(Phase::Draw);
+                mWindow.clear(sf::Color::Black);
+                mWindow.setView(mView);
+                mGpu->draw(mWindow, mRenderer.circleTexture(), timestep.alpha());
             }
-            else if (speed < MIN_SPEED)
+            present();
+            if (!mIdle)
             {
-                vel *= (MIN_SPEED / (speed + 1e-2f));
+                governQuality();
             }
+        }
+    }
+#endif
 
-            // Update position
-            boid->move();
+    /**
+     * @brief	Draws the profiler overlay if it is on and shows the frame. While the overlay is on,
+     *          the window title carries the phase percentiles and what the renderer drew,
+     *          refreshed twice a second.
+     */
+    void present()
+    {
+        if (mShowOverlay)
+        {
+            mWindow.setView(mWindow.getDefaultView());
+            mOverlay.draw(mWindow);
+            if (mTitleClock.getElapsedTime().asSeconds() > 0.5f)
+            {
+                const RenderStats &drawn = mRenderer.stats();
+                std::string title = "Flocking Demo (SFML) - " + mOverlay.summaryText() +
+                                    " | drawn " + std::to_string(drawn.quads) + " discs, " +
+                                    std::to_string(drawn.points) + " points, " +
+                                    std::to_string(drawn.splats) + " splats";
+                if (mRecorder.isOpen())
+                {
+                    title += " | recorded " + std::to_string(mRecorder.recorded()) + ", dropped " +
+                             std::to_string(mRecorder.dropped());
+                }
+                mWindow.setTitle(title);
+                mTitleClock.restart();
+            }
         }
+
+        FLOCK_PROFILE_SCOPE(Phase::Display);
+        mWindow.display();
     }
 
     /**
-     * @brief	Draw all boids to an SFML window.
-     * @param	window	SFML render window.
+     * @brief	Feeds the last frame's phase timings to the governor and applies a new quality
+     *          level to the simulation and renderer. The simulation side is the time the ticks
+     *          due in one budget take, so it is over budget exactly when the simulation thread
+     *          falls behind. Without the profiling timers compiled in, nothing is measured and
+     *          the quality stays full.
      */
-    void draw(sf::RenderWindow *window)
+    void governQuality()
     {
-        for (auto &boid : mBoids)
+        const Profiler &profiler = Profiler::get();
+        const GovernorSettings &settings = mGovernor.settings();
+        // The wall time of a tick, which per-flock update times overstate when whole flocks run
+        // on separate threads.
+        const float tickMs = profiler.recentMean(Phase::Tick, 1) * 1e-3f;
+        const float simMs = tickMs * static_cast<float>(mTickRate) * settings.budgetMs * 1e-3f;
+        const float renderMs = (profiler.recentMean(Phase::Events, 1) +
+                                profiler.recentMean(Phase::Draw, 1)) *
+                               1e-3f;
+        if (mGovernor.update(simMs, renderMs))
         {
-            boid->draw(window);
+            applyQuality();
         }
+        mOverlay.setQuality(mGovernor.level(), mGovernor.enabled() ? QUALITY_LEVELS.size() : 0,
+                            mGovernor.load());
     }
 
     /**
-     * @brief	Add a boid to the flock.
-     * @param	x	        Initial X coordinate.
-     * @param	y	        Initial Y coordinate.
-     * @param	radius	    Radius.
-     * @param	color	    Color.
+     * @brief	Sends the governor's current level to the simulation and renderer.
      */
-    void addBoid(float x, float y, float radius, sf::Color color)
+    void applyQuality()
     {
-        mBoids.emplace_back(std::make_unique<Boid>(x, y, radius, color));
+        const QualityLevel &quality = mGovernor.quality();
+        std::cerr << "Quality level " << mGovernor.level() << ": stagger " << quality.stagger
+                  << ", neighbour cap " << quality.neighbourCap << ", render LOD "
+                  << quality.renderLod << "\n";
+        mRenderer.setLodScale(quality.renderLod);
+        send({SimCommand::Type::SetQuality, {}, static_cast<int>(mGovernor.level())});
     }
 
     /**
-     * @brief	Set the destination for all boids to move towards.
-     * @param	newDest	    New destination.
+     * @brief	Hands a command to whichever backend runs the flock.
+     * @param	command	    Command to apply.
      */
-    void setDest(sf::Vector2f newDest) { mDest = newDest; }
+    void send(const SimCommand &command)
+    {
+#ifdef FLOCK_HAVE_GPU
+        if (mGpu)
+        {
+            // Kernel, math mode, search, interaction selection, quality levels and snapshots
+            // only exist on the CPU. The GPU runs all boids as one flock with one destination.
+            if (command.type == SimCommand::Type::SetDest)
+            {
+                mGpu->setDest(command.dest);
+            }
+            else if (command.type == SimCommand::Type::Reset)
+            {
+                applyCommand(mWorld, command);
+                mWorld.gather(mGpuState);
+                mGpu->upload(mGpuState);
+            }
+            else if (command.type == SimCommand::Type::SetParams)
+            {
+                applyCommand(mWorld, command);
+                mGpu->setParams(command.params);
+            }
+            return;
+        }
+#endif
+        mSim->post(command);
+    }
 
     /**
-     * @brief	Removes all boids.
+     * @brief	Sends the rule constants file to the simulation if it was saved since the last
+     *          check. Checks a few times a second.
      */
-    void clear() { mBoids.clear(); }
+    void pollParams()
+    {
+        if (!mParamsFile || mParamsClock.getElapsedTime().asSeconds() < 0.25f)
+        {
+            return;
+        }
+        mParamsClock.restart();
 
-private:
-    static constexpr float AVOID_FACTOR = 0.5f;
-    static constexpr float VISUAL_RANGE = 20.f;
-    static constexpr float CENTERING_FACTOR = 0.0005f;
-    static constexpr float MATCHING_FACTOR = 0.05f;
-    static constexpr float MAX_SPEED = 6.f;
-    static constexpr float MIN_SPEED = 1.f;
-    static constexpr float BIAS_VAL = 0.005f;
-    static constexpr float NOISE_STRENGTH = 0.1f;
-
-    std::vector<std::unique_ptr<Boid>> mBoids;
-    sf::Vector2f mDest;
-};
+        if (mParamsFile->poll(mParams))
+        {
+            std::cerr << "Reloaded " << mParamsFile->path().string() << "\n";
+            send({SimCommand::Type::SetParams, {}, 0, mParams});
+        }
+    }
 
-/**
- * Runs a flock. Initializes the flock, adds boids, updates the flock based on
- * events, and draws it each frame to an SFML window.
- */
-class FlockingApp
-{
-public:
     /**
-     * @brief	Construct a new Flocking App object.
-     * @param	windowWidth	    Width in pixels of the SFML window.
-     * @param	windowHeight	Height in pixels of the SFML window.
-     * @param	flockSize	    Number of boids in the flock.
+     * @brief	Handles the pending SFML events.
      */
-    FlockingApp(unsigned int windowWidth, unsigned int windowHeight, unsigned int flockSize)
-        : mRng(time(nullptr)), mFlockSize(flockSize)
+    void handleEvents()
     {
-        mWindow =
-            sf::RenderWindow(sf::VideoMode({windowWidth, windowHeight}), "Flocking Demo (SFML)");
-        mWindow.setFramerateLimit(60);
-        mFlock = std::make_unique<Flock>();
-        createRandomFlock(flockSize);
+        FLOCK_PROFILE_SCOPE(Phase::Events);
+        pollParams();
+        while (const std::optional<sf::Event> event = mWindow.pollEvent())
+        {
+            handleEvent(*event);
+        }
     }
 
     /**
-     * @brief	Run the flocking app.
+     * @brief	Sleeps until an event arrives, and handles it, or until the next frame is due, for
+     *          frames run() or runGpu() skip. Without a frame limit that is a millisecond.
      */
-    void run()
+    void waitForEvent()
     {
-        while (mWindow.isOpen())
+        const unsigned int limit = mIdle ? mIdleFrameLimit : mFrameLimit;
+        const float seconds = renderPaused() ? IDLE_WAIT_SECONDS
+                              : limit > 0    ? 1.f / static_cast<float>(limit)
+                                             : 1e-3f;
+        if (const std::optional<sf::Event> event = mWindow.waitEvent(sf::seconds(seconds)))
         {
-            handleEvents();
+            handleEvent(*event);
+        }
+    }
 
-            mFlock->update();
+    /**
+     * @brief	Whether frames are skipped altogether: while hidden, or while unfocused with an idle
+     *          frame limit of 0.
+     */
+    bool renderPaused() const { return mHidden || (mIdle && mIdleFrameLimit == 0); }
 
-            mWindow.clear(sf::Color::Black);
-            mFlock->draw(&mWindow);
-            mWindow.display();
+    /**
+     * @brief	Switches between the normal and the idle frame limit and tick rate as the window
+     *          loses or regains focus or is hidden or shown. The simulation drops the time spent
+     *          at the old rate, so on return it continues from the current state instead of
+     *          replaying the ticks it skipped.
+     */
+    void updateIdle()
+    {
+        const bool idle = !mFocused || mHidden;
+        if (idle == mIdle)
+        {
+            return;
+        }
+        mIdle = idle;
+        // A limit of 0 is unlimited to SFML, but no frames at all here.
+        if (!idle || mIdleFrameLimit > 0)
+        {
+            mWindow.setFramerateLimit(idle ? mIdleFrameLimit : mFrameLimit);
+        }
+        mRunRate = idle && mIdleTicks ? *mIdleTicks : mTickRate;
+        if (mSim)
+        {
+            mSim->setTickRate(mRunRate);
+        }
+        if (idle)
+        {
+            std::cerr << "Idle: " << (renderPaused() ? 0 : mIdleFrameLimit) << " frames and "
+                      << mRunRate << " ticks per second\n";
+        }
+        else
+        {
+            std::cerr << "Active\n";
         }
     }
 
-private:
-    sf::RenderWindow mWindow;
-    std::unique_ptr<Flock> mFlock;
-    mutable std::mt19937 mRng;
-    unsigned int mFlockSize;
+    /**
+     * @brief	Handles one SFML event.
+     * @param	event	    Event to handle.
+     */
+    void handleEvent(const sf::Event &event)
+    {
+        if (event.is<sf::Event::Closed>())
+        {
+            mWindow.close();
+        }
+        else if (event.is<sf::Event::FocusLost>() || event.is<sf::Event::FocusGained>())
+        {
+            mFocused = event.is<sf::Event::FocusGained>();
+            updateIdle();
+        }
+        else if (const auto *resized = event.getIf<sf::Event::Resized>())
+        {
+            mHidden = resized->size.x == 0 || resized->size.y == 0;
+            updateIdle();
+        }
+        else if (const auto *mouseMoved = event.getIf<sf::Event::MouseMoved>())
+        {
+            const sf::Vector2f world = mWindow.mapPixelToCoords(mouseMoved->position, mView);
+            if (mPanning)
+            {
+                // Keep the point under the cursor fixed while dragging.
+                mView.move(mWindow.mapPixelToCoords(mPanFrom, mView) - world);
+                mPanFrom = mouseMoved->position;
+            }
+            else
+            {
+                const int flock = static_cast<int>(mActiveFlock);
+                send({SimCommand::Type::SetDest, toVec2(world), flock});
+            }
+        }
+        else if (const auto *wheel = event.getIf<sf::Event::MouseWheelScrolled>())
+        {
+            // Zoom about the cursor rather than the view centre.
+            const sf::Vector2f before = mWindow.mapPixelToCoords(wheel->position, mView);
+            mView.zoom(std::pow(ZOOM_STEP, -wheel->delta));
+            mView.move(before - mWindow.mapPixelToCoords(wheel->position, mView));
+        }
+        else if (const auto *pressed = event.getIf<sf::Event::MouseButtonPressed>())
+        {
+            if (pressed->button == sf::Mouse::Button::Right)
+            {
+                mPanning = true;
+                mPanFrom = pressed->position;
+            }
+        }
+        else if (const auto *released = event.getIf<sf::Event::MouseButtonReleased>())
+        {
+            if (released->button == sf::Mouse::Button::Right)
+            {
+                mPanning = false;
+            }
+        }
+        else if (const auto *keyPressed = event.getIf<sf::Event::KeyPressed>())
+        {
+            if (keyPressed->scancode == sf::Keyboard::Scancode::R)
+            {
+                send({SimCommand::Type::Reset});
+            }
+            else if (keyPressed->scancode == sf::Keyboard::Scancode::B)
+            {
+                const bool batched = mRenderer.mode() == RenderMode::Batched;
+                mRenderer.setMode(batched ? RenderMode::PerBoid : RenderMode::Batched);
+            }
+            else if (keyPressed->scancode == sf::Keyboard::Scancode::K)
+            {
+                mSimd = !mSimd;
+                const Isa isa = mSimd ? bestIsa() : Isa::Scalar;
+                send({SimCommand::Type::SetIsa, {}, static_cast<int>(isa)});
+            }
+            else if (keyPressed->scancode == sf::Keyboard::Scancode::F)
+            {
+                mFastMath = !mFastMath;
+                const MathMode math = mFastMath ? MathMode::Fast : MathMode::Exact;
+                send({SimCommand::Type::SetMathMode, {}, static_cast<int>(math)});
+            }
+            else if (keyPressed->scancode == sf::Keyboard::Scancode::L)
+            {
+                mCompact = !mCompact;
+                const BoidLayout layout = mCompact ? BoidLayout::Compact : BoidLayout::Float;
+                send({SimCommand::Type::SetLayout, {}, static_cast<int>(layout)});
+            }
+            else if (keyPressed->scancode == sf::Keyboard::Scancode::Q)
+            {
+                mGovernor.setEnabled(!mGovernor.enabled());
+                applyQuality();
+            }
+            else if (keyPressed->scancode == sf::Keyboard::Scancode::P)
+            {
+                mShowOverlay = !mShowOverlay;
+                if (!mShowOverlay)
+                {
+                    mWindow.setTitle("Flocking Demo (SFML)");
+                }
+            }
+            else if (keyPressed->scancode == sf::Keyboard::Scancode::T)
+            {
+                toggleTrace();
+            }
+            else if (keyPressed->scancode == sf::Keyboard::Scancode::Home)
+            {
+                mView = mWindow.getDefaultView();
+            }
+            else if (keyPressed->scancode == sf::Keyboard::Scancode::S)
+            {
+                send({SimCommand::Type::SaveSnapshot});
+            }
+            else if (keyPressed->scancode == sf::Keyboard::Scancode::I)
+            {
+                mInteract = !mInteract;
+                send({SimCommand::Type::SetInteraction, {}, mInteract});
+            }
+            else if (keyPressed->scancode >= sf::Keyboard::Scancode::Num1 &&
+                     keyPressed->scancode <= sf::Keyboard::Scancode::Num9)
+            {
+                // Number keys pick the flock the mouse steers.
+                const unsigned int f = static_cast<unsigned int>(keyPressed->scancode) -
+                                       static_cast<unsigned int>(sf::Keyboard::Scancode::Num1);
+                mActiveFlock = std::min(f, mFlockCount - 1);
+            }
+            else if (keyPressed->scancode == sf::Keyboard::Scancode::G)
+            {
+                // Grid -> Verlet -> brute force -> grid.
+                mSearch = mSearch == NeighbourSearch::Grid     ? NeighbourSearch::Verlet
+                          : mSearch == NeighbourSearch::Verlet ? NeighbourSearch::BruteForce
+                                                               : NeighbourSearch::Grid;
+                send(
+                    {SimCommand::Type::SetNeighbourSearch, {}, static_cast<int>(mSearch)});
+            }
+        }
+    }
 
     /**
-     * @brief	Handles SFML events.
+     * @brief	Starts a trace of every profiled scope, or stops the running one and writes it to
+     *          TRACE_PATH for chrome://tracing or Perfetto.
      */
-    void handleEvents()
+    void toggleTrace()
     {
-        while (const std::optional<sf::Event> event = mWindow.pollEvent())
+        Profiler &profiler = Profiler::get();
+        if (!profiler.tracing())
+        {
+            profiler.startTrace();
+            std::cerr << "Tracing...\n";
+        }
+        else if (profiler.stopTrace(TRACE_PATH))
         {
-            if (event->is<sf::Event::Closed>())
+            std::cerr << "Wrote " << TRACE_PATH << "\n";
+        }
+        else
+        {
+            std::cerr << "Could not write " << TRACE_PATH << "\n";
+        }
+    }
+
+    /**
+     * @brief	Applies a command from handleEvents(). Runs on the simulation thread.
+     * @param	world	    The simulated flocks.
+     * @param	command	    Command to apply.
+     */
+    void applyCommand(World &world, const SimCommand &command)
+    {
+        if (command.type == SimCommand::Type::SetDest)
+        {
+            world.flock(command.value).setDest(command.dest);
+            return;
+        }
+        if (command.type == SimCommand::Type::Reset)
+        {
+            createRandomFlocks();
+            return;
+        }
+        if (command.type == SimCommand::Type::SaveSnapshot)
+        {
+            // Writes on the simulation thread, so the world is between ticks.
+            std::string error;
+            if (saveSnapshot(world, SNAPSHOT_PATH, error))
             {
-                mWindow.close();
+                std::cerr << "Wrote " << SNAPSHOT_PATH << "\n";
             }
-            else if (const auto *mouseMoved = event->getIf<sf::Event::MouseMoved>())
+            else
             {
-                mFlock->setDest(sf::Vector2f{mouseMoved->position});
+                std::cerr << error << "\n";
             }
-            else if (const auto *keyPressed = event->getIf<sf::Event::KeyPressed>())
+            return;
+        }
+        if (command.type == SimCommand::Type::SetInteraction)
+        {
+            for (size_t i = 0; i < world.flockCount(); i++)
             {
-                if (keyPressed->scancode == sf::Keyboard::Scancode::R)
+                for (size_t j = 0; j < world.flockCount(); j++)
                 {
-                    mFlock->clear();
-                    createRandomFlock(mFlockSize);
+                    world.setInteraction(i, j, i == j || command.value != 0);
                 }
             }
+            return;
+        }
+
+        // Everything else applies to every flock.
+        for (size_t f = 0; f < world.flockCount(); f++)
+        {
+            Flock &flock = world.flock(f);
+            switch (command.type)
+            {
+            case SimCommand::Type::SetNeighbourSearch:
+                flock.setNeighbourSearch(static_cast<NeighbourSearch>(command.value));
+                break;
+            case SimCommand::Type::SetIsa:
+                flock.setIsa(static_cast<Isa>(command.value));
+                break;
+            case SimCommand::Type::SetMathMode:
+                flock.setMathMode(static_cast<MathMode>(command.value));
+                break;
+            case SimCommand::Type::SetLayout:
+                flock.setLayout(static_cast<BoidLayout>(command.value));
+                break;
+            case SimCommand::Type::SetQuality:
+                flock.setStagger(QUALITY_LEVELS[command.value].stagger);
+                flock.setNeighbourCap(QUALITY_LEVELS[command.value].neighbourCap);
+                break;
+            case SimCommand::Type::SetParams:
+                flock.setParams(command.params);
+                break;
+            default:
+                break;
+            }
         }
     }
 
     /**
-     * @brief	Adds n flock objects at a random position in the window with a random radius and
-     *          random color.
-     * @param	n
+     * @brief	Replaces the boids of every flock with mFlockSize boids in total, split evenly, drawn
+     *          from mSpawn with a random radius and random color.
      */
-    void createRandomFlock(unsigned int n)
+    void createRandomFlocks()
     {
-        for (int i = 0; i < n; i++)
+        for (unsigned int f = 0; f < mFlockCount; f++)
         {
-            auto rand = [&](uint64_t min, uint64_t max) { return mRng() % (max - min) + min; };
+            Flock &flock = mWorld.flock(f);
+            flock.clear();
+            mSpawn.seed = noiseKey(mSeed, mSpawns++);
+            flock.spawn(mFlockSize / mFlockCount + (f < mFlockSize % mFlockCount), mSpawn, &mPool);
+        }
+    }
 
-            int x = rand(0, mWindow.getSize().x);
-            int y = rand(0, mWindow.getSize().y);
-            int radius = rand(2, 8);
-            int r = rand(0, 255);
-            int g = rand(0, 255);
-            int b = rand(0, 255);
-            mFlock->addBoid(x, y, radius, sf::Color(r, g, b));
+    /**
+     * @brief	Reads an image as a spawn density, one cell per pixel, brighter and more opaque
+     *          pixels drawing more boids.
+     * @param	path	    Image file, in any format SFML reads.
+     * @param	density	    Receives the density.
+     * @return	false if the image can't be read.
+     */
+    static bool loadDensity(const std::string &path, DensityMap &density)
+    {
+        sf::Image image;
+        if (!image.loadFromFile(path))
+        {
+            return false;
         }
+        density.width = image.getSize().x;
+        density.height = image.getSize().y;
+        density.weight.resize(size_t{density.width} * density.height);
+        const uint8_t *rgba = image.getPixelsPtr();
+        for (size_t c = 0; c < density.weight.size(); c++)
+        {
+            const uint8_t *p = rgba + 4 * c;
+            const float luma = 0.2126f * p[0] + 0.7152f * p[1] + 0.0722f * p[2];
+            density.weight[c] = luma * p[3];
+        }
+        return true;
     }
 };
 
-int main()
+// Exit code of verifyGpu() when there is no GL 4.3 context to test, which CTest counts as skipped.
+static constexpr int VERIFY_SKIPPED = 77;
+
+/**
+ * @brief	Checks the GPU backend against the CPU: warms a seeded flock up on the CPU, then runs
+ *          one tick of it in compute shaders and one with the scalar brute-force search, and
+ *          compares the velocities boid by boid. Uses the default rule constants, since the GPU
+ *          has no far field. Prints the errors as JSON, like flock_bench --verify does for the
+ *          CPU kernels.
+ * @param	settings	Boid count, seed, world size and placement.
+ * @return	Exit code: 0 if the GPU is within tolerance, 1 if not, VERIFY_SKIPPED if it can't
+ *          run here.
+ */
+static int verifyGpu(const AppSettings &settings)
 {
-    FlockingApp app(1524, 1024, 300);
+#ifdef FLOCK_HAVE_GPU
+    // Ticks before the check, so the boids move and have neighbours to agree on.
+    constexpr unsigned int WARMUP = 20;
+    // Fractions of maxSpeed. The shaders' length() and exp2() are only as exact as the driver's,
+    // about as far off as the fast math kernels.
+    constexpr double MAX_TOLERANCE = 0.05;
+    constexpr double MEAN_TOLERANCE = 2e-4;
+
+    const uint32_t seed = settings.seed.value_or(1);
+    const Vec2 worldSize(static_cast<float>(settings.windowWidth),
+                         static_cast<float>(settings.windowHeight));
+    Flock flock;
+    SpawnDistribution spawn;
+    spawn.shape = settings.spawn;
+    spawn.max = worldSize;
+    spawn.seed = noiseKey(seed, 0);
+    flock.setSeed(noiseKey(seed, 0));
+    flock.spawn(settings.flockSize, spawn);
+    flock.setDest(worldSize * 0.5f);
+    for (unsigned int t = 0; t < WARMUP; t++)
+    {
+        flock.update();
+    }
+
+    // In id order, so GPU slot k draws the noise of id k.
+    const FlockState &warm = flock.state();
+    FlockState start = warm;
+    for (uint32_t k = 0; k < warm.size(); k++)
+    {
+        const uint32_t slot = flock.slotOf(k);
+        start.posX[k] = warm.posX[slot];
+        start.posY[k] = warm.posY[slot];
+        start.velX[k] = warm.velX[slot];
+        start.velY[k] = warm.velY[slot];
+        start.radius[k] = warm.radius[slot];
+        start.color[k] = warm.color[slot];
+        start.id[k] = k;
+    }
+
+    Flock reference;
+    reference.setState(start);
+    reference.setDest(flock.dest());
+    reference.setSeed(flock.seed(), flock.tick());
+    reference.setNeighbourSearch(NeighbourSearch::BruteForce);
+    reference.setIsa(Isa::Scalar);
+    reference.setMathMode(MathMode::Exact);
+    reference.update();
+
+#if defined(__unix__) && !defined(__APPLE__)
+    // SFML aborts when it can't open a display, so don't let it try.
+    if (!std::getenv("DISPLAY") && !std::getenv("WAYLAND_DISPLAY"))
+    {
+        std::cerr << "No display to create a GL context on, skipping\n";
+        return VERIFY_SKIPPED;
+    }
+#endif
+    sf::ContextSettings contextSettings;
+    contextSettings.majorVersion = 4;
+    contextSettings.minorVersion = 3;
+    sf::Context context(contextSettings, {1, 1});
+    GpuFlock gpu(worldSize, flock.seed());
+    if (!context.setActive(true) || !gpu.init(context.getSettings()))
+    {
+        std::cerr << "GPU backend unavailable (" << gpu.error() << "), skipping\n";
+        return VERIFY_SKIPPED;
+    }
+    gpu.setParams(DEFAULT_PARAMS);
+    gpu.setDest(flock.dest());
+    gpu.setNoise(flock.seed(), static_cast<uint32_t>(flock.tick()));
+    gpu.upload(start);
+    gpu.update();
+    FlockState got = start;
+    gpu.download(got);
+
+    const FlockState &want = reference.state();
+    double maxError = 0.0;
+    double sumError = 0.0;
+    for (uint32_t k = 0; k < got.size(); k++)
+    {
+        const uint32_t slot = reference.slotOf(k);
+        const double error = std::hypot(got.velX[k] - want.velX[slot],
+                                        got.velY[k] - want.velY[slot]) /
+                             DEFAULT_PARAMS.maxSpeed;
+        maxError = std::max(maxError, error);
+        sumError += error;
+    }
+    const double meanError = sumError / std::max<size_t>(got.size(), 1);
+    const bool pass = maxError <= MAX_TOLERANCE && meanError <= MEAN_TOLERANCE;
+    std::printf("{\"backend\": \"gpu\", \"boids\": %zu, \"seed\": %u, \"max_error\": %.3g, "
+                "\"mean_error\": %.3g, \"max_tolerance\": %.3g, \"mean_tolerance\": %.3g, "
+                "\"pass\": %s}\n",
+                got.size(), seed, maxError, meanError, MAX_TOLERANCE, MEAN_TOLERANCE,
+                pass ? "true" : "false");
+    return pass ? 0 : 1;
+#else
+    (void)settings;
+    std::cerr << "Built without FLOCK_ENABLE_GPU, nothing to verify\n";
+    return VERIFY_SKIPPED;
+#endif
+}
+
+int main(int argc, char **argv)
+{
+    AppSettings settings;
+    bool verify = false;
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string_view arg = argv[i];
+        if (arg == "--gpu")
+        {
+            settings.gpu = true;
+        }
+        else if (arg == "--verify-gpu")
+        {
+            verify = true;
+        }
+        else if (arg == "--boids" && i + 1 < argc)
+        {
+            settings.flockSize = static_cast<unsigned int>(std::strtoul(argv[++i], nullptr, 10));
+        }
+        else if (arg == "--flocks" && i + 1 < argc)
+        {
+            settings.flocks = static_cast<unsigned int>(std::strtoul(argv[++i], nullptr, 10));
+        }
+        else if (arg == "--seed" && i + 1 < argc)
+        {
+            settings.seed = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        }
+        else if (arg == "--load" && i + 1 < argc)
+        {
+            settings.snapshotPath = argv[++i];
+        }
+        else if (arg == "--params" && i + 1 < argc)
+        {
+            settings.paramsPath = argv[++i];
+        }
+        else if (arg == "--record" && i + 1 < argc)
+        {
+            settings.recordPath = argv[++i];
+        }
+        else if (arg == "--spawn" && i + 1 < argc)
+        {
+            const std::string_view shape = argv[++i];
+            settings.spawn = shape == "clusters" ? SpawnShape::Clusters
+                             : shape == "ring"   ? SpawnShape::Ring
+                                                 : SpawnShape::Uniform;
+        }
+        else if (arg == "--budget" && i + 1 < argc)
+        {
+            settings.budgetMs = std::strtof(argv[++i], nullptr);
+        }
+        else if (arg == "--hysteresis" && i + 1 < argc)
+        {
+            settings.hysteresis = std::clamp(std::strtof(argv[++i], nullptr), 0.f, 0.9f);
+        }
+        else if (arg == "--no-governor")
+        {
+            settings.governor = false;
+        }
+        else if (arg == "--idle-fps" && i + 1 < argc)
+        {
+            settings.idleFrameLimit =
+                static_cast<unsigned int>(std::strtoul(argv[++i], nullptr, 10));
+        }
+        else if (arg == "--idle-tick-rate" && i + 1 < argc)
+        {
+            settings.idleTicks = std::max(std::strtod(argv[++i], nullptr), 0.0);
+        }
+        else if (arg == "--spawn-image" && i + 1 < argc)
+        {
+            settings.spawnImage = argv[++i];
+        }
+    }
+
+    if (verify)
+    {
+        return verifyGpu(settings);
+    }
+
+    FlockingApp app(settings);
     app.run();
 
     return 0;
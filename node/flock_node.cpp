@@ -0,0 +1,498 @@
+/**
+ * One rank of a distributed flock simulation. The world is split into tiles, each owned by one
+ * rank, which exchange halo boids and migrants every tick over TCP, MPI or, with --local, threads
+ * of this process. Rank 0 periodically gathers a down-sampled preview of every tile and prints
+ * progress and the preview's size as JSON lines; nothing draws the preview yet. --verify checks
+ * the tiles against a single flock instead, see verifyTiles().
+ */
+
+#include "core/counter_rng.hpp"
+#include "core/flock_params.hpp"
+#include "core/spawn.hpp"
+#include "core/thread_pool.hpp"
+#include "core/tile_domain.hpp"
+#include "core/transport.hpp"
+
+#ifdef FLOCK_HAVE_MPI
+#include <mpi.h>
+#endif
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+/**
+ * Settings shared by every rank of a run.
+ */
+struct NodeConfig
+{
+    unsigned int boids = 100000; // Total over all tiles.
+    unsigned int ticks = 200;
+    uint32_t seed = 1;
+    unsigned int width = 1524;
+    unsigned int height = 1024;
+    unsigned int cols = 2;
+    unsigned int rows = 2;
+    unsigned int threads = 1;        // Per rank.
+    unsigned int previewEvery = 50;  // Ticks between previews, 0 only after the last.
+    unsigned int previewStride = 64; // One boid in this many is previewed.
+    std::optional<FlockParams> params;
+    bool verify = false; // Compare a --local run with one flock instead, see verifyTiles().
+
+    enum class Mode
+    {
+        Tcp,
+        Local,
+        Mpi,
+    } mode = Mode::Tcp;
+    unsigned int rank = 0;          // TCP only.
+    std::vector<std::string> peers; // TCP only: host:port of every rank.
+};
+
+/**
+ * @brief	Split of the world of config, the same on every rank.
+ */
+static TileLayout layoutOf(const NodeConfig &config)
+{
+    return {{0.f, 0.f},
+            {static_cast<float>(config.width), static_cast<float>(config.height)},
+            config.cols,
+            config.rows,
+            8.f};
+}
+
+/**
+ * @brief	Draws the whole flock the way flock_bench does, global id i for the i-th boid, and
+ *          calls fn with each boid of the given tile, or of every tile for a tile of SIZE_MAX.
+ *          Every rank draws them all and keeps its own tile, so the start matches a
+ *          single-process run with the same seed.
+ * @param	fn	        Callable taking (const SpawnedBoid &boid, uint32_t globalId).
+ */
+template <typename Fn>
+static void spawnBoids(const NodeConfig &config, const TileLayout &layout, size_t tile, Fn &&fn)
+{
+    SpawnDistribution distribution;
+    distribution.min = layout.min;
+    distribution.max = layout.max;
+    distribution.seed = noiseKey(config.seed, 0);
+    const Spawner spawner(distribution);
+    for (unsigned int i = 0; i < config.boids; i++)
+    {
+        const SpawnedBoid boid = spawner.boid(i);
+        if (tile == SIZE_MAX || layout.tileOf(boid.pos) == tile)
+        {
+            fn(boid, i);
+        }
+    }
+}
+
+/**
+ * @brief	Runs the tile of one rank to completion.
+ * @param	transport	Ranks of the run.
+ * @param	config	    Run settings.
+ * @return	Process exit code.
+ */
+static int runRank(Transport &transport, const NodeConfig &config)
+{
+    const TileLayout layout = layoutOf(config);
+    const size_t rank = transport.rank();
+    TileNode node(layout, rank);
+    Flock &flock = node.flock();
+    if (config.params)
+    {
+        flock.setParams(*config.params);
+    }
+    flock.setSeed(noiseKey(config.seed, static_cast<uint32_t>(rank)));
+    flock.setDest({config.width / 2.f, config.height / 2.f});
+    spawnBoids(config, layout, rank,
+               [&](const SpawnedBoid &boid, uint32_t globalId)
+               { node.addBoid(boid.pos.x, boid.pos.y, boid.radius, boid.color, globalId); });
+
+    std::unique_ptr<ThreadPool> pool;
+    if (config.threads != 1)
+    {
+        pool = std::make_unique<ThreadPool>(config.threads);
+    }
+
+    std::string error;
+    std::vector<PreviewBoid> preview;
+    auto since = std::chrono::steady_clock::now();
+    unsigned int ticksSince = 0;
+    for (unsigned int t = 1; t <= config.ticks; t++)
+    {
+        if (!node.step(transport, pool.get(), error))
+        {
+            std::fprintf(stderr, "rank %zu: %s\n", rank, error.c_str());
+            return 1;
+        }
+        ticksSince++;
+
+        const bool due = config.previewEvery != 0 && t % config.previewEvery == 0;
+        if (!due && t != config.ticks)
+        {
+            continue;
+        }
+        uint64_t total = 0;
+        if (!node.gatherPreview(transport, config.previewStride, preview, total, error))
+        {
+            std::fprintf(stderr, "rank %zu: %s\n", rank, error.c_str());
+            return 1;
+        }
+        const auto now = std::chrono::steady_clock::now();
+        if (rank == 0)
+        {
+            const double ms = std::chrono::duration<double, std::milli>(now - since).count();
+            std::printf("{\"tick\": %u, \"tiles\": %zu, \"boids\": %llu, \"preview_boids\": %zu, "
+                        "\"ms_per_tick\": %.3f, \"rank0_ghosts\": %zu, \"rank0_migrated\": %zu}\n",
+                        t, transport.size(), static_cast<unsigned long long>(total),
+                        preview.size(), ms / ticksSince, node.ghosts(), node.migrated());
+            std::fflush(stdout);
+        }
+        since = now;
+        ticksSince = 0;
+    }
+    return 0;
+}
+
+/**
+ * @brief	Warms one Flock holding every boid up for --ticks ticks, splits its state between the
+ *          tiles of a --local run and has both run VERIFY_TICKS more, then compares the
+ *          velocities boid by boid through the global ids. Noise is turned off, since the tiles
+ *          key it on ids that migrations renumber; what remains is the same Jacobi update, which
+ *          the tiles only sum in a different order. Prints the errors as JSON.
+ * @return	Process exit code, 1 if the tiles are out of tolerance or the run failed.
+ */
+static int verifyTiles(NodeConfig config)
+{
+    // The flocking rules amplify rounding differences several times over each tick, so only a
+    // few ticks can be compared. The second one has boids that crossed a border migrate.
+    constexpr unsigned int VERIFY_TICKS = 2;
+    // Fractions of maxSpeed. flock_bench --verify allows a tenth of the maximum for one tick; a
+    // dense flock amplifies that much in the second. A lost ghost shows in the mean first.
+    constexpr double MAX_TOLERANCE = 1e-2;
+    constexpr double MEAN_TOLERANCE = 1e-5;
+
+    FlockParams params = config.params.value_or(DEFAULT_PARAMS);
+    params.noiseStrength = 0.f;
+    const TileLayout layout = layoutOf(config);
+    const size_t tiles = layout.tileCount();
+
+    Flock reference;
+    reference.setParams(params);
+    reference.setUpdateScheme(UpdateScheme::DoubleBuffered);
+    reference.setDest({config.width / 2.f, config.height / 2.f});
+    spawnBoids(config, layout, SIZE_MAX, [&](const SpawnedBoid &boid, uint32_t)
+               { reference.addBoid(boid.pos.x, boid.pos.y, boid.radius, boid.color); });
+    for (unsigned int t = 0; t < config.ticks; t++)
+    {
+        reference.update();
+    }
+
+    // The reference's ids are the global ids, since boid i was added i-th.
+    const FlockState &start = reference.state();
+    std::vector<FlockState> parts(tiles);
+    std::vector<std::vector<uint32_t>> partIds(tiles);
+    for (uint32_t k = 0; k < start.size(); k++)
+    {
+        const size_t tile = layout.tileOf({start.posX[k], start.posY[k]});
+        parts[tile].add(start.posX[k], start.posY[k], start.radius[k], start.color[k]);
+        parts[tile].velX.back() = start.velX[k];
+        parts[tile].velY.back() = start.velY[k];
+        partIds[tile].push_back(start.id[k]);
+    }
+
+    // Each rank writes the boids it ends up owning, which no other rank owns.
+    std::vector<Vec2> vel(config.boids);
+    std::vector<uint8_t> owned(config.boids, 0);
+    std::atomic<int> status{0};
+    {
+        LocalHub hub(tiles);
+        std::vector<std::thread> ranks;
+        for (size_t r = 0; r < tiles; r++)
+        {
+            ranks.emplace_back(
+                [&, r]
+                {
+                    TileNode node(layout, r);
+                    node.flock().setParams(params);
+                    node.flock().setDest(reference.dest());
+                    node.addBoids(parts[r], partIds[r]);
+                    std::unique_ptr<ThreadPool> pool;
+                    if (config.threads != 1)
+                    {
+                        pool = std::make_unique<ThreadPool>(config.threads);
+                    }
+                    std::string error;
+                    for (unsigned int t = 0; t < VERIFY_TICKS; t++)
+                    {
+                        if (!node.step(hub.transport(r), pool.get(), error))
+                        {
+                            std::fprintf(stderr, "rank %zu: %s\n", r, error.c_str());
+                            status = 1;
+                            return;
+                        }
+                    }
+                    const FlockState &state = node.flock().state();
+                    for (uint32_t k = 0; k < state.size(); k++)
+                    {
+                        const uint32_t id = node.globalId(k);
+                        vel[id] = {state.velX[k], state.velY[k]};
+                        owned[id]++;
+                    }
+                });
+        }
+        for (std::thread &rank : ranks)
+        {
+            rank.join();
+        }
+    }
+    if (status != 0)
+    {
+        return 1;
+    }
+    for (unsigned int t = 0; t < VERIFY_TICKS; t++)
+    {
+        reference.update();
+    }
+
+    const FlockState &want = reference.state();
+    const double scale = 1.0 / std::max(params.maxSpeed, 1e-6f);
+    double maxError = 0.0;
+    double sumError = 0.0;
+    bool complete = true;
+    for (uint32_t id = 0; id < config.boids; id++)
+    {
+        complete = complete && owned[id] == 1;
+        const uint32_t slot = reference.slotOf(id);
+        const double error =
+            scale * std::hypot(vel[id].x - want.velX[slot], vel[id].y - want.velY[slot]);
+        maxError = std::max(maxError, error);
+        sumError += error;
+    }
+    const double meanError = sumError / std::max(config.boids, 1u);
+    const bool pass = complete && maxError <= MAX_TOLERANCE && meanError <= MEAN_TOLERANCE;
+    std::printf("{\"tiles\": %zu, \"boids\": %u, \"warmup\": %u, \"ticks\": %u, \"seed\": %u, "
+                "\"complete\": %s, \"max_error\": %.3g, \"mean_error\": %.3g, "
+                "\"max_tolerance\": %.3g, \"mean_tolerance\": %.3g, \"pass\": %s}\n",
+                tiles, config.boids, config.ticks, VERIFY_TICKS, config.seed,
+                complete ? "true" : "false", maxError, meanError, MAX_TOLERANCE, MEAN_TOLERANCE,
+                pass ? "true" : "false");
+    return pass ? 0 : 1;
+}
+
+static void printUsage()
+{
+    std::fprintf(stderr,
+                 "usage: flock_node [--tiles CxR] [--boids N] [--ticks N] [--seed N]\n"
+                 "                  [--width N] [--height N] [--threads N] [--params FILE]\n"
+                 "                  [--preview-every N] [--preview-stride N]\n"
+                 "                  (--local | --mpi | --rank R --peers HOST:PORT,... | --verify)\n"
+                 "\n"
+                 "Splits the world into C x R tiles, one per rank. --local runs every rank as\n"
+                 "a thread of this process. --mpi takes the ranks of MPI_COMM_WORLD, if built\n"
+                 "with the experimental FLOCK_ENABLE_MPI. Otherwise start one process per tile\n"
+                 "with the same --peers list, rank R listening on the R-th endpoint. --boids is\n"
+                 "the total, --threads is per rank. Rank 0 prints progress and the size of a\n"
+                 "preview of one boid in --preview-stride every --preview-every ticks.\n"
+                 "--verify instead warms one flock up for --ticks ticks, splits it between\n"
+                 "the tiles of a --local run, runs both two more ticks without noise and\n"
+                 "compares the velocities boid by boid. It prints the errors as JSON and exits\n"
+                 "with 1 if any is out of tolerance.\n");
+}
+
+/**
+ * @brief	Parses the command line into config.
+ * @return	false on an unknown or malformed argument.
+ */
+static bool parseArgs(int argc, char **argv, NodeConfig &config)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string_view arg = argv[i];
+        if (arg == "--local")
+        {
+            config.mode = NodeConfig::Mode::Local;
+            continue;
+        }
+        if (arg == "--mpi")
+        {
+            config.mode = NodeConfig::Mode::Mpi;
+            continue;
+        }
+        if (arg == "--verify")
+        {
+            config.verify = true;
+            continue;
+        }
+
+        if (i + 1 >= argc)
+        {
+            return false;
+        }
+        const std::string_view value = argv[++i];
+        auto number = [&]
+        { return static_cast<unsigned int>(std::strtoul(value.data(), nullptr, 10)); };
+
+        if (arg == "--tiles")
+        {
+            char *end = nullptr;
+            config.cols = static_cast<unsigned int>(std::strtoul(value.data(), &end, 10));
+            if (*end != 'x')
+            {
+                return false;
+            }
+            config.rows = static_cast<unsigned int>(std::strtoul(end + 1, nullptr, 10));
+            if (config.cols == 0 || config.rows == 0)
+            {
+                return false;
+            }
+        }
+        else if (arg == "--boids")
+        {
+            config.boids = number();
+        }
+        else if (arg == "--ticks")
+        {
+            config.ticks = number();
+        }
+        else if (arg == "--seed")
+        {
+            config.seed = number();
+        }
+        else if (arg == "--width")
+        {
+            config.width = std::max(number(), 1u);
+        }
+        else if (arg == "--height")
+        {
+            config.height = std::max(number(), 1u);
+        }
+        else if (arg == "--threads")
+        {
+            config.threads = number();
+        }
+        else if (arg == "--preview-every")
+        {
+            config.previewEvery = number();
+        }
+        else if (arg == "--preview-stride")
+        {
+            config.previewStride = std::max(number(), 1u);
+        }
+        else if (arg == "--rank")
+        {
+            config.rank = number();
+        }
+        else if (arg == "--peers")
+        {
+            config.peers.clear();
+            for (size_t begin = 0; begin <= value.size();)
+            {
+                const size_t comma = std::min(value.find(',', begin), value.size());
+                config.peers.emplace_back(value.substr(begin, comma - begin));
+                begin = comma + 1;
+            }
+        }
+        else if (arg == "--params")
+        {
+            std::string error;
+            FlockParams params;
+            if (!loadParams(std::string(value), params, error))
+            {
+                std::fprintf(stderr, "%s\n", error.c_str());
+                return false;
+            }
+            config.params = params;
+        }
+        else
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    NodeConfig config;
+    if (!parseArgs(argc, argv, config))
+    {
+        printUsage();
+        return 1;
+    }
+    const size_t tiles = size_t{config.cols} * config.rows;
+    if (config.verify)
+    {
+        return verifyTiles(config);
+    }
+
+    if (config.mode == NodeConfig::Mode::Local)
+    {
+        LocalHub hub(tiles);
+        std::atomic<int> status{0};
+        std::vector<std::thread> ranks;
+        for (size_t r = 0; r < tiles; r++)
+        {
+            ranks.emplace_back(
+                [&, r]
+                {
+                    if (runRank(hub.transport(r), config) != 0)
+                    {
+                        status = 1;
+                    }
+                });
+        }
+        for (std::thread &rank : ranks)
+        {
+            rank.join();
+        }
+        return status;
+    }
+
+    if (config.mode == NodeConfig::Mode::Mpi)
+    {
+#ifdef FLOCK_HAVE_MPI
+        MPI_Init(&argc, &argv);
+        MpiTransport transport;
+        int status = 1;
+        if (transport.size() != tiles)
+        {
+            std::fprintf(stderr, "%zu tiles need %zu MPI ranks, got %zu\n", tiles, tiles,
+                         transport.size());
+        }
+        else
+        {
+            status = runRank(transport, config);
+        }
+        MPI_Finalize();
+        return status;
+#else
+        std::fprintf(stderr, "built without FLOCK_ENABLE_MPI\n");
+        return 1;
+#endif
+    }
+
+    if (config.peers.size() != tiles)
+    {
+        std::fprintf(stderr, "%zu tiles need %zu --peers endpoints, got %zu\n", tiles, tiles,
+                     config.peers.size());
+        return 1;
+    }
+    TcpTransport transport;
+    std::string error;
+    if (!transport.open(config.peers, config.rank, error))
+    {
+        std::fprintf(stderr, "rank %u: %s\n", config.rank, error.c_str());
+        return 1;
+    }
+    return runRank(transport, config);
+}
@@ -0,0 +1,81 @@
+/**
+ * Checks the back-off of QualityGovernor: a step up that bounces straight back down doubles the
+ * wait before the next step up from that level, and one that holds resets it. Exits non-zero on
+ * the first failed check.
+ */
+
+#include "core/quality_governor.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+
+static constexpr unsigned int HOLD = 4;
+static constexpr float OVER = 20.f;  // Over the 10 ms budget.
+static constexpr float SPARE = 5.f;  // Under budget by more than the hysteresis.
+static constexpr float INSIDE = 9.f; // Under budget, but not by enough to step up.
+
+/**
+ * @brief	Feeds frames of one cost until the level changes.
+ * @return	The number of frames fed, or limit + 1 if the level did not change within limit.
+ */
+static unsigned int framesToChange(QualityGovernor &governor, float costMs, unsigned int limit)
+{
+    for (unsigned int frame = 1; frame <= limit; frame++)
+    {
+        if (governor.update(costMs, 0.f))
+        {
+            return frame;
+        }
+    }
+    return limit + 1;
+}
+
+static void expect(bool ok, const char *what)
+{
+    if (!ok)
+    {
+        std::fprintf(stderr, "quality_governor_test: %s\n", what);
+        std::exit(1);
+    }
+}
+
+int main()
+{
+    GovernorSettings settings;
+    settings.budgetMs = 10.f;
+    settings.hysteresis = 0.25f;
+    settings.holdFrames = HOLD;
+    settings.smoothing = 1.f; // The cost of each frame as it is, so steps land on exact frames.
+    QualityGovernor governor(settings);
+    const unsigned int limit = 100 * HOLD;
+
+    expect(framesToChange(governor, OVER, limit) == HOLD, "first step down after holdFrames");
+    expect(governor.level() == 1, "first step down lands on level 1");
+    expect(framesToChange(governor, SPARE, limit) == HOLD, "first step up after holdFrames");
+    expect(governor.level() == 0, "first step up lands on level 0");
+
+    // Each bounce doubles the wait on level 1, up to 64 * holdFrames.
+    unsigned int wait = HOLD;
+    for (int bounce = 0; bounce < 8; bounce++)
+    {
+        expect(framesToChange(governor, OVER, limit) == HOLD, "bounce steps down after holdFrames");
+        wait = wait * 2 > 64 * HOLD ? 64 * HOLD : wait * 2;
+        expect(framesToChange(governor, SPARE, limit) == wait, "bounce doubles the wait");
+    }
+    expect(wait == 64 * HOLD, "wait reaches its cap");
+
+    // A step down exactly 2 * holdFrames after the step up is no bounce, so the wait resets.
+    const unsigned int late = 2 * HOLD - 1;
+    expect(framesToChange(governor, INSIDE, late) == late + 1, "no change inside hysteresis");
+    expect(framesToChange(governor, OVER, limit) == 1, "step down 2 * holdFrames after");
+    expect(framesToChange(governor, SPARE, limit) == HOLD, "no bounce resets the wait");
+
+    // One frame earlier still counts as a bounce.
+    const unsigned int early = 2 * HOLD - 2;
+    expect(framesToChange(governor, INSIDE, early) == early + 1, "no change inside hysteresis");
+    expect(framesToChange(governor, OVER, limit) == 1, "step down 2 * holdFrames - 1 after");
+    expect(framesToChange(governor, SPARE, limit) == 2 * HOLD, "last bounce frame doubles");
+
+    std::printf("quality_governor_test: passed\n");
+    return 0;
+}